@@ -7,6 +7,7 @@ __author__ = "Russell J. Funk and Diomidis Spinellis"
 __copyright__ = "Copyright (C) 2019, 2023"
 
 # built in modules
+import array
 import math
 import random
 import itertools
@@ -29,6 +30,10 @@ try:
 except ImportError:
   import time_utilities
 
+def _none_if_nan(x):
+  """Return x, or None if it is NaN, as for undefined index values."""
+  return None if math.isnan(x) else x
+
 class Graph:
   """Create a graph.
 
@@ -83,8 +88,8 @@ class Graph:
     """
 
     self._graph = _cdindex.Graph()
-    self._vertex_name_crosswalk = {}
-    self._vertex_id_crosswalk = {}
+    # Whether vertices have names, rather than being known by their ids
+    self._named = True
 
     # add vertices
     for vertex in vertices:
@@ -101,22 +106,17 @@ class Graph:
 
     Parameters
     ----------
-    name :
-      The vertex name.
+    name : str
+      The vertex name, which must be unique.
     t : int
       The vertex timestamp.
     """
-    if name in self._vertex_name_crosswalk:
-     raise ValueError("Vertex already added to graph")
     if isinstance(t, (int)) is False:
       raise ValueError("Time (t) of vertex must be an integer or long")
 
     # add the vertex
-    vertex_id = _cdindex.add_vertex(self._graph, t)
-    self._vertex_name_crosswalk[name] = vertex_id
-    self._vertex_id_crosswalk[vertex_id] = name
+    _cdindex.add_named_vertex(self._graph, name, t)
 
-    
 
   def add_edge(self, source_name, target_name):
     """Add a new edge to the graph.
@@ -131,11 +131,7 @@ class Graph:
     target_name :
       The target vertex timestamp.
     """
-    try:
-      _cdindex.add_edge(self._vertex_name_crosswalk[source_name],
-                        self._vertex_name_crosswalk[target_name])
-    except KeyError:
-      raise ValueError("One or more vertices are not in the graph")
+    _cdindex.add_named_edge(self._graph, source_name, target_name)
 
   def vcount(self):
     """Return the number of vertices in the graph.
@@ -179,7 +175,17 @@ class Graph:
     list
       The vertices.
     """
-    return self._vertex_name_crosswalk.keys()
+    if not self._named:
+      return range(self.vcount())
+    return _cdindex.get_vertex_names(self._graph)
+
+  def _id(self, name):
+    """Return the id of the named vertex."""
+    return _cdindex.get_vertex_id(self._graph, name) if self._named else name
+
+  def _names(self, ids):
+    """Return a list of the names of the vertices with the specified ids."""
+    return _cdindex.get_vertex_names(self._graph, ids) if self._named else list(ids)
 
   def ecount(self):
     """Return the number of edges in the graph.
@@ -213,7 +219,7 @@ class Graph:
     int
       The in degree centrality.
     """
-    return _cdindex.get_vertex_in_degree(self._vertex_name_crosswalk[name])
+    return _cdindex.get_vertex_in_degree(self._graph, self._id(name))
 
   def in_edges(self, name):
     """Return the in edges of the focal vertex.
@@ -233,8 +239,7 @@ class Graph:
     list
       The in edges.
     """
-    in_edges_ids = _cdindex.get_vertex_in_edges(self._vertex_name_crosswalk[name])
-    return [self._vertex_id_crosswalk[vertex_id] for vertex_id in in_edges_ids]
+    return self._names(_cdindex.get_vertex_in_edges(self._graph, self._id(name)))
 
   def out_degree(self, name):
     """Return the out degree of the focal vertex.
@@ -254,7 +259,7 @@ class Graph:
     int
       The out degree centrality.
     """
-    return _cdindex.get_vertex_out_degree(self._vertex_name_crosswalk[name])
+    return _cdindex.get_vertex_out_degree(self._graph, self._id(name))
 
   def out_edges(self, name):
     """Return the out edges of the focal vertex.
@@ -274,8 +279,7 @@ class Graph:
     list
       The out edges.
     """
-    out_edges_ids = _cdindex.get_vertex_out_edges(self._vertex_name_crosswalk[name])
-    return [self._vertex_id_crosswalk[vertex_id] for vertex_id in out_edges_ids]
+    return self._names(_cdindex.get_vertex_out_edges(self._graph, self._id(name)))
 
   def timestamp(self, name):
     """Return the timestamp of the focal vertex.
@@ -292,7 +296,7 @@ class Graph:
     int
       The timestamp.
     """
-    return _cdindex.get_vertex_timestamp(self._vertex_name_crosswalk[name])
+    return _cdindex.get_vertex_timestamp(self._graph, self._id(name))
 
   def cdindex(self, name, t_delta):
     """Compute the CD index.
@@ -314,11 +318,7 @@ class Graph:
     """
     if isinstance(t_delta, (int)) is False:
       raise ValueError("Time delta (t_delta) must be an integer or long")
-    result = _cdindex.cdindex(self._vertex_name_crosswalk[name], t_delta)
-    if math.isnan(result):
-      return None
-    else:
-      return result
+    return _none_if_nan(_cdindex.cdindex(self._graph, self._id(name), t_delta))
 
   def mcdindex(self, name, t_delta):
     """Compute the mCD index.
@@ -341,11 +341,7 @@ class Graph:
     if isinstance(t_delta, (int)) is False:
       raise ValueError("Time delta (t_delta) must be an integer or long")
     
-    result = _cdindex.mcdindex(self._vertex_name_crosswalk[name], t_delta)
-    if math.isnan(result):
-      return None
-    else:
-      return result
+    return _none_if_nan(_cdindex.mcdindex(self._graph, self._id(name), t_delta))
 
   def iindex(self, name, t_delta):
     """Compute the I index.
@@ -367,7 +363,267 @@ class Graph:
     """
     if isinstance(t_delta, (int)) is False:
       raise ValueError("Time delta (t_delta) must be an integer or long")
-    return _cdindex.iindex(self._vertex_name_crosswalk[name], t_delta)
+    return _cdindex.iindex(self._graph, self._id(name), t_delta)
+
+  def cdindex_windows(self, name, t_deltas):
+    """Compute the CD, mCD, and I indices for many time windows.
+
+    This function computes the indices for a specified vertex at each
+    of the given t_deltas in a single traversal of the vertex's
+    neighborhood, which is much faster than computing each one separately.
+
+    Parameters
+    ----------
+    name :
+      The vertex name.
+    t_deltas : list of int
+      Time deltas in ascending order.
+
+    Returns
+    -------
+    list
+      A tuple of the CD, mCD, and I indices for each time delta.
+    """
+    if not all(isinstance(t_delta, (int)) for t_delta in t_deltas):
+      raise ValueError("Time deltas (t_deltas) must be integers or longs")
+    values = _cdindex.cdindex_windows(self._graph,
+        self._id(name), t_deltas)
+    return [(_none_if_nan(cd), _none_if_nan(mcd), i) for cd, mcd, i in values]
+
+  def cdindex_all(self, t_delta, names=None, threads=0):
+    """Compute the CD, mCD, and I indices of many vertices in parallel.
+
+    This function computes the indices for the specified vertices, or for
+    all vertices of the graph, at a given t_delta, using multiple threads.
+    The graph must have been prepared for searching.
+
+    Parameters
+    ----------
+    t_delta : int
+      A time delta.
+    names : 
+      The names of the vertices to compute; all vertices if omitted.
+    threads : int
+      The number of threads to use; all available cores if 0.
+
+    Returns
+    -------
+    dict
+      A tuple of the CD, mCD, and I indices for each vertex name.
+    """
+    if isinstance(t_delta, (int)) is False:
+      raise ValueError("Time delta (t_delta) must be an integer or long")
+    if names is None:
+      names = self.vertices()
+      values = _cdindex.cdindex_all(self._graph, t_delta, threads)
+    else:
+      names = list(names)
+      values = _cdindex.cdindex_all(self._graph, t_delta, threads, self._c_ids(names))
+    return {name: (_none_if_nan(cd), _none_if_nan(mcd), i)
+            for name, (cd, mcd, i) in zip(names, values)}
+
+  def cdindex_sweep(self, t_delta, threads=0):
+    """Compute the CD, mCD, and I indices of all vertices in a time sweep.
+
+    This function returns the same values as cdindex_all for all
+    vertices, but visits each citing vertex once, in timestamp order,
+    counting it in the time windows of the vertices it affects, which
+    is faster when all vertices are needed.
+    The graph must have been prepared for searching.
+
+    Parameters
+    ----------
+    t_delta : int
+      A time delta.
+    threads : int
+      The number of threads to use; all available cores if 0.
+
+    Returns
+    -------
+    dict
+      A tuple of the CD, mCD, and I indices for each vertex name.
+    """
+    if isinstance(t_delta, (int)) is False:
+      raise ValueError("Time delta (t_delta) must be an integer or long")
+    values = _cdindex.cdindex_sweep(self._graph, t_delta, threads)
+    return {name: (_none_if_nan(cd), _none_if_nan(mcd), i)
+            for name, (cd, mcd, i) in zip(self.vertices(), values)}
+
+  def cdindex_approximate(self, name, t_delta, budget, seed=0):
+    """Estimate the CD index from a sample of the vertex's neighborhood.
+
+    This function estimates the CD index by examining at most budget
+    of the vertices citing the focal vertex or its references, so that
+    its cost is bounded for vertices whose references are very widely
+    cited. Vertices whose neighborhood fits within the budget are
+    computed exactly. The graph must have been prepared for searching.
+
+    Parameters
+    ----------
+    t_delta : int
+      A time delta.
+    budget : int
+      The number of citing vertices to examine.
+    seed : int
+      The seed of the random sample.
+
+    Returns
+    -------
+    tuple
+      The estimated CD index, the bounds of its 95% confidence interval,
+      and whether it was computed exactly.
+    """
+    if isinstance(t_delta, (int)) is False:
+      raise ValueError("Time delta (t_delta) must be an integer or long")
+    cd, low, high, exact = _cdindex.cdindex_approximate(self._graph,
+        self._id(name), t_delta, budget, seed)
+    if math.isnan(cd):
+      return (None, None, None, exact)
+    return (cd, low, high, exact)
+
+  def cdindex_approximate_all(self, t_delta, budget, names=None, threads=0, seed=0):
+    """Estimate the CD indices of many vertices in parallel.
+
+    See cdindex_approximate and cdindex_all.
+
+    Parameters
+    ----------
+    t_delta : int
+      A time delta.
+    budget : int
+      The number of citing vertices to examine for each vertex.
+    names :
+      The names of the vertices to compute; all vertices if omitted.
+    threads : int
+      The number of threads to use; all available cores if 0.
+    seed : int
+      The seed of the random samples.
+
+    Returns
+    -------
+    dict
+      A tuple of the estimated CD index, its confidence interval bounds,
+      and whether it was computed exactly, for each vertex name.
+    """
+    if isinstance(t_delta, (int)) is False:
+      raise ValueError("Time delta (t_delta) must be an integer or long")
+    if names is None:
+      names = self.vertices()
+      estimates = _cdindex.cdindex_approximate_all(self._graph, t_delta, budget,
+          threads, None, seed)
+    else:
+      names = list(names)
+      estimates = _cdindex.cdindex_approximate_all(self._graph, t_delta, budget,
+          threads, self._c_ids(names), seed)
+    return {name: (None, None, None, exact) if math.isnan(cd) else (cd, low, high, exact)
+            for name, (cd, low, high, exact) in zip(names, estimates)}
+
+  def _c_ids(self, names):
+    """Return an int64 array of the ids of the named vertices, or None."""
+    if names is None:
+      return None
+    if not self._named:
+      return array.array('q', names)
+    return _cdindex.get_vertex_ids(self._graph, names)
+
+  def timestamps(self):
+    """Return the timestamps of all vertices as an array.
+
+    The array is indexed by the position of each vertex in vertices(),
+    and views the graph's own storage: it is read-only, and while it
+    exists the graph cannot be prepared again after adding vertices.
+    Arrays returned by this and the following methods are memoryview
+    objects, which can be wrapped by numpy.asarray without copying.
+    The graph must have been prepared for searching.
+
+    Returns
+    -------
+    memoryview
+      The int64 vertex timestamps.
+    """
+    return _cdindex.get_timestamps(self._graph)
+
+  def in_degrees(self):
+    """Return the in degrees of all vertices as an array.
+
+    Returns
+    -------
+    memoryview
+      The int64 in degrees, indexed by the position of each vertex in vertices().
+    """
+    return _cdindex.get_in_degrees(self._graph)
+
+  def out_degrees(self):
+    """Return the out degrees of all vertices as an array.
+
+    Returns
+    -------
+    memoryview
+      The int64 out degrees, indexed by the position of each vertex in vertices().
+    """
+    return _cdindex.get_out_degrees(self._graph)
+
+  def in_edges_csr(self, names=None):
+    """Return the in edges of many vertices in compressed sparse row form.
+
+    The in edges of the i-th vertex are the neighbors from offsets[i]
+    to offsets[i + 1]; neighbors are given by their position in
+    vertices(). For all vertices, the arrays view the graph's own storage.
+
+    Parameters
+    ----------
+    names :
+      The names of the vertices; all vertices if omitted.
+
+    Returns
+    -------
+    tuple
+      The offsets array and the array of the neighbors of the vertices.
+    """
+    return _cdindex.get_in_csr(self._graph, self._c_ids(names))
+
+  def out_edges_csr(self, names=None):
+    """Return the out edges of many vertices in compressed sparse row form.
+
+    The arrays are arranged as for in_edges_csr, with out edges
+    sorted by the neighbors' position.
+
+    Parameters
+    ----------
+    names :
+      The names of the vertices; all vertices if omitted.
+
+    Returns
+    -------
+    tuple
+      The offsets array and the array of the neighbors of the vertices.
+    """
+    return _cdindex.get_out_csr(self._graph, self._c_ids(names))
+
+  def cdindex_arrays(self, t_delta, names=None, threads=0):
+    """Compute the CD, mCD, and I indices of many vertices into arrays.
+
+    This function works like cdindex_all, but returns the indices as
+    arrays in the order of the specified names, or of vertices(), with
+    NaN for undefined CD and mCD indices.
+
+    Parameters
+    ----------
+    t_delta : int
+      A time delta.
+    names :
+      The names of the vertices to compute; all vertices if omitted.
+    threads : int
+      The number of threads to use; all available cores if 0.
+
+    Returns
+    -------
+    tuple
+      The double CD and mCD index arrays and the int64 I index array.
+    """
+    if isinstance(t_delta, (int)) is False:
+      raise ValueError("Time delta (t_delta) must be an integer or long")
+    return _cdindex.cdindex_arrays(self._graph, t_delta, threads, self._c_ids(names))
 
   def _is_graph_sane(self):
     """Test graph sanity.
@@ -382,13 +638,189 @@ class Graph:
     """
     return _cdindex._is_graph_sane(self._graph)
 
-  def prepare_for_searching(self):
+  def prepare_for_searching(self, threads=0, order=None):
     """Arrange out edges so that they can be (efficiently) searched.
 
-    Sort the node ids stored in in each vertex's out edges to that
-    the binary search functionality of has_out_edge can work.
+    Freeze the graph into a compact read-only representation in which
+    the node ids stored in each vertex's out edges are sorted, so that the
+    binary search functionality of has_out_edge can work. Vertices can
+    still be added after this call, together with edges from them; they
+    are merged into the frozen representation when this is called again.
+
+    The vertices can also be rearranged in memory, so that the indices
+    of many vertices are computed with fewer cache misses. This changes
+    the order of vertices(), and requires creating trackers anew.
+
+    Parameters
+    ----------
+    threads : int
+      The number of threads to use; all available cores if 0.
+    order : str
+      The order in which to arrange the vertices: "timestamp", which
+      is the fastest for most graphs, "rcm" (reverse Cuthill-McKee,
+      a breadth-first order), or "references" (works grouped by their
+      most cited reference); None to keep the order they were added.
+    """
+    _cdindex.prepare_for_searching(self._graph, threads)
+    if order is not None:
+      if not self._named:
+        raise ValueError("Only graphs with named vertices can be rearranged")
+      _cdindex.relabel(self._graph, order, threads)
+
+  def save(self, path):
+    """Save the graph to a binary file.
+
+    Write the prepared graph to a file from which it can be quickly
+    loaded with Graph.load. Vertices are stored with their names in the
+    order they were added to the graph.
+
+    Parameters
+    ----------
+    path :
+      The name of the file to write.
+    """
+    _cdindex.save_graph(self._graph, path)
+
+  @classmethod
+  def load(cls, path, names=None, verify=True):
+    """Load a graph from a binary file written by Graph.save.
+
+    The file is mapped into memory, so that loading is almost instant
+    and processes loading the same file share its memory. The loaded
+    graph is prepared for searching and cannot be modified.
+
+    Parameters
+    ----------
+    path :
+      The name of the file to load.
+    names :
+      The names of the vertices in the order they were added to the
+      saved graph, which must match any saved names; if omitted, the
+      saved names, or, if there are none, the vertices' indices.
+    verify : bool
+      Whether to verify the file's checksum, which requires reading it.
+
+    Returns
+    -------
+    Graph
+      The loaded graph.
+    """
+    graph = cls()
+    graph._graph = _cdindex.load_graph(path, verify)
+    if names is not None:
+      names = list(names)
+      if _cdindex.get_name_count(graph._graph) == 0:
+        _cdindex.name_vertices(graph._graph, names)
+      elif names != _cdindex.get_vertex_names(graph._graph):
+        raise ValueError("Names differ from those saved with the graph")
+    graph._named = _cdindex.get_name_count(graph._graph) > 0
+    return graph
+
+class CDIndexTracker:
+  """Maintain the indices of a graph's vertices as vertices are added.
+
+  The tracker keeps for each vertex the counts of the works citing it, its
+  references, or both within a time window. When new works citing earlier
+  ones are added to the graph, update recomputes only the affected counts.
+  """
+
+  def __init__(self, graph, t_delta, threads=0):
+    """Compute the indices of all vertices of a graph.
+
+    Parameters
+    ----------
+    graph : Graph
+      The graph, which is prepared for searching if needed.
+    t_delta : int
+      The time delta of the tracked indices.
+    threads : int
+      The number of threads to use; all available cores if 0.
+    """
+    if isinstance(t_delta, (int)) is False:
+      raise ValueError("Time delta (t_delta) must be an integer or long")
+    self._graph = graph
+    self._tracker = _cdindex.Tracker(t_delta)
+    self.update(threads)
+
+  def update(self, threads=0):
+    """Account for the vertices added to the graph since the last update.
+
+    The graph is prepared for searching, and the indices of the added
+    vertices and of the earlier vertices they affect are updated.
+    Edges must only have been added from the added vertices.
+
+    Parameters
+    ----------
+    threads : int
+      The number of threads to use; all available cores if 0.
+
+    Returns
+    -------
+    list
+      The names of the vertices whose indices were set or changed.
+    """
+    self._graph.prepare_for_searching(threads)
+    changed = _cdindex.tracker_update(self._tracker, self._graph._graph, threads)
+    return self._graph._names(changed)
+
+  def values(self, name):
+    """Return the tracked indices of a vertex.
+
+    Parameters
+    ----------
+    name :
+      The vertex name.
+
+    Returns
+    -------
+    tuple
+      The CD, mCD, and I indices of the vertex, with None for undefined values.
     """
-    _cdindex.prepare_for_searching(self._graph)
+    cd, mcd, i = _cdindex.tracker_values(self._tracker, self._graph._graph,
+        self._graph._id(name))
+    return (_none_if_nan(cd), _none_if_nan(mcd), i)
+
+def get_stats(graph=None):
+  """Return statistics of the index computations.
+
+  Statistics are only collected when the module is built with the
+  CDINDEX_STATS environment variable set, for example through
+  CDINDEX_STATS=1 python setup.py build_ext; collecting them has no
+  cost otherwise. They cover all computations since the module was
+  loaded or reset_stats was called.
+
+  Parameters
+  ----------
+  graph : Graph
+    The graph whose vertices are the focal ones, used to report the
+    most expensive vertices by name; None to report their ids.
+
+  Returns
+  -------
+  dict
+    The numbers of focal vertices, of citers visited within their time
+    windows (window_rejects are those outside), of distinct "it"
+    vertices, of probes for the focal vertex among citer references,
+    and of reference intersections, with those short-circuited at a
+    common reference. Also the number of focal vertices and their
+    computation time in seconds for each range of (in + out) degrees,
+    as (low, high, vertices, seconds) tuples in degree_buckets, and the
+    most expensive focal vertices as (vertex, seconds) tuples in top.
+
+  Raises
+  ------
+  RuntimeError
+    If the module was not built to collect statistics.
+  """
+  stats = _cdindex.get_stats()
+  if graph is not None:
+    names = graph._names([v for v, seconds in stats["top"]])
+    stats["top"] = [(name, seconds) for name, (v, seconds) in zip(names, stats["top"])]
+  return stats
+
+def reset_stats():
+  """Clear the statistics of the index computations; see get_stats."""
+  _cdindex.reset_stats()
 
 class RandomGraph(Graph):
   """Create a random graph.
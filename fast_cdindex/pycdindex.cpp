@@ -17,7 +17,7 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <cassert>
+#include <cstring>
 #include <Python.h>
 #include "cdindex.h"
 
@@ -27,9 +27,13 @@ extern "C" {
 #define PY3K
 #endif
 
-/* Destructor function for Graph */
+/*
+ * Destructor function for Graph. The capsule's context counts the
+ * arrays exporting the graph's internal buffers.
+ */
 static void del_Graph(PyObject *obj) {
   delete (Graph *)PyCapsule_GetPointer(obj,"Graph");
+  delete (Py_ssize_t *)PyCapsule_GetContext(obj);
 }
 
 /* Graph utility functions */
@@ -37,9 +41,238 @@ static Graph *PyGraph_AsGraph(PyObject *obj) {
   return (Graph *)PyCapsule_GetPointer(obj, "Graph");
 }
 static PyObject *PyGraph_FromGraph(Graph *g, int must_free) {
-  return PyCapsule_New(g, "Graph", must_free ? del_Graph : NULL);
+  PyObject *obj = PyCapsule_New(g, "Graph", must_free ? del_Graph : NULL);
+  if (obj && must_free && PyCapsule_SetContext(obj, new Py_ssize_t(0)) < 0) {
+    Py_DECREF(obj);
+    return NULL;
+  }
+  return obj;
+}
+
+/* Return the number of arrays exporting the graph's internal buffers */
+static Py_ssize_t *PyGraph_Exports(PyObject *obj) {
+  return (Py_ssize_t *)PyCapsule_GetContext(obj);
+}
+
+/* Return the graph, provided it has been prepared for searching */
+static Graph *PyGraph_AsPreparedGraph(PyObject *obj) {
+  Graph *g = PyGraph_AsGraph(obj);
+  if (g && !g->is_prepared()) {
+    PyErr_SetString(PyExc_RuntimeError, "Graph has not been prepared for searching");
+    return NULL;
+  }
+  return g;
+}
+
+/* Destructor function for CDIndexTracker */
+static void del_Tracker(PyObject *obj) {
+  delete (CDIndexTracker *)PyCapsule_GetPointer(obj,"CDIndexTracker");
+}
+
+/*
+ * Return true if the specified vertex index refers to a vertex of the graph,
+ * setting an IndexError otherwise.
+ */
+static bool PyGraph_CheckVertex(Graph *g, long long v) {
+  if (v < 0 || (unsigned long long)v >= g->get_vcount()) {
+    PyErr_SetString(PyExc_IndexError, "Vertex index out of range");
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Return true if n vertices can be added to the graph,
+ * setting an OverflowError otherwise.
+ */
+static bool PyGraph_CheckCapacity(Graph *g, size_t n) {
+  if (n > MAX_VCOUNT - g->get_vcount()) {
+    PyErr_SetString(PyExc_OverflowError, "Too many vertices for the index type");
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Return true if edges can be added from the specified source vertex,
+ * which must not belong to the graph's frozen part, setting a ValueError
+ * otherwise.
+ */
+static bool PyGraph_CheckSource(Graph *g, long long v) {
+  if (v >= 0 && (unsigned long long)v < g->get_frozen_vcount()) {
+    PyErr_SetString(PyExc_ValueError,
+        "Edges can only be added from vertices added since the graph was prepared");
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Obtain the UTF-8 encoding of the specified vertex name, which must be
+ * a string. Return false with a Python exception set on failure.
+ */
+static bool PyGraph_AsName(PyObject *obj, const char **name, Py_ssize_t *length) {
+  if (!PyUnicode_Check(obj)) {
+    PyErr_SetString(PyExc_TypeError, "Vertex names must be strings");
+    return false;
+  }
+  return (*name = PyUnicode_AsUTF8AndSize(obj, length)) != NULL;
+}
+
+/*
+ * Return the index of the vertex with the specified name,
+ * or NO_VERTEX with a KeyError (or TypeError) set.
+ */
+static vertex_index_t PyGraph_FindVertex(Graph *g, PyObject *obj) {
+  const char *name;
+  Py_ssize_t length;
+
+  if (!PyGraph_AsName(obj, &name, &length))
+    return NO_VERTEX;
+  vertex_index_t v = g->find_vertex(name, length);
+  if (v == NO_VERTEX)
+    PyErr_SetObject(PyExc_KeyError, obj);
+  return v;
+}
+
+/* Return a new string with the name of the specified vertex */
+static PyObject *PyGraph_VertexName(Graph *g, vertex_index_t v) {
+  const NameIndex &names = g->get_names();
+  return PyUnicode_DecodeUTF8(names.get_name(v), names.get_length(v), NULL);
+}
+
+/*
+ * A read-only one-dimensional array exported through the buffer protocol,
+ * so that it can be wrapped by a memoryview or a NumPy array without
+ * copying. Its elements are either owned by the object, or are one of
+ * a graph's internal buffers, in which case the object keeps the graph
+ * alive and counts as one of its exports.
+ */
+typedef struct {
+  PyObject_HEAD
+  PyObject *graph;
+  void *owned;
+  const void *elements;
+  Py_ssize_t length;
+  Py_ssize_t itemsize;
+  const char *format;
+} GraphArrayObject;
+
+static void GraphArray_dealloc(PyObject *obj) {
+  GraphArrayObject *a = (GraphArrayObject *)obj;
+
+  if (a->graph) {
+    --*PyGraph_Exports(a->graph);
+    Py_DECREF(a->graph);
+  }
+  PyMem_RawFree(a->owned);
+  Py_TYPE(obj)->tp_free(obj);
+}
+
+static int GraphArray_getbuffer(PyObject *obj, Py_buffer *view, int flags) {
+  GraphArrayObject *a = (GraphArrayObject *)obj;
+
+  if (flags & PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "Graph arrays are read-only");
+    view->obj = NULL;
+    return -1;
+  }
+  view->obj = obj;
+  Py_INCREF(obj);
+  view->buf = (void *)a->elements;
+  view->len = a->length * a->itemsize;
+  view->readonly = 1;
+  view->itemsize = a->itemsize;
+  view->format = (flags & PyBUF_FORMAT) ? (char *)a->format : NULL;
+  view->ndim = 1;
+  view->shape = (flags & PyBUF_ND) ? &a->length : NULL;
+  view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &a->itemsize : NULL;
+  view->suboffsets = NULL;
+  view->internal = NULL;
+  return 0;
+}
+
+static PyBufferProcs GraphArray_as_buffer = {GraphArray_getbuffer, NULL};
+
+static PyTypeObject GraphArrayType = {PyVarObject_HEAD_INIT(NULL, 0)};
+
+/* Set up the GraphArray type; return 0 with a Python exception set on failure */
+static int GraphArray_Ready(void) {
+  GraphArrayType.tp_name = "_cdindex.GraphArray";
+  GraphArrayType.tp_basicsize = sizeof(GraphArrayObject);
+  GraphArrayType.tp_dealloc = GraphArray_dealloc;
+  GraphArrayType.tp_as_buffer = &GraphArray_as_buffer;
+  GraphArrayType.tp_flags = Py_TPFLAGS_DEFAULT;
+  GraphArrayType.tp_doc = "Read-only array of graph data";
+  return PyType_Ready(&GraphArrayType) == 0;
+}
+
+/*
+ * Return a new array of n elements of the specified size and format,
+ * which views the specified graph's elements, or, if py_g is NULL,
+ * owns elements allocated for the caller to fill through *owned.
+ */
+static GraphArrayObject *GraphArray_New(PyObject *py_g, const void *elements,
+    size_t n, Py_ssize_t itemsize, const char *format, void **owned) {
+  static const int64_t empty = 0;
+  void *p = NULL;
+
+  if (!py_g && !(p = PyMem_RawMalloc(n ? n * itemsize : 1))) {
+    PyErr_NoMemory();
+    return NULL;
+  }
+  GraphArrayObject *a = PyObject_New(GraphArrayObject, &GraphArrayType);
+  if (!a) {
+    PyMem_RawFree(p);
+    return NULL;
+  }
+  a->graph = py_g;
+  a->owned = p;
+  a->elements = p ? p : elements ? elements : &empty;
+  a->length = n;
+  a->itemsize = itemsize;
+  a->format = format;
+  if (py_g) {
+    Py_INCREF(py_g);
+    ++*PyGraph_Exports(py_g);
+  } else
+    *owned = p;
+  return a;
 }
 
+/* Return a memoryview of the specified array, releasing the caller's reference */
+static PyObject *GraphArray_AsMemoryView(GraphArrayObject *a) {
+  if (!a)
+    return NULL;
+  PyObject *view = PyMemoryView_FromObject((PyObject *)a);
+  Py_DECREF(a);
+  return view;
+}
+
+extern "C++" {
+/* Return the buffer protocol format of elements of type T */
+template <typename T>
+static const char *buffer_format() {
+  if (std::is_floating_point<T>::value)
+    return "d";
+  if (sizeof(T) == sizeof(uint32_t))
+    return std::is_signed<T>::value ? "i" : "I";
+  return std::is_signed<T>::value ? "q" : "Q";
+}
+
+/* Return an array viewing n elements of the specified graph */
+template <typename T>
+static GraphArrayObject *GraphArray_View(PyObject *py_g, const T *elements, size_t n) {
+  return GraphArray_New(py_g, elements, n, sizeof(T), buffer_format<T>(), NULL);
+}
+
+/* Return an array owning n elements, which the caller fills through *elements */
+template <typename T>
+static GraphArrayObject *GraphArray_Alloc(size_t n, T **elements) {
+  return GraphArray_New(NULL, NULL, n, sizeof(T), buffer_format<T>(), (void **)elements);
+}
+} // extern "C++"
+
 /*******************************************************************************
  * Create a new Graph object                                                   *
  ******************************************************************************/
@@ -48,16 +281,65 @@ static PyObject *py_Graph(PyObject *self, PyObject *args) {
   return PyGraph_FromGraph(g, 1);
 }
 
+/*******************************************************************************
+ * Save a prepared graph to a file                                             *
+ ******************************************************************************/
+static PyObject *py_save_graph(PyObject *self, PyObject *args) {
+  Graph *g;
+  PyObject *py_g, *py_path;
+  bool ok;
+
+  if (!PyArg_ParseTuple(args,"OO&", &py_g, PyUnicode_FSConverter, &py_path))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g))) {
+    Py_DECREF(py_path);
+    return NULL;
+  }
+
+  const char *path = PyBytes_AsString(py_path);
+  Py_BEGIN_ALLOW_THREADS
+  ok = g->save(path);
+  Py_END_ALLOW_THREADS
+
+  if (!ok)
+    PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+  Py_DECREF(py_path);
+  return ok ? Py_BuildValue("") : NULL;
+}
+
+/*******************************************************************************
+ * Load a graph by mapping a file written by save_graph                        *
+ ******************************************************************************/
+static PyObject *py_load_graph(PyObject *self, PyObject *args) {
+  PyObject *py_path;
+  int verify = 1;
+  bool ok;
+
+  if (!PyArg_ParseTuple(args,"O&|p", PyUnicode_FSConverter, &py_path, &verify))
+    return NULL;
+
+  Graph *g = new Graph();
+  const char *path = PyBytes_AsString(py_path);
+  Py_BEGIN_ALLOW_THREADS
+  ok = g->mmap_load(path, verify);
+  Py_END_ALLOW_THREADS
+
+  if (!ok) {
+    PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+    delete g;
+    Py_DECREF(py_path);
+    return NULL;
+  }
+  Py_DECREF(py_path);
+  return PyGraph_FromGraph(g, 1);
+}
+
 /*******************************************************************************
  * Check graph sanity                                                          *
  ******************************************************************************/
 static PyObject *py_is_graph_sane(PyObject *self, PyObject *args) {
   Graph *g;
   PyObject *py_g;
-  vertex_id_t vid;
-
-  // Ensure that the id can hold the pointer value
-  assert(sizeof(vid.id) >= sizeof(vid.v));
 
   if (!PyArg_ParseTuple(args,"O",&py_g))
     return NULL;
@@ -73,17 +355,79 @@ static PyObject *py_is_graph_sane(PyObject *self, PyObject *args) {
 static PyObject *py_prepare_for_searching(PyObject *self, PyObject *args) {
   Graph *g;
   PyObject *py_g;
+  unsigned int nthreads = 0;
 
-  if (!PyArg_ParseTuple(args,"O",&py_g))
+  if (!PyArg_ParseTuple(args,"O|I",&py_g, &nthreads))
     return NULL;
   if (!(g = PyGraph_AsGraph(py_g)))
     return NULL;
+  Py_ssize_t *exports = PyGraph_Exports(py_g);
+  if (!g->is_prepared() && exports && *exports) {
+    PyErr_SetString(PyExc_BufferError,
+        "Graph arrays are exported and cannot be rebuilt");
+    return NULL;
+  }
 
-  g->prepare_for_searching();
+  Py_BEGIN_ALLOW_THREADS
+  g->prepare_for_searching(nthreads);
+  Py_END_ALLOW_THREADS
 
   return Py_BuildValue("");
 }
 
+/*******************************************************************************
+ * Relabel the vertices of a prepared graph in an order improving locality     *
+ ******************************************************************************/
+static PyObject *py_relabel(PyObject *self, PyObject *args) {
+  static const struct {
+    const char *name;
+    vertex_order_t order;
+  } orders[] = {
+    {"timestamp", ORDER_TIMESTAMP},
+    {"rcm", ORDER_RCM},
+    {"references", ORDER_REFERENCES},
+  };
+  Graph *g;
+  PyObject *py_g;
+  const char *name;
+  unsigned int nthreads = 0;
+  int64_t *result;
+
+  if (!PyArg_ParseTuple(args,"Os|I",&py_g, &name, &nthreads))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)))
+    return NULL;
+  const vertex_order_t *kind = NULL;
+  for (auto &o : orders)
+    if (strcmp(o.name, name) == 0)
+      kind = &o.order;
+  if (!kind) {
+    PyErr_Format(PyExc_ValueError, "Unknown vertex order: %s", name);
+    return NULL;
+  }
+  if (g->get_names().size() && g->get_names().size() != g->get_vcount()) {
+    PyErr_SetString(PyExc_ValueError, "Graph has unnamed vertices");
+    return NULL;
+  }
+  Py_ssize_t *exports = PyGraph_Exports(py_g);
+  if (exports && *exports) {
+    PyErr_SetString(PyExc_BufferError,
+        "Graph arrays are exported and cannot be rebuilt");
+    return NULL;
+  }
+
+  GraphArrayObject *a = GraphArray_Alloc(g->get_vcount(), &result);
+  if (!a)
+    return NULL;
+  Py_BEGIN_ALLOW_THREADS
+  std::vector<vertex_index_t> order(locality_order(*g, *kind));
+  g->relabel(order, nthreads);
+  std::copy(order.begin(), order.end(), result);
+  Py_END_ALLOW_THREADS
+
+  return GraphArray_AsMemoryView(a);
+}
+
 /*******************************************************************************
  * Add a vertex to the graph                                                   *
  ******************************************************************************/
@@ -96,26 +440,354 @@ static PyObject *py_add_vertex(PyObject *self, PyObject *args) {
     return NULL;
   if (!(g = PyGraph_AsGraph(py_g)))
     return NULL;
+  if (!PyGraph_CheckCapacity(g, 1))
+    return NULL;
 
-  vertex_id_t ID = g->add_vertex(TIMESTAMP);
+  vertex_index_t ID = g->add_vertex(TIMESTAMP);
 
-  return Py_BuildValue("L", ID.id);
+  return Py_BuildValue("K", (unsigned long long)ID);
+}
+
+/*
+ * Obtain a contiguous buffer of 64-bit integers, such as a NumPy int64 array
+ * or an array.array('q'), from the specified object.
+ * Return 0 with a Python exception set on failure.
+ */
+static int get_int64_buffer(PyObject *obj, Py_buffer *view) {
+  if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+    return 0;
+
+  const char *format = view->format ? view->format : "B";
+  if (*format == '@' || *format == '=' || *format == '<')
+    format++;
+  if (view->itemsize != sizeof(int64_t) || (strcmp(format, "q") && strcmp(format, "l"))) {
+    PyErr_SetString(PyExc_TypeError, "Expected a contiguous array of 64-bit integers");
+    PyBuffer_Release(view);
+    return 0;
+  }
+  return 1;
+}
+
+/*******************************************************************************
+ * Add many vertices from an array of timestamps to the graph                  *
+ ******************************************************************************/
+static PyObject *py_add_vertices(PyObject *self, PyObject *args) {
+  Graph *g;
+  PyObject *py_g, *py_timestamps;
+  Py_buffer timestamps;
+  vertex_index_t first;
+
+  if (!PyArg_ParseTuple(args,"OO",&py_g, &py_timestamps))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)))
+    return NULL;
+  if (!get_int64_buffer(py_timestamps, &timestamps))
+    return NULL;
+
+  size_t n = timestamps.len / sizeof(int64_t);
+  if (!PyGraph_CheckCapacity(g, n)) {
+    PyBuffer_Release(&timestamps);
+    return NULL;
+  }
+  Py_BEGIN_ALLOW_THREADS
+  first = g->add_vertices((const timestamp_t *)timestamps.buf, n);
+  Py_END_ALLOW_THREADS
+
+  PyBuffer_Release(&timestamps);
+  return Py_BuildValue("K", (unsigned long long)first);
+}
+
+/*******************************************************************************
+ * Add many edges from arrays of source and target vertex indices              *
+ ******************************************************************************/
+static PyObject *py_add_edges(PyObject *self, PyObject *args) {
+  Graph *g;
+  PyObject *py_g, *py_sources, *py_targets;
+  Py_buffer sources, targets;
+  bool ok;
+
+  if (!PyArg_ParseTuple(args,"OOO",&py_g, &py_sources, &py_targets))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)))
+    return NULL;
+  if (!get_int64_buffer(py_sources, &sources))
+    return NULL;
+  if (!get_int64_buffer(py_targets, &targets)) {
+    PyBuffer_Release(&sources);
+    return NULL;
+  }
+  if (sources.len != targets.len) {
+    PyBuffer_Release(&sources);
+    PyBuffer_Release(&targets);
+    PyErr_SetString(PyExc_ValueError, "Source and target arrays differ in length");
+    return NULL;
+  }
+
+  size_t n = sources.len / sizeof(int64_t);
+  for (size_t i = 0; i < n; i++)
+    if (!PyGraph_CheckSource(g, ((const int64_t *)sources.buf)[i])) {
+      PyBuffer_Release(&sources);
+      PyBuffer_Release(&targets);
+      return NULL;
+    }
+  Py_BEGIN_ALLOW_THREADS
+  ok = g->add_edges((const int64_t *)sources.buf, (const int64_t *)targets.buf, n);
+  Py_END_ALLOW_THREADS
+
+  PyBuffer_Release(&sources);
+  PyBuffer_Release(&targets);
+  if (!ok) {
+    PyErr_SetString(PyExc_IndexError, "Vertex index out of range");
+    return NULL;
+  }
+  return Py_BuildValue("");
 }
 
 /*******************************************************************************
  * Add an edge to the graph                                                    *
  ******************************************************************************/
 static PyObject *py_add_edge(PyObject *self, PyObject *args) {
-  vertex_id_t SOURCE_ID, TARGET_ID;
+  Graph *g;
+  PyObject *py_g;
+  long long SOURCE_ID, TARGET_ID;
+
+  if (!PyArg_ParseTuple(args,"OLL", &py_g, &SOURCE_ID, &TARGET_ID))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)))
+    return NULL;
+  if (!PyGraph_CheckVertex(g, SOURCE_ID) || !PyGraph_CheckVertex(g, TARGET_ID)
+      || !PyGraph_CheckSource(g, SOURCE_ID))
+    return NULL;
+
+  g->add_edge(SOURCE_ID, TARGET_ID);
+
+  return Py_BuildValue("");
+}
+
+/*******************************************************************************
+ * Add a named vertex to the graph                                             *
+ ******************************************************************************/
+static PyObject *py_add_named_vertex(PyObject *self, PyObject *args) {
+  timestamp_t TIMESTAMP;
+  Graph *g;
+  PyObject *py_g, *py_name;
+  const char *name;
+  Py_ssize_t length;
+
+  if (!PyArg_ParseTuple(args,"OOL",&py_g, &py_name, &TIMESTAMP))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)))
+    return NULL;
+  if (!PyGraph_AsName(py_name, &name, &length) || !PyGraph_CheckCapacity(g, 1))
+    return NULL;
+
+  vertex_index_t ID = g->add_vertex(name, length, TIMESTAMP);
+  if (ID == NO_VERTEX) {
+    PyErr_SetString(PyExc_ValueError, errno == EEXIST ? "Vertex already added to graph"
+        : "Graph has unnamed vertices");
+    return NULL;
+  }
+
+  return Py_BuildValue("K", (unsigned long long)ID);
+}
+
+/*******************************************************************************
+ * Name the graph's unnamed vertices in order                                  *
+ ******************************************************************************/
+static PyObject *py_name_vertices(PyObject *self, PyObject *args) {
+  Graph *g;
+  PyObject *py_g, *py_names;
+  const char *name;
+  Py_ssize_t length;
 
-  if (!PyArg_ParseTuple(args,"LL", &SOURCE_ID, &TARGET_ID))
+  if (!PyArg_ParseTuple(args,"OO", &py_g, &py_names))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)))
     return NULL;
 
-  add_edge(SOURCE_ID, TARGET_ID);
+  PyObject *seq = PySequence_Fast(py_names, "Vertex names must be a sequence");
+  if (!seq)
+    return NULL;
+  for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+    if (!PyGraph_AsName(PySequence_Fast_GET_ITEM(seq, i), &name, &length)) {
+      Py_DECREF(seq);
+      return NULL;
+    }
+    if (!g->name_vertex(name, length)) {
+      PyErr_SetString(PyExc_ValueError, errno == EEXIST ? "Vertex name is not unique"
+          : "More names than vertices");
+      Py_DECREF(seq);
+      return NULL;
+    }
+  }
+  Py_DECREF(seq);
+  return Py_BuildValue("");
+}
+
+/*******************************************************************************
+ * Add an edge between two named vertices                                      *
+ ******************************************************************************/
+static PyObject *py_add_named_edge(PyObject *self, PyObject *args) {
+  Graph *g;
+  PyObject *py_g, *py_source, *py_target;
+  const char *source, *target;
+  Py_ssize_t source_length, target_length;
+
+  if (!PyArg_ParseTuple(args,"OOO", &py_g, &py_source, &py_target))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)))
+    return NULL;
+  if (!PyGraph_AsName(py_source, &source, &source_length)
+      || !PyGraph_AsName(py_target, &target, &target_length))
+    return NULL;
+
+  vertex_index_t s = g->find_vertex(source, source_length);
+  vertex_index_t t = g->find_vertex(target, target_length);
+  if (s == NO_VERTEX || t == NO_VERTEX) {
+    PyErr_SetString(PyExc_ValueError, "One or more vertices are not in the graph");
+    return NULL;
+  }
+  if (!PyGraph_CheckSource(g, s))
+    return NULL;
+
+  g->add_edge(s, t);
 
   return Py_BuildValue("");
 }
 
+/*******************************************************************************
+ * Get the number of named vertices                                            *
+ ******************************************************************************/
+static PyObject *py_get_name_count(PyObject *self, PyObject *args) {
+  Graph *g;
+  PyObject *py_g;
+
+  if (!PyArg_ParseTuple(args,"O",&py_g))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)))
+    return NULL;
+
+  return Py_BuildValue("K", (unsigned long long)g->get_names().size());
+}
+
+/*******************************************************************************
+ * Get the index of a named vertex                                             *
+ ******************************************************************************/
+static PyObject *py_get_vertex_id(PyObject *self, PyObject *args) {
+  Graph *g;
+  PyObject *py_g, *py_name;
+
+  if (!PyArg_ParseTuple(args,"OO",&py_g, &py_name))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)))
+    return NULL;
+
+  vertex_index_t ID = PyGraph_FindVertex(g, py_name);
+  if (ID == NO_VERTEX)
+    return NULL;
+  return Py_BuildValue("K", (unsigned long long)ID);
+}
+
+/*******************************************************************************
+ * Get the indices of many named vertices as an array                          *
+ ******************************************************************************/
+static PyObject *py_get_vertex_ids(PyObject *self, PyObject *args) {
+  Graph *g;
+  PyObject *py_g, *py_names;
+  int64_t *ids;
+
+  if (!PyArg_ParseTuple(args,"OO",&py_g, &py_names))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)))
+    return NULL;
+
+  PyObject *seq = PySequence_Fast(py_names, "Vertex names must be a sequence");
+  if (!seq)
+    return NULL;
+  Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+  GraphArrayObject *result = GraphArray_Alloc(n, &ids);
+  if (!result) {
+    Py_DECREF(seq);
+    return NULL;
+  }
+  for (Py_ssize_t i = 0; i < n; i++) {
+    vertex_index_t v = PyGraph_FindVertex(g, PySequence_Fast_GET_ITEM(seq, i));
+    if (v == NO_VERTEX) {
+      Py_DECREF(result);
+      Py_DECREF(seq);
+      return NULL;
+    }
+    ids[i] = v;
+  }
+  Py_DECREF(seq);
+  return GraphArray_AsMemoryView(result);
+}
+
+/*******************************************************************************
+ * Get the name of a vertex                                                    *
+ ******************************************************************************/
+static PyObject *py_get_vertex_name(PyObject *self, PyObject *args) {
+  long long ID;
+  Graph *g;
+  PyObject *py_g;
+
+  if (!PyArg_ParseTuple(args,"OL", &py_g, &ID))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)) || !PyGraph_CheckVertex(g, ID))
+    return NULL;
+  if ((unsigned long long)ID >= g->get_names().size()) {
+    PyErr_SetString(PyExc_ValueError, "Vertex has no name");
+    return NULL;
+  }
+
+  return PyGraph_VertexName(g, ID);
+}
+
+/*******************************************************************************
+ * Get the names of all vertices or of a sequence of vertex indices            *
+ ******************************************************************************/
+static PyObject *py_get_vertex_names(PyObject *self, PyObject *args) {
+  Graph *g;
+  PyObject *py_g, *py_ids = NULL, *name;
+
+  if (!PyArg_ParseTuple(args,"O|O", &py_g, &py_ids))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)))
+    return NULL;
+
+  PyObject *seq = NULL;
+  size_t n = g->get_names().size();
+  if (py_ids && py_ids != Py_None) {
+    if (!(seq = PySequence_Fast(py_ids, "Vertex ids must be a sequence")))
+      return NULL;
+    n = PySequence_Fast_GET_SIZE(seq);
+  }
+
+  PyObject *vs_list = PyList_New(n);
+  for (size_t i = 0; vs_list && i < n; i++) {
+    long long ID = i;
+    if (seq) {
+      ID = PyLong_AsLongLong(PySequence_Fast_GET_ITEM(seq, i));
+      if (PyErr_Occurred() || !PyGraph_CheckVertex(g, ID))
+        goto error;
+      if ((unsigned long long)ID >= g->get_names().size()) {
+        PyErr_SetString(PyExc_ValueError, "Vertex has no name");
+        goto error;
+      }
+    }
+    if (!(name = PyGraph_VertexName(g, ID)))
+      goto error;
+    PyList_SET_ITEM(vs_list, i, name);
+  }
+  Py_XDECREF(seq);
+  return vs_list;
+
+error:
+  Py_XDECREF(seq);
+  Py_DECREF(vs_list);
+  return NULL;
+}
+
 /*******************************************************************************
  * Get a count of vertices in the graph                                        *
  ******************************************************************************/
@@ -147,11 +819,9 @@ static PyObject *py_get_vertices(PyObject *self, PyObject *args) {
 
   PyObject *vs_list = PyList_New(g->get_vcount());
 
-  size_t i = 0;
-  for (auto v : g->get_vertices()) {
-    id = Py_BuildValue("L", make_vertex_id(v).id);
+  for (size_t i = 0; i < g->get_vcount(); i++) {
+    id = Py_BuildValue("K", (unsigned long long)i);
     PyList_SetItem(vs_list, i, id);
-    i++;
   }
 
   result = Py_BuildValue("O", vs_list);
@@ -182,24 +852,32 @@ static PyObject *py_get_ecount(PyObject *self, PyObject *args) {
  * Get a vertex timestamp                                                      *
  ******************************************************************************/
 static PyObject *py_get_vertex_timestamp(PyObject *self, PyObject *args) {
-  vertex_id_t ID;
+  long long ID;
+  Graph *g;
+  PyObject *py_g;
 
-  if (!PyArg_ParseTuple(args,"L", &ID))
+  if (!PyArg_ParseTuple(args,"OL", &py_g, &ID))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)) || !PyGraph_CheckVertex(g, ID))
     return NULL;
 
-  return Py_BuildValue("L", ID.v->get_timestamp());
+  return Py_BuildValue("L", g->get_timestamp(ID));
 }
 
 /*******************************************************************************
  * Get a vertex in degree                                                      *
  ******************************************************************************/
 static PyObject *py_get_vertex_in_degree(PyObject *self, PyObject *args) {
-  vertex_id_t ID;
+  long long ID;
+  Graph *g;
+  PyObject *py_g;
 
-  if (!PyArg_ParseTuple(args,"L", &ID))
+  if (!PyArg_ParseTuple(args,"OL", &py_g, &ID))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)) || !PyGraph_CheckVertex(g, ID))
     return NULL;
 
-  return Py_BuildValue("L", ID.v->get_in_degree());
+  return Py_BuildValue("L", g->get_in_degree(ID));
 }
 
 /*******************************************************************************
@@ -207,17 +885,21 @@ static PyObject *py_get_vertex_in_degree(PyObject *self, PyObject *args) {
  ******************************************************************************/
 static PyObject *py_get_vertex_in_edges(PyObject *self, PyObject *args) {
 
-  vertex_id_t ID;
-  PyObject *source_id, *result;
+  long long ID;
+  Graph *g;
+  PyObject *py_g, *source_id, *result;
 
-  if (!PyArg_ParseTuple(args,"L", &ID))
+  if (!PyArg_ParseTuple(args,"OL", &py_g, &ID))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)) || !PyGraph_CheckVertex(g, ID))
     return NULL;
 
-  PyObject *vs_list = PyList_New(ID.v->get_in_degree());
+  std::vector<vertex_index_t> edges(g->get_in_edges(ID));
+  PyObject *vs_list = PyList_New(edges.size());
 
   size_t i = 0;
-  for (auto v : ID.v->get_in_edges()) {
-    source_id = Py_BuildValue("L", make_vertex_id(v).id);
+  for (auto v : edges) {
+    source_id = Py_BuildValue("K", (unsigned long long)v);
     PyList_SetItem(vs_list, i, source_id);
     i++;
   }
@@ -234,12 +916,16 @@ static PyObject *py_get_vertex_in_edges(PyObject *self, PyObject *args) {
  * Get a vertex out degree                                                     *
  ******************************************************************************/
 static PyObject *py_get_vertex_out_degree(PyObject *self, PyObject *args) {
-  vertex_id_t ID;
+  long long ID;
+  Graph *g;
+  PyObject *py_g;
 
-  if (!PyArg_ParseTuple(args,"L", &ID))
+  if (!PyArg_ParseTuple(args,"OL", &py_g, &ID))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)) || !PyGraph_CheckVertex(g, ID))
     return NULL;
 
-  return Py_BuildValue("L", ID.v->get_out_degree());
+  return Py_BuildValue("L", g->get_out_degree(ID));
 }
 
 /*******************************************************************************
@@ -247,17 +933,21 @@ static PyObject *py_get_vertex_out_degree(PyObject *self, PyObject *args) {
  ******************************************************************************/
 static PyObject *py_get_vertex_out_edges(PyObject *self, PyObject *args) {
 
-  vertex_id_t ID;
-  PyObject *target_id, *result;
+  long long ID;
+  Graph *g;
+  PyObject *py_g, *target_id, *result;
 
-  if (!PyArg_ParseTuple(args,"L", &ID))
+  if (!PyArg_ParseTuple(args,"OL", &py_g, &ID))
+    return NULL;
+  if (!(g = PyGraph_AsGraph(py_g)) || !PyGraph_CheckVertex(g, ID))
     return NULL;
 
-  PyObject *vs_list = PyList_New(ID.v->get_out_degree());
+  std::vector<vertex_index_t> edges(g->get_out_edges(ID));
+  PyObject *vs_list = PyList_New(edges.size());
 
   size_t i = 0;
-  for (auto v : ID.v->get_out_edges()) {
-    target_id = Py_BuildValue("L", make_vertex_id(v).id);
+  for (auto v : edges) {
+    target_id = Py_BuildValue("K", (unsigned long long)v);
     PyList_SetItem(vs_list, i, target_id);
     i++;
   }
@@ -270,19 +960,154 @@ static PyObject *py_get_vertex_out_edges(PyObject *self, PyObject *args) {
   return result;
 }
 
+/*******************************************************************************
+ * Get the timestamps of all vertices as an array                              *
+ ******************************************************************************/
+static PyObject *py_get_timestamps(PyObject *self, PyObject *args) {
+  Graph *g;
+  PyObject *py_g;
+
+  if (!PyArg_ParseTuple(args,"O", &py_g))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)))
+    return NULL;
+
+  return GraphArray_AsMemoryView(GraphArray_View(py_g,
+        g->get_frozen().get_timestamps(), g->get_vcount()));
+}
+
+/* Return an array of the in or out degrees of all vertices */
+static PyObject *get_degrees(PyObject *args, bool in) {
+  Graph *g;
+  PyObject *py_g;
+  int64_t *degrees;
+
+  if (!PyArg_ParseTuple(args,"O", &py_g))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)))
+    return NULL;
+
+  size_t n = g->get_vcount();
+  GraphArrayObject *result = GraphArray_Alloc(n, &degrees);
+  if (!result)
+    return NULL;
+
+  const FrozenGraph &fg = g->get_frozen();
+  const size_t *offsets = in ? fg.get_in_offsets() : fg.get_out_offsets();
+  Py_BEGIN_ALLOW_THREADS
+  for (size_t v = 0; v < n; v++)
+    degrees[v] = offsets[v + 1] - offsets[v];
+  Py_END_ALLOW_THREADS
+
+  return GraphArray_AsMemoryView(result);
+}
+
+/*******************************************************************************
+ * Get the in degrees of all vertices as an array                              *
+ ******************************************************************************/
+static PyObject *py_get_in_degrees(PyObject *self, PyObject *args) {
+  return get_degrees(args, true);
+}
+
+/*******************************************************************************
+ * Get the out degrees of all vertices as an array                             *
+ ******************************************************************************/
+static PyObject *py_get_out_degrees(PyObject *self, PyObject *args) {
+  return get_degrees(args, false);
+}
+
+/*
+ * Return a tuple of the CSR offsets and neighbors arrays of the in or
+ * out edges of the vertices in the optional int64 array of indices,
+ * or views of the graph's own arrays for all vertices.
+ */
+static PyObject *get_csr(PyObject *args, bool in) {
+  Graph *g;
+  PyObject *py_g, *py_ids = NULL;
+  Py_buffer ids;
+
+  if (!PyArg_ParseTuple(args,"O|O", &py_g, &py_ids))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)))
+    return NULL;
+
+  const FrozenGraph &fg = g->get_frozen();
+  const size_t *offsets = in ? fg.get_in_offsets() : fg.get_out_offsets();
+  const vertex_index_t *neighbors = in ? fg.get_in_sources() : fg.get_out_targets();
+
+  if (!py_ids || py_ids == Py_None) {
+    size_t n = g->get_vcount();
+    return Py_BuildValue("(NN)",
+        GraphArray_AsMemoryView(GraphArray_View(py_g, offsets, n + 1)),
+        GraphArray_AsMemoryView(GraphArray_View(py_g, neighbors, offsets[n])));
+  }
+
+  if (!get_int64_buffer(py_ids, &ids))
+    return NULL;
+  const int64_t *vs = (const int64_t *)ids.buf;
+  size_t k = ids.len / sizeof(int64_t);
+  size_t *sub_offsets;
+  vertex_index_t *sub_neighbors;
+  GraphArrayObject *result_offsets = NULL, *result_neighbors = NULL;
+
+  for (size_t i = 0; i < k; i++)
+    if (!PyGraph_CheckVertex(g, vs[i]))
+      goto error;
+  if (!(result_offsets = GraphArray_Alloc(k + 1, &sub_offsets)))
+    goto error;
+  sub_offsets[0] = 0;
+  for (size_t i = 0; i < k; i++)
+    sub_offsets[i + 1] = sub_offsets[i] + offsets[vs[i] + 1] - offsets[vs[i]];
+  if (!(result_neighbors = GraphArray_Alloc(sub_offsets[k], &sub_neighbors)))
+    goto error;
+
+  Py_BEGIN_ALLOW_THREADS
+  for (size_t i = 0; i < k; i++)
+    std::copy(neighbors + offsets[vs[i]], neighbors + offsets[vs[i] + 1],
+        sub_neighbors + sub_offsets[i]);
+  Py_END_ALLOW_THREADS
+
+  PyBuffer_Release(&ids);
+  return Py_BuildValue("(NN)", GraphArray_AsMemoryView(result_offsets),
+      GraphArray_AsMemoryView(result_neighbors));
+
+error:
+  Py_XDECREF(result_offsets);
+  PyBuffer_Release(&ids);
+  return NULL;
+}
+
+/*******************************************************************************
+ * Get the CSR offsets and source arrays of vertices' in edges                 *
+ ******************************************************************************/
+static PyObject *py_get_in_csr(PyObject *self, PyObject *args) {
+  return get_csr(args, true);
+}
+
+/*******************************************************************************
+ * Get the CSR offsets and target arrays of vertices' out edges                *
+ ******************************************************************************/
+static PyObject *py_get_out_csr(PyObject *self, PyObject *args) {
+  return get_csr(args, false);
+}
+
 /*******************************************************************************
  * Compute the CD index                                                        *
  ******************************************************************************/
 static PyObject *py_cdindex(PyObject *self, PyObject *args) {
-  vertex_id_t ID;
+  long long ID;
   timestamp_t TIMESTAMP;
+  Graph *g;
+  PyObject *py_g;
 
   double result;
 
-  if (!PyArg_ParseTuple(args,"LL", &ID, &TIMESTAMP))
+  if (!PyArg_ParseTuple(args,"OLL", &py_g, &ID, &TIMESTAMP))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)) || !PyGraph_CheckVertex(g, ID))
     return NULL;
 
-  result = cdindex(ID, TIMESTAMP);
+  result = cdindex(*g, ID, TIMESTAMP);
   
   return Py_BuildValue("d", result);
 }
@@ -291,14 +1116,18 @@ static PyObject *py_cdindex(PyObject *self, PyObject *args) {
  * Compute the mCD index                                                       *
  ******************************************************************************/
 static PyObject *py_mcdindex(PyObject *self, PyObject *args) {
-  vertex_id_t ID;
+  long long ID;
   timestamp_t TIMESTAMP;
+  Graph *g;
+  PyObject *py_g;
   double result;
 
-  if (!PyArg_ParseTuple(args,"LL", &ID, &TIMESTAMP))
+  if (!PyArg_ParseTuple(args,"OLL", &py_g, &ID, &TIMESTAMP))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)) || !PyGraph_CheckVertex(g, ID))
     return NULL;
 
-  result = mcdindex(ID, TIMESTAMP);
+  result = mcdindex(*g, ID, TIMESTAMP);
   
   return Py_BuildValue("d", result);
 }
@@ -307,27 +1136,500 @@ static PyObject *py_mcdindex(PyObject *self, PyObject *args) {
  * Compute the I index                                                       *
  ******************************************************************************/
 static PyObject *py_iindex(PyObject *self, PyObject *args) {
-  vertex_id_t ID;
+  long long ID;
   timestamp_t TIMESTAMP;
+  Graph *g;
+  PyObject *py_g;
   double result;
 
-  if (!PyArg_ParseTuple(args,"LL", &ID, &TIMESTAMP))
+  if (!PyArg_ParseTuple(args,"OLL", &py_g, &ID, &TIMESTAMP))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)) || !PyGraph_CheckVertex(g, ID))
     return NULL;
 
-  result = iindex(ID, TIMESTAMP);
+  result = iindex(*g, ID, TIMESTAMP);
   
   return Py_BuildValue("d", result);
 }
 
+/*******************************************************************************
+ * Set the kernel used for intersecting citer and focal vertex references      *
+ ******************************************************************************/
+static PyObject *py_set_intersection_kernel(PyObject *self, PyObject *args) {
+  static const struct {
+    const char *name;
+    intersection_kernel_t kernel;
+  } kernels[] = {
+    {"adaptive", INTERSECT_ADAPTIVE},
+    {"binary_search", INTERSECT_BINARY_SEARCH},
+    {"merge", INTERSECT_MERGE},
+    {"gallop", INTERSECT_GALLOP},
+    {"bitmap", INTERSECT_BITMAP},
+    {"simd", INTERSECT_SIMD},
+  };
+  const char *name;
+
+  if (!PyArg_ParseTuple(args,"s", &name))
+    return NULL;
+
+  for (auto k : kernels)
+    if (strcmp(k.name, name) == 0) {
+      set_intersection_kernel(k.kernel);
+      return Py_BuildValue("");
+    }
+  PyErr_Format(PyExc_ValueError, "Unknown intersection kernel: %s", name);
+  return NULL;
+}
+
+/*******************************************************************************
+ * Set the order in which batch computations process their focal vertices      *
+ ******************************************************************************/
+static PyObject *py_set_batch_schedule(PyObject *self, PyObject *args) {
+  static const struct {
+    const char *name;
+    batch_schedule_t schedule;
+  } schedules[] = {
+    {"given", SCHEDULE_GIVEN},
+    {"timestamp", SCHEDULE_TIMESTAMP},
+  };
+  const char *name;
+
+  if (!PyArg_ParseTuple(args,"s", &name))
+    return NULL;
+
+  for (auto s : schedules)
+    if (strcmp(s.name, name) == 0) {
+      set_batch_schedule(s.schedule);
+      return Py_BuildValue("");
+    }
+  PyErr_Format(PyExc_ValueError, "Unknown batch schedule: %s", name);
+  return NULL;
+}
+
+/*******************************************************************************
+ * Get the statistics of the computations as a dictionary                      *
+ ******************************************************************************/
+static PyObject *py_get_stats(PyObject *self, PyObject *args) {
+  cdindex_stats_t s;
+
+  if (!get_stats(s)) {
+    PyErr_SetString(PyExc_RuntimeError,
+        "Statistics are not collected; build with CDINDEX_STATS set");
+    return NULL;
+  }
+
+  PyObject *buckets = PyList_New(0);
+  if (!buckets)
+    return NULL;
+  for (int i = 0; i < STATS_DEGREE_BUCKETS; i++)
+    if (s.degree_vertices[i]) {
+      PyObject *bucket = Py_BuildValue("(KKKd)", (1ULL << i) - 1, (2ULL << i) - 2,
+          (unsigned long long)s.degree_vertices[i], s.degree_nanoseconds[i] / 1e9);
+      if (!bucket || PyList_Append(buckets, bucket) < 0) {
+        Py_XDECREF(bucket);
+        Py_DECREF(buckets);
+        return NULL;
+      }
+      Py_DECREF(bucket);
+    }
+
+  PyObject *top = PyList_New(s.top_count);
+  if (!top) {
+    Py_DECREF(buckets);
+    return NULL;
+  }
+  for (int i = 0; i < s.top_count; i++) {
+    PyObject *cost = Py_BuildValue("(Kd)", (unsigned long long)s.top[i].vertex,
+        s.top[i].nanoseconds / 1e9);
+    if (!cost) {
+      Py_DECREF(top);
+      Py_DECREF(buckets);
+      return NULL;
+    }
+    PyList_SET_ITEM(top, i, cost);
+  }
+
+  return Py_BuildValue("{sKsKsKsKsKsKsKsNsN}",
+      "focal_vertices", (unsigned long long)s.focal_vertices,
+      "citers_visited", (unsigned long long)s.citers_visited,
+      "window_rejects", (unsigned long long)s.window_rejects,
+      "it_vertices", (unsigned long long)s.it_vertices,
+      "out_edge_probes", (unsigned long long)s.out_edge_probes,
+      "intersections", (unsigned long long)s.intersections,
+      "intersections_short_circuited", (unsigned long long)s.intersections_short_circuited,
+      "degree_buckets", buckets,
+      "top", top);
+}
+
+/*******************************************************************************
+ * Clear the statistics of the computations                                    *
+ ******************************************************************************/
+static PyObject *py_reset_stats(PyObject *self, PyObject *args) {
+  reset_stats();
+  return Py_BuildValue("");
+}
+
+/*******************************************************************************
+ * Compute the CD, mCD, and I indices for many time windows                    *
+ ******************************************************************************/
+static PyObject *py_cdindex_windows(PyObject *self, PyObject *args) {
+  long long ID;
+  Graph *g;
+  PyObject *py_g, *py_deltas, *result;
+  static thread_local ScratchContext scratch;
+
+  if (!PyArg_ParseTuple(args,"OLO", &py_g, &ID, &py_deltas))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)) || !PyGraph_CheckVertex(g, ID))
+    return NULL;
+
+  PyObject *seq = PySequence_Fast(py_deltas, "Time deltas must be a sequence");
+  if (!seq)
+    return NULL;
+  Py_ssize_t k = PySequence_Fast_GET_SIZE(seq);
+  std::vector<timestamp_t> deltas(k);
+  for (Py_ssize_t i = 0; i < k; i++) {
+    deltas[i] = PyLong_AsLongLong(PySequence_Fast_GET_ITEM(seq, i));
+    if (PyErr_Occurred()) {
+      Py_DECREF(seq);
+      return NULL;
+    }
+  }
+  Py_DECREF(seq);
+  if (!std::is_sorted(deltas.begin(), deltas.end())) {
+    PyErr_SetString(PyExc_ValueError, "Time deltas must be in ascending order");
+    return NULL;
+  }
+
+  std::vector<index_values_t> values(k);
+  cdindex_windows(*g, ID, deltas.data(), k, values.data(), scratch);
+
+  PyObject *vs_list = PyList_New(k);
+  for (Py_ssize_t i = 0; i < k; i++)
+    PyList_SetItem(vs_list, i, Py_BuildValue("(ddL)", values[i].cdindex,
+          values[i].mcdindex, (long long)values[i].iindex));
+
+  result = Py_BuildValue("O", vs_list);
+
+  // clean up 
+  Py_DECREF(vs_list);
+
+  return result;
+}
+
+/*******************************************************************************
+ * Compute the CD, mCD, and I indices of all or some vertices in parallel       *
+ ******************************************************************************/
+static PyObject *py_cdindex_all(PyObject *self, PyObject *args) {
+  Graph *g;
+  PyObject *py_g, *py_ids = NULL, *result;
+  timestamp_t TIMESTAMP;
+  unsigned int nthreads = 0;
+
+  if (!PyArg_ParseTuple(args,"OL|IO", &py_g, &TIMESTAMP, &nthreads, &py_ids))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)))
+    return NULL;
+
+  std::vector<vertex_index_t> focal;
+  if (py_ids && py_ids != Py_None) {
+    PyObject *seq = PySequence_Fast(py_ids, "Vertex ids must be a sequence");
+    if (!seq)
+      return NULL;
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    focal.reserve(n);
+    for (Py_ssize_t i = 0; i < n; i++) {
+      long long ID = PyLong_AsLongLong(PySequence_Fast_GET_ITEM(seq, i));
+      if (PyErr_Occurred() || !PyGraph_CheckVertex(g, ID)) {
+        Py_DECREF(seq);
+        return NULL;
+      }
+      focal.push_back(ID);
+    }
+    Py_DECREF(seq);
+  }
+
+  size_t n = py_ids && py_ids != Py_None ? focal.size() : g->get_vcount();
+  std::vector<index_values_t> values(n);
+
+  Py_BEGIN_ALLOW_THREADS
+  if (py_ids && py_ids != Py_None)
+    cdindex_batch(*g, focal.data(), n, TIMESTAMP, values.data(), nthreads);
+  else
+    cdindex_all(*g, TIMESTAMP, values.data(), nthreads);
+  Py_END_ALLOW_THREADS
+
+  PyObject *vs_list = PyList_New(n);
+  for (size_t i = 0; i < n; i++)
+    PyList_SetItem(vs_list, i, Py_BuildValue("(ddL)", values[i].cdindex,
+          values[i].mcdindex, (long long)values[i].iindex));
+
+  result = Py_BuildValue("O", vs_list);
+
+  // clean up 
+  Py_DECREF(vs_list);
+
+  return result;
+}
+
+/*******************************************************************************
+ * Compute the CD, mCD, and I indices of all vertices in a time sweep          *
+ ******************************************************************************/
+static PyObject *py_cdindex_sweep(PyObject *self, PyObject *args) {
+  Graph *g;
+  PyObject *py_g, *result;
+  timestamp_t TIMESTAMP;
+  unsigned int nthreads = 0;
+
+  if (!PyArg_ParseTuple(args,"OL|I", &py_g, &TIMESTAMP, &nthreads))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)))
+    return NULL;
+
+  size_t n = g->get_vcount();
+  std::vector<index_values_t> values(n);
+
+  Py_BEGIN_ALLOW_THREADS
+  cdindex_sweep(*g, TIMESTAMP, values.data(), nthreads);
+  Py_END_ALLOW_THREADS
+
+  PyObject *vs_list = PyList_New(n);
+  for (size_t i = 0; i < n; i++)
+    PyList_SetItem(vs_list, i, Py_BuildValue("(ddL)", values[i].cdindex,
+          values[i].mcdindex, (long long)values[i].iindex));
+
+  result = Py_BuildValue("O", vs_list);
+
+  // clean up 
+  Py_DECREF(vs_list);
+
+  return result;
+}
+
+/*******************************************************************************
+ * Compute the CD, mCD, and I indices of many vertices into arrays              *
+ ******************************************************************************/
+static PyObject *py_cdindex_arrays(PyObject *self, PyObject *args) {
+  Graph *g;
+  PyObject *py_g, *py_ids = NULL;
+  Py_buffer ids;
+  timestamp_t TIMESTAMP;
+  unsigned int nthreads = 0;
+  double *cd, *mcd;
+  int64_t *ii;
+
+  if (!PyArg_ParseTuple(args,"OL|IO", &py_g, &TIMESTAMP, &nthreads, &py_ids))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)))
+    return NULL;
+
+  bool all = !py_ids || py_ids == Py_None;
+  std::vector<vertex_index_t> focal;
+  if (!all) {
+    if (!get_int64_buffer(py_ids, &ids))
+      return NULL;
+    const int64_t *vs = (const int64_t *)ids.buf;
+    size_t k = ids.len / sizeof(int64_t);
+    for (size_t i = 0; i < k; i++)
+      if (!PyGraph_CheckVertex(g, vs[i])) {
+        PyBuffer_Release(&ids);
+        return NULL;
+      }
+    focal.assign(vs, vs + k);
+    PyBuffer_Release(&ids);
+  }
+
+  size_t n = all ? g->get_vcount() : focal.size();
+  GraphArrayObject *result_cd = GraphArray_Alloc(n, &cd);
+  GraphArrayObject *result_mcd = result_cd ? GraphArray_Alloc(n, &mcd) : NULL;
+  GraphArrayObject *result_i = result_mcd ? GraphArray_Alloc(n, &ii) : NULL;
+  if (!result_i) {
+    Py_XDECREF(result_cd);
+    Py_XDECREF(result_mcd);
+    return NULL;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  std::vector<index_values_t> values(n);
+  if (all)
+    cdindex_all(*g, TIMESTAMP, values.data(), nthreads);
+  else
+    cdindex_batch(*g, focal.data(), n, TIMESTAMP, values.data(), nthreads);
+  for (size_t i = 0; i < n; i++) {
+    cd[i] = values[i].cdindex;
+    mcd[i] = values[i].mcdindex;
+    ii[i] = values[i].iindex;
+  }
+  Py_END_ALLOW_THREADS
+
+  return Py_BuildValue("(NNN)", GraphArray_AsMemoryView(result_cd),
+      GraphArray_AsMemoryView(result_mcd), GraphArray_AsMemoryView(result_i));
+}
+
+/*******************************************************************************
+ * Estimate the CD index from a sample of the "it" vertices                    *
+ ******************************************************************************/
+static PyObject *py_cdindex_approximate(PyObject *self, PyObject *args) {
+  long long ID;
+  timestamp_t TIMESTAMP;
+  unsigned long long budget, seed = 0;
+  Graph *g;
+  PyObject *py_g;
+  static thread_local ScratchContext scratch;
+
+  if (!PyArg_ParseTuple(args,"OLLK|K", &py_g, &ID, &TIMESTAMP, &budget, &seed))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)) || !PyGraph_CheckVertex(g, ID))
+    return NULL;
+
+  cdindex_estimate_t e = cdindex_approximate(*g, ID, TIMESTAMP, budget, scratch, seed);
+  return Py_BuildValue("(dddO)", e.cdindex, e.low, e.high, e.exact ? Py_True : Py_False);
+}
+
+/*******************************************************************************
+ * Estimate the CD indices of many vertices in parallel                        *
+ ******************************************************************************/
+static PyObject *py_cdindex_approximate_all(PyObject *self, PyObject *args) {
+  Graph *g;
+  PyObject *py_g, *py_ids = NULL;
+  Py_buffer ids;
+  timestamp_t TIMESTAMP;
+  unsigned long long budget, seed = 0;
+  unsigned int nthreads = 0;
+
+  if (!PyArg_ParseTuple(args,"OLK|IOK", &py_g, &TIMESTAMP, &budget, &nthreads,
+        &py_ids, &seed))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)))
+    return NULL;
+
+  bool all = !py_ids || py_ids == Py_None;
+  std::vector<vertex_index_t> focal;
+  if (!all) {
+    if (!get_int64_buffer(py_ids, &ids))
+      return NULL;
+    const int64_t *vs = (const int64_t *)ids.buf;
+    size_t k = ids.len / sizeof(int64_t);
+    for (size_t i = 0; i < k; i++)
+      if (!PyGraph_CheckVertex(g, vs[i])) {
+        PyBuffer_Release(&ids);
+        return NULL;
+      }
+    focal.assign(vs, vs + k);
+    PyBuffer_Release(&ids);
+  }
+
+  size_t n = all ? g->get_vcount() : focal.size();
+  std::vector<cdindex_estimate_t> estimates(n);
+
+  Py_BEGIN_ALLOW_THREADS
+  cdindex_approximate_batch(*g, all ? NULL : focal.data(), n, TIMESTAMP, budget,
+      estimates.data(), nthreads, seed);
+  Py_END_ALLOW_THREADS
+
+  PyObject *es_list = PyList_New(n);
+  if (!es_list)
+    return NULL;
+  for (size_t i = 0; i < n; i++)
+    PyList_SetItem(es_list, i, Py_BuildValue("(dddO)", estimates[i].cdindex,
+          estimates[i].low, estimates[i].high, estimates[i].exact ? Py_True : Py_False));
+  return es_list;
+}
+
+/*******************************************************************************
+ * Create a tracker maintaining the indices of a graph's vertices               *
+ ******************************************************************************/
+static PyObject *py_Tracker(PyObject *self, PyObject *args) {
+  timestamp_t TIMESTAMP;
+
+  if (!PyArg_ParseTuple(args,"L", &TIMESTAMP))
+    return NULL;
+
+  return PyCapsule_New(new CDIndexTracker(TIMESTAMP), "CDIndexTracker", del_Tracker);
+}
+
+/*******************************************************************************
+ * Account for the vertices added to a graph since the last tracker update      *
+ ******************************************************************************/
+static PyObject *py_tracker_update(PyObject *self, PyObject *args) {
+  CDIndexTracker *tracker;
+  Graph *g;
+  PyObject *py_tracker, *py_g, *result;
+  unsigned int nthreads = 0;
+  std::vector<vertex_index_t> changed;
+
+  if (!PyArg_ParseTuple(args,"OO|I", &py_tracker, &py_g, &nthreads))
+    return NULL;
+  if (!(tracker = (CDIndexTracker *)PyCapsule_GetPointer(py_tracker, "CDIndexTracker")))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)))
+    return NULL;
+  if (g->get_vcount() < tracker->get_vcount()) {
+    PyErr_SetString(PyExc_ValueError, "Graph has fewer vertices than those tracked");
+    return NULL;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  changed = tracker->update(*g, nthreads);
+  Py_END_ALLOW_THREADS
+
+  PyObject *vs_list = PyList_New(changed.size());
+  for (size_t i = 0; i < changed.size(); i++)
+    PyList_SetItem(vs_list, i, Py_BuildValue("K", (unsigned long long)changed[i]));
+
+  result = Py_BuildValue("O", vs_list);
+
+  // clean up 
+  Py_DECREF(vs_list);
+
+  return result;
+}
+
+/*******************************************************************************
+ * Get the CD, mCD, and I indices of a vertex maintained by a tracker           *
+ ******************************************************************************/
+static PyObject *py_tracker_values(PyObject *self, PyObject *args) {
+  CDIndexTracker *tracker;
+  Graph *g;
+  PyObject *py_tracker, *py_g;
+  long long ID;
+
+  if (!PyArg_ParseTuple(args,"OOL", &py_tracker, &py_g, &ID))
+    return NULL;
+  if (!(tracker = (CDIndexTracker *)PyCapsule_GetPointer(py_tracker, "CDIndexTracker")))
+    return NULL;
+  if (!(g = PyGraph_AsPreparedGraph(py_g)))
+    return NULL;
+  if (ID < 0 || (unsigned long long)ID >= tracker->get_vcount()) {
+    PyErr_SetString(PyExc_IndexError, "Vertex index out of range");
+    return NULL;
+  }
+
+  index_values_t values = tracker->get_values(*g, ID);
+  return Py_BuildValue("(ddL)", values.cdindex, values.mcdindex, (long long)values.iindex);
+}
+
 
 /*******************************************************************************
  * Module method table                                                         *
  ******************************************************************************/
 static PyMethodDef CDIndexMethods[] = {
   {"Graph",  py_Graph, METH_VARARGS, "Make a graph"},
+  {"save_graph", py_save_graph, METH_VARARGS, "Save a prepared graph to a file"},
+  {"load_graph", py_load_graph, METH_VARARGS, "Load a graph by mapping a file written by save_graph"},
   {"_is_graph_sane", py_is_graph_sane, METH_VARARGS, "Test graph sanity"},
   {"add_vertex", py_add_vertex, METH_VARARGS, "Add a vertex to a graph"},
   {"add_edge", py_add_edge, METH_VARARGS, "Add an edge to a graph"},
+  {"add_named_vertex", py_add_named_vertex, METH_VARARGS, "Add a vertex with a unique string name to a graph"},
+  {"add_named_edge", py_add_named_edge, METH_VARARGS, "Add an edge between two named vertices to a graph"},
+  {"name_vertices", py_name_vertices, METH_VARARGS, "Name the unnamed vertices of a graph in order"},
+  {"get_name_count", py_get_name_count, METH_VARARGS, "Get the number of named vertices in the graph"},
+  {"get_vertex_id", py_get_vertex_id, METH_VARARGS, "Get the index of a named vertex"},
+  {"get_vertex_ids", py_get_vertex_ids, METH_VARARGS, "Get the indices of a sequence of named vertices as an int64 array"},
+  {"get_vertex_name", py_get_vertex_name, METH_VARARGS, "Get the name of a vertex"},
+  {"get_vertex_names", py_get_vertex_names, METH_VARARGS, "Get the names of all vertices or of a sequence of vertex indices"},
+  {"add_vertices", py_add_vertices, METH_VARARGS, "Add vertices with the timestamps of an int64 array to a graph"},
+  {"add_edges", py_add_edges, METH_VARARGS, "Add edges between the vertex indices of two int64 arrays to a graph"},
   {"get_vertices", py_get_vertices, METH_VARARGS, "Get a list of vertices in the graph"},
   {"get_vcount", py_get_vcount, METH_VARARGS, "Get the number of vertices in the graph"},
   {"get_ecount", py_get_ecount, METH_VARARGS, "Get the number of edges in the graph"},
@@ -336,10 +1638,29 @@ static PyMethodDef CDIndexMethods[] = {
   {"get_vertex_in_edges", py_get_vertex_in_edges, METH_VARARGS, "Get the in edges of a vertex"},
   {"get_vertex_out_degree", py_get_vertex_out_degree, METH_VARARGS, "Get the out degree of a vertex"},
   {"get_vertex_out_edges", py_get_vertex_out_edges, METH_VARARGS, "Get the out edges of a vertex"},
+  {"get_timestamps", py_get_timestamps, METH_VARARGS, "Get the timestamps of all vertices as an int64 array viewing the graph"},
+  {"get_in_degrees", py_get_in_degrees, METH_VARARGS, "Get the in degrees of all vertices as an int64 array"},
+  {"get_out_degrees", py_get_out_degrees, METH_VARARGS, "Get the out degrees of all vertices as an int64 array"},
+  {"get_in_csr", py_get_in_csr, METH_VARARGS, "Get the CSR offsets and sources of the in edges of all or an int64 array of vertices"},
+  {"get_out_csr", py_get_out_csr, METH_VARARGS, "Get the CSR offsets and targets of the out edges of all or an int64 array of vertices"},
   {"cdindex", py_cdindex, METH_VARARGS, "Compute the CD index"},
   {"mcdindex", py_mcdindex, METH_VARARGS, "Compute the mCD index"},
   {"iindex", py_iindex, METH_VARARGS, "Compute the I index"},
-  {"prepare_for_searching", py_prepare_for_searching, METH_VARARGS, "Prepare graph for searching"},
+  {"set_intersection_kernel", py_set_intersection_kernel, METH_VARARGS, "Set the kernel used for intersecting references: adaptive, binary_search, merge, gallop, bitmap, or simd"},
+  {"set_batch_schedule", py_set_batch_schedule, METH_VARARGS, "Set the order in which batch computations process their vertices: given or timestamp"},
+  {"get_stats", py_get_stats, METH_NOARGS, "Get the statistics of the computations, if the module was built to collect them"},
+  {"reset_stats", py_reset_stats, METH_NOARGS, "Clear the statistics of the computations"},
+  {"cdindex_windows", py_cdindex_windows, METH_VARARGS, "Compute the CD, mCD, and I indices for many time windows"},
+  {"cdindex_all", py_cdindex_all, METH_VARARGS, "Compute the CD, mCD, and I indices of many vertices in parallel"},
+  {"cdindex_sweep", py_cdindex_sweep, METH_VARARGS, "Compute the CD, mCD, and I indices of all vertices in a time sweep of their citers"},
+  {"cdindex_approximate", py_cdindex_approximate, METH_VARARGS, "Estimate the CD index from a sample of at most the specified number of it vertices, with its 95% confidence interval"},
+  {"cdindex_approximate_all", py_cdindex_approximate_all, METH_VARARGS, "Estimate the CD indices of all or an int64 array of vertices in parallel"},
+  {"cdindex_arrays", py_cdindex_arrays, METH_VARARGS, "Compute the CD, mCD, and I indices of all or an int64 array of vertices into arrays"},
+  {"prepare_for_searching", py_prepare_for_searching, METH_VARARGS, "Prepare graph for searching, optionally with the specified number of threads"},
+  {"relabel", py_relabel, METH_VARARGS, "Renumber the vertices of a prepared graph in the timestamp, rcm, or references order, returning the previous index of each"},
+  {"Tracker", py_Tracker, METH_VARARGS, "Make a tracker maintaining the indices of a graph's vertices for a time delta"},
+  {"tracker_update", py_tracker_update, METH_VARARGS, "Account for the vertices added to a prepared graph, returning those whose indices changed"},
+  {"tracker_values", py_tracker_values, METH_VARARGS, "Get the CD, mCD, and I indices of a vertex maintained by a tracker"},
   { NULL, NULL, 0, NULL}
 };
 
@@ -360,11 +1681,15 @@ static struct PyModuleDef _cdindex =
 
 PyMODINIT_FUNC PyInit__cdindex(void)
 {
+    if (!GraphArray_Ready())
+      return NULL;
     return PyModule_Create(&_cdindex);
 }
 #else
 PyMODINIT_FUNC
 init_cdindex(void) {
+    if (!GraphArray_Ready())
+      return;
     (void) Py_InitModule("_cdindex", CDIndexMethods);
 }
 #endif
@@ -7,6 +7,7 @@ __author__ = "Russell J. Funk and Diomidis Spinellis"
 __copyright__ = "Copyright (C) 2019, 2023"
 
 # built in modules
+import os
 from setuptools import setup, Extension, find_packages
 
 setup(name="fast_cdindex",
@@ -20,8 +21,16 @@ setup(name="fast_cdindex",
     ext_modules=[
                   Extension("fast_cdindex._cdindex",
                             ["src/cdindex.cpp", 
+                             "src/compressed.cpp",
+                             "src/graph_file.cpp",
+                             "src/name_index.cpp",
+                             "src/numa.cpp",
+                             "src/shard.cpp",
                              "fast_cdindex/pycdindex.cpp"],
                              include_dirs = ["src"],
+                             # Set CDINDEX_STATS in the environment to collect statistics
+                             define_macros = [("CDINDEX_STATS", None)]
+                                 if os.environ.get("CDINDEX_STATS") else [],
                              headers = ["src/cdindex.h"],
                            )
                 ],
@@ -0,0 +1,715 @@
+/*
+  fast-cdindex library.
+  Copyright (C) 2017 Russell J. Funk <russellfunk@gmail.com>
+  Copyright (C) 2023 Diomidis Spinellis <dds@aueb.gr>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Benchmark the library on a synthetic citation graph.
+ *
+ * Publications appear in yearly cohorts of (optionally) growing size.
+ * Each publication cites earlier ones: with a configurable probability
+ * a cited work is chosen in proportion to the citations it has already
+ * received (preferential attachment), otherwise uniformly among all
+ * earlier works. The number of references follows a configurable
+ * distribution, giving the heavy-tailed in and out degrees of real
+ * citation graphs.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "cdindex.h"
+
+const timestamp_t SECONDS_PER_YEAR = 365 * 24 * 60 * 60;
+
+/* Parameters of the generated graph and of the benchmark runs */
+typedef struct {
+  size_t vertices;		// Number of publications
+  unsigned years;		// Number of yearly cohorts
+  double growth;		// Yearly cohort growth rate
+  double mean_references;	// Mean number of references per publication
+  const char *distribution;	// Distribution of the number of references
+  double preferential;		// Probability of preferential attachment
+  unsigned long seed;		// Random number generator seed
+  unsigned window_years;	// CD index time window
+  size_t sample;		// Number of focal vertices to compute; 0 for all
+  std::vector<unsigned> threads;	// Thread counts to measure
+  bool kernels;			// Measure each intersection kernel
+  bool locality;		// Measure each vertex order and batch schedule
+  double incremental;		// Fraction of vertices added incrementally
+  bool compressed;		// Measure compressed adjacency lists
+  bool sweep;			// Measure the time sweep of all vertices
+  bool numa;			// Measure each NUMA placement of the graph
+} bench_options_t;
+
+/* A generated graph as arrays suitable for bulk ingestion */
+typedef struct {
+  std::vector<timestamp_t> timestamps;
+  std::vector<int64_t> sources;
+  std::vector<int64_t> targets;
+} edge_arrays_t;
+
+/* Return the seconds elapsed since the specified time point */
+static double
+elapsed(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* Return the process's peak resident set size in MB */
+static double
+peak_rss_mb()
+{
+  struct rusage ru;
+
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss / 1024.0;	// Reported in KB on Linux
+}
+
+/*
+ * A counter of the last-level cache misses of the process's threads,
+ * including those it creates after the counter is opened.
+ * The counter is unavailable when the kernel does not permit
+ * performance monitoring, for example in containers.
+ */
+class CacheMissCounter {
+private:
+  int fd;
+
+public:
+  CacheMissCounter() {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+  ~CacheMissCounter() {
+    if (fd >= 0)
+      close(fd);
+  }
+
+  bool available() const { return fd >= 0; }
+
+  void start() {
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  // Return the misses since start
+  uint64_t stop() {
+    uint64_t count = 0;
+
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd, &count, sizeof(count)) != sizeof(count))
+        count = 0;
+    }
+    return count;
+  }
+};
+
+/* Return a number of references drawn from the configured distribution */
+static size_t
+reference_count(const bench_options_t &opt, std::mt19937_64 &rng)
+{
+  double mean = opt.mean_references;
+
+  if (strcmp(opt.distribution, "fixed") == 0)
+    return size_t(mean + 0.5);
+  if (strcmp(opt.distribution, "poisson") == 0)
+    return std::poisson_distribution<size_t>(mean)(rng);
+  if (strcmp(opt.distribution, "pareto") == 0) {
+    // Pareto with shape 2 (infinite variance) and the specified mean
+    double u = std::uniform_real_distribution<double>(0, 1)(rng);
+    return size_t(mean / 2 / std::sqrt(1 - u));
+  }
+  // Lognormal with sigma 1 and the specified mean
+  const double sigma = 1.0;
+  return size_t(std::lognormal_distribution<double>(std::log(mean) - sigma * sigma / 2, sigma)(rng));
+}
+
+/*
+ * Generate a citation graph with the specified options.
+ * Return the graph as arrays of vertex timestamps and edge endpoints.
+ */
+static edge_arrays_t
+generate_graph(const bench_options_t &opt)
+{
+  std::mt19937_64 rng(opt.seed);
+  edge_arrays_t g;
+
+  // Cohort sizes growing geometrically and summing to the vertex count
+  std::vector<size_t> cohort(opt.years);
+  double total = 0;
+  for (unsigned y = 0; y < opt.years; y++)
+    total += std::pow(1 + opt.growth, y);
+  size_t assigned = 0;
+  for (unsigned y = 0; y < opt.years; y++) {
+    cohort[y] = size_t(opt.vertices * std::pow(1 + opt.growth, y) / total);
+    assigned += cohort[y];
+  }
+  cohort[opt.years - 1] += opt.vertices - assigned;
+
+  /*
+   * Works that can be cited: each earlier one once, plus once more for
+   * every citation it received. Drawing uniformly from it realizes
+   * preferential attachment.
+   */
+  std::vector<int64_t> attachment;
+  std::vector<int64_t> refs;
+  std::uniform_real_distribution<double> coin(0, 1);
+  std::uniform_int_distribution<timestamp_t> day(0, 364);
+
+  g.timestamps.reserve(opt.vertices);
+  for (unsigned y = 0; y < opt.years; y++) {
+    int64_t first = g.timestamps.size();
+    std::vector<int64_t> cited;
+
+    for (size_t i = 0; i < cohort[y]; i++) {
+      int64_t v = g.timestamps.size();
+      g.timestamps.push_back(y * SECONDS_PER_YEAR + day(rng) * 24 * 60 * 60);
+      if (first == 0)
+        continue;
+
+      size_t n = std::min<size_t>(reference_count(opt, rng), first);
+      refs.clear();
+      for (size_t k = 0; k < n; k++)
+        if (coin(rng) < opt.preferential)
+          refs.push_back(attachment[rng() % attachment.size()]);
+        else
+          refs.push_back(rng() % first);
+      std::sort(refs.begin(), refs.end());
+      refs.erase(std::unique(refs.begin(), refs.end()), refs.end());
+      for (auto r : refs) {
+        g.sources.push_back(v);
+        g.targets.push_back(r);
+        cited.push_back(r);
+      }
+    }
+
+    // Make this cohort's works and citations available to later ones
+    for (int64_t v = first; v < int64_t(g.timestamps.size()); v++)
+      attachment.push_back(v);
+    attachment.insert(attachment.end(), cited.begin(), cited.end());
+  }
+  return g;
+}
+
+/*
+ * Measure the ingestion of the generated edges by as many concurrent
+ * producer threads as each measured thread count, followed by the
+ * building of the graph from them.
+ */
+static void
+bench_builder(const bench_options_t &opt, const edge_arrays_t &arrays)
+{
+  size_t ecount = arrays.sources.size();
+
+  for (auto threads : opt.threads) {
+    GraphBuilder builder(threads);
+    auto start = std::chrono::steady_clock::now();
+    builder.get_producer(0).add_vertices(arrays.timestamps.data(), arrays.timestamps.size());
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+      workers.emplace_back([&, t]() {
+        size_t begin = ecount * t / threads, end = ecount * (t + 1) / threads;
+        builder.get_producer(t).add_edges(arrays.sources.data() + begin,
+            arrays.targets.data() + begin, end - begin);
+      });
+    for (auto &w : workers)
+      w.join();
+    double t_add = elapsed(start);
+    Graph g;
+    g.build(builder, threads);
+    double t = elapsed(start);
+    printf("Concurrent ingestion and building, %u thread(s): %.0f edges/s (%.2fs, adding %.2fs)\n",
+        threads, ecount / t, t, t_add);
+  }
+}
+
+/*
+ * Measure the incremental maintenance of the CD index of all vertices
+ * when the last fraction of the generated vertices is added to a graph
+ * holding the others, against computing all values from scratch.
+ */
+static void
+bench_incremental(const bench_options_t &opt, const edge_arrays_t &arrays)
+{
+  size_t vcount = arrays.timestamps.size();
+  size_t first_added = vcount - size_t(vcount * opt.incremental);
+  size_t first_added_edge = std::lower_bound(arrays.sources.begin(),
+      arrays.sources.end(), int64_t(first_added)) - arrays.sources.begin();
+  unsigned threads = opt.threads.back();
+  timestamp_t time_delta = opt.window_years * SECONDS_PER_YEAR;
+
+  Graph g;
+  g.add_vertices(arrays.timestamps.data(), first_added);
+  g.add_edges(arrays.sources.data(), arrays.targets.data(), first_added_edge);
+  g.prepare_for_searching();
+  CDIndexTracker tracker(time_delta);
+  auto start = std::chrono::steady_clock::now();
+  tracker.update(g, threads);
+  double t_full = elapsed(start);
+
+  g.add_vertices(arrays.timestamps.data() + first_added, vcount - first_added);
+  g.add_edges(arrays.sources.data() + first_added_edge,
+      arrays.targets.data() + first_added_edge, arrays.sources.size() - first_added_edge);
+  start = std::chrono::steady_clock::now();
+  g.prepare_for_searching();
+  double t_merge = elapsed(start);
+  start = std::chrono::steady_clock::now();
+  size_t changed = tracker.update(g, threads).size();
+  double t_update = elapsed(start);
+
+  printf("Incremental: %zu vertices added, %zu values changed, "
+      "merge %.2fs, update %.2fs (initial computation %.2fs, %u thread(s))\n",
+      vcount - first_added, changed, t_merge, t_update, t_full, threads);
+}
+
+/*
+ * Measure the CD index computation of the specified focal vertices,
+ * given by their original index, with the graph's vertices relabeled
+ * in each locality order, and with each batch schedule. The generated
+ * vertices are in chronological order, which is rarely the case with
+ * real world ids, so they are first measured in a random order.
+ * The graph is left relabeled in the last order.
+ */
+static void
+bench_locality(const bench_options_t &opt, Graph &g,
+    const std::vector<vertex_index_t> &focal)
+{
+  enum { KEEP, SHUFFLE, LOCALITY };
+  static const struct {
+    const char *name;
+    int relabel;
+    vertex_order_t order;
+  } orders[] = {
+    {"generated", KEEP, ORDER_TIMESTAMP},
+    {"random", SHUFFLE, ORDER_TIMESTAMP},
+    {"timestamp", LOCALITY, ORDER_TIMESTAMP},
+    {"rcm", LOCALITY, ORDER_RCM},
+    {"references", LOCALITY, ORDER_REFERENCES},
+  };
+  static const struct {
+    const char *name;
+    batch_schedule_t schedule;
+  } schedules[] = {
+    {"given", SCHEDULE_GIVEN},
+    {"timestamp", SCHEDULE_TIMESTAMP},
+  };
+  unsigned threads = opt.threads.back();
+  timestamp_t time_delta = opt.window_years * SECONDS_PER_YEAR;
+  size_t n = focal.size();
+  CacheMissCounter misses;
+
+  if (!misses.available())
+    printf("LLC miss counter unavailable: %s\n", strerror(errno));
+
+  // The original index of each vertex, maintained across relabelings
+  std::vector<vertex_index_t> original(g.get_vcount());
+  for (size_t i = 0; i < original.size(); i++)
+    original[i] = i;
+  std::vector<index_values_t> expected;
+
+  std::mt19937_64 rng(opt.seed);
+  for (auto o : orders) {
+    if (o.relabel != KEEP) {
+      auto start = std::chrono::steady_clock::now();
+      std::vector<vertex_index_t> order;
+      if (o.relabel == SHUFFLE) {
+        order.resize(original.size());
+        for (size_t i = 0; i < order.size(); i++)
+          order[i] = i;
+        std::shuffle(order.begin(), order.end(), rng);
+      } else
+        order = locality_order(g, o.order);
+      g.relabel(order, threads);
+      printf("Order %s: relabeled in %.2fs\n", o.name, elapsed(start));
+      std::vector<vertex_index_t> relabeled(order.size());
+      for (size_t i = 0; i < order.size(); i++)
+        relabeled[i] = original[order[i]];
+      original.swap(relabeled);
+    }
+
+    std::vector<vertex_index_t> label(original.size());
+    for (size_t i = 0; i < original.size(); i++)
+      label[original[i]] = i;
+    std::vector<vertex_index_t> labeled(n);
+    for (size_t i = 0; i < n; i++)
+      labeled[i] = label[focal[i]];
+
+    for (auto sch : schedules) {
+      std::vector<index_values_t> out(n);
+      set_batch_schedule(sch.schedule);
+      misses.start();
+      auto start = std::chrono::steady_clock::now();
+      cdindex_batch(g, labeled.data(), n, time_delta, out.data(), threads);
+      double t = elapsed(start);
+      uint64_t count = misses.stop();
+
+      printf("Order %s, schedule %s, %u thread(s): %.0f values/s (%.2fs)",
+          o.name, sch.name, threads, n / t, t);
+      if (misses.available())
+        printf(", %.2f LLC misses/value", double(count) / n);
+      if (expected.empty())
+        expected.swap(out);
+      else if (memcmp(expected.data(), out.data(), n * sizeof(index_values_t)) != 0)
+        printf(" (results differ)");
+      printf("\n");
+    }
+  }
+  set_batch_schedule(SCHEDULE_GIVEN);
+}
+
+/*
+ * Measure the CD index computation of the specified focal vertices
+ * with each placement of the graph on the NUMA nodes, verifying that
+ * their values are the same. The graph is left in its local placement.
+ */
+static void
+bench_numa(const bench_options_t &opt, Graph &g,
+    const std::vector<vertex_index_t> &focal, const std::vector<index_values_t> &expected)
+{
+  static const struct {
+    const char *name;
+    numa_placement_t placement;
+  } placements[] = {
+    {"local", NUMA_LOCAL},
+    {"interleave", NUMA_INTERLEAVE},
+    {"replicate", NUMA_REPLICATE},
+  };
+  unsigned threads = opt.threads.back();
+  timestamp_t time_delta = opt.window_years * SECONDS_PER_YEAR;
+  size_t n = focal.size();
+  std::vector<index_values_t> out(n);
+
+  printf("NUMA nodes: %u\n", numa_node_count());
+  for (auto p : placements) {
+    auto start = std::chrono::steady_clock::now();
+    if (!g.place(p.placement)) {
+      printf("NUMA placement %s: %s\n", p.name, strerror(errno));
+      continue;
+    }
+    double t_place = elapsed(start);
+    start = std::chrono::steady_clock::now();
+    cdindex_batch(g, focal.data(), n, time_delta, out.data(), threads);
+    double t = elapsed(start);
+    printf("NUMA placement %s (%.2fs), %u thread(s): %.0f values/s (%.2fs)",
+        p.name, t_place, threads, n / t, t);
+    if (memcmp(expected.data(), out.data(), n * sizeof(index_values_t)) != 0)
+      printf(" (results differ)");
+    printf("\n");
+  }
+  g.place(NUMA_LOCAL);
+}
+
+/*
+ * Measure the computation of all vertices by a time sweep of their
+ * citers, against that of their neighborhoods by cdindex_all,
+ * verifying that its values are the same.
+ */
+static void
+bench_sweep(const bench_options_t &opt, const Graph &g)
+{
+  timestamp_t time_delta = opt.window_years * SECONDS_PER_YEAR;
+  size_t n = g.get_frozen().get_vcount();
+  std::vector<index_values_t> all(n), swept(n);
+
+  for (auto threads : opt.threads) {
+    auto start = std::chrono::steady_clock::now();
+    cdindex_all(g, time_delta, all.data(), threads);
+    double t_all = elapsed(start);
+    start = std::chrono::steady_clock::now();
+    cdindex_sweep(g, time_delta, swept.data(), threads);
+    double t_sweep = elapsed(start);
+    printf("All vertices, %u thread(s): neighborhoods %.0f values/s (%.2fs), "
+        "time sweep %.0f values/s (%.2fs)", threads, n / t_all, t_all, n / t_sweep, t_sweep);
+    if (memcmp(all.data(), swept.data(), n * sizeof(index_values_t)) != 0)
+      printf(" (results differ)");
+    printf("\n");
+  }
+}
+
+/*
+ * Measure the size of the graph with compressed adjacency lists and
+ * the speed of computing it, verifying that its values are the same.
+ */
+static void
+bench_compressed(const bench_options_t &opt, const Graph &g,
+    const std::vector<vertex_index_t> &focal, const std::vector<index_values_t> &expected)
+{
+  unsigned threads = opt.threads.back();
+  timestamp_t time_delta = opt.window_years * SECONDS_PER_YEAR;
+  size_t n = focal.size();
+  const FrozenGraph &fg = g.get_frozen();
+  CompressedGraph cg;
+
+  auto start = std::chrono::steady_clock::now();
+  cg.build(g, threads);
+  printf("Compression, %u thread(s): %.2fs\n", threads, elapsed(start));
+  printf("Graph size: %.1f MB, compressed %.1f MB (%.2fx); edges %.2f bytes, compressed %.2f bytes\n",
+      fg.get_size() / 1e6, cg.get_size() / 1e6, double(fg.get_size()) / cg.get_size(),
+      double(fg.get_size() - fg.get_vcount() * (sizeof(timestamp_t) + 2 * sizeof(size_t)))
+        / fg.get_ecount(),
+      double(cg.get_size() - cg.get_vcount() * (sizeof(timestamp_t) + 2 * sizeof(uint64_t)))
+        / cg.get_ecount());
+
+  std::vector<index_values_t> out(n);
+  start = std::chrono::steady_clock::now();
+  cdindex_batch(cg, focal.data(), n, time_delta, out.data(), threads);
+  double t = elapsed(start);
+  printf("Compressed CD index, %u thread(s): %.0f values/s (%.2fs)", threads, n / t, t);
+  if (memcmp(expected.data(), out.data(), n * sizeof(index_values_t)) != 0)
+    printf(" (results differ)");
+  printf("\n");
+
+  // A citer cache of a quarter of the graph's size, by either schedule
+  CiterCache cache(cg.get_size() / 4);
+  for (batch_schedule_t schedule : {SCHEDULE_GIVEN, SCHEDULE_TIMESTAMP}) {
+    cache.clear();
+    set_batch_schedule(schedule);
+    start = std::chrono::steady_clock::now();
+    cdindex_batch(cg, focal.data(), n, time_delta, out.data(), threads, &cache);
+    t = elapsed(start);
+    citer_cache_stats_t s = cache.get_stats();
+    printf("Compressed CD index, %.1f MB citer cache, %s schedule: %.0f values/s (%.2fs); "
+        "hits %.1f%% of %llu, %zu lists, %.1f MB, %llu evictions",
+        cache.get_capacity() / 1e6, schedule == SCHEDULE_GIVEN ? "given" : "timestamp",
+        n / t, t, s.hits + s.misses ? 100.0 * s.hits / (s.hits + s.misses) : 0.0,
+        (unsigned long long)(s.hits + s.misses), s.entries, s.bytes / 1e6,
+        (unsigned long long)s.evictions);
+    if (memcmp(expected.data(), out.data(), n * sizeof(index_values_t)) != 0)
+      printf(" (results differ)");
+    printf("\n");
+  }
+  set_batch_schedule(SCHEDULE_GIVEN);
+}
+
+/* Parse a comma-separated list of thread counts */
+static std::vector<unsigned>
+parse_threads(const char *s)
+{
+  std::vector<unsigned> result;
+
+  while (*s) {
+    char *end;
+    unsigned long n = strtoul(s, &end, 10);
+    if (end == s || n == 0)
+      break;
+    result.push_back(n);
+    s = *end == ',' ? end + 1 : end;
+  }
+  return result;
+}
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [-eklNz] [-d distribution] [-g growth] [-i fraction] [-m mean-references]\n"
+      "\t[-n vertices] [-p preferential] [-S sample] [-s seed] [-t threads,...]\n"
+      "\t[-w window-years] [-y years]\n"
+      "-d\tDistribution of references: fixed, poisson, lognormal (default), pareto\n"
+      "-e\tMeasure the time sweep computing all vertices\n"
+      "-g\tYearly cohort growth rate (default 0.04)\n"
+      "-i\tMeasure incremental maintenance after adding this fraction of vertices\n"
+      "-k\tMeasure each reference intersection kernel\n"
+      "-l\tMeasure each vertex order and batch schedule, with LLC misses\n"
+      "-m\tMean number of references per publication (default 12)\n"
+      "-N\tMeasure each placement of the graph on the NUMA nodes\n"
+      "-n\tNumber of vertices (default 1000000)\n"
+      "-p\tProbability of preferential attachment (default 0.8)\n"
+      "-S\tNumber of focal vertices to compute; 0 for all (default 100000)\n"
+      "-s\tRandom number generator seed (default 1)\n"
+      "-t\tComma-separated thread counts for preparation and computation (default 1 and all cores)\n"
+      "-w\tCD index window in years (default 5)\n"
+      "-y\tNumber of yearly cohorts (default 50)\n"
+      "-z\tMeasure compressed adjacency lists\n", name);
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  bench_options_t opt;
+  int c;
+
+  opt.vertices = 1000000;
+  opt.years = 50;
+  opt.growth = 0.04;
+  opt.mean_references = 12;
+  opt.distribution = "lognormal";
+  opt.preferential = 0.8;
+  opt.seed = 1;
+  opt.window_years = 5;
+  opt.sample = 100000;
+  opt.kernels = false;
+  opt.locality = false;
+  opt.incremental = 0;
+  opt.compressed = false;
+  opt.sweep = false;
+  opt.numa = false;
+
+  while ((c = getopt(argc, argv, "d:eg:i:klm:Nn:p:S:s:t:w:y:z")) != -1)
+    switch (c) {
+    case 'd': opt.distribution = optarg; break;
+    case 'e': opt.sweep = true; break;
+    case 'g': opt.growth = atof(optarg); break;
+    case 'i': opt.incremental = atof(optarg); break;
+    case 'k': opt.kernels = true; break;
+    case 'l': opt.locality = true; break;
+    case 'm': opt.mean_references = atof(optarg); break;
+    case 'N': opt.numa = true; break;
+    case 'n': opt.vertices = strtoull(optarg, NULL, 10); break;
+    case 'p': opt.preferential = atof(optarg); break;
+    case 'S': opt.sample = strtoull(optarg, NULL, 10); break;
+    case 's': opt.seed = strtoul(optarg, NULL, 10); break;
+    case 't': opt.threads = parse_threads(optarg); break;
+    case 'w': opt.window_years = atoi(optarg); break;
+    case 'y': opt.years = atoi(optarg); break;
+    case 'z': opt.compressed = true; break;
+    default: usage(argv[0]);
+    }
+  if (optind != argc || opt.vertices == 0 || opt.years == 0 || opt.mean_references <= 0
+      || opt.incremental < 0 || opt.incremental > 1)
+    usage(argv[0]);
+  if (opt.threads.empty()) {
+    opt.threads.push_back(1);
+    unsigned cores = std::thread::hardware_concurrency();
+    if (cores > 1)
+      opt.threads.push_back(cores);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  edge_arrays_t arrays = generate_graph(opt);
+  size_t vcount = arrays.timestamps.size();
+  size_t ecount = arrays.sources.size();
+  printf("Generated %zu vertices, %zu edges in %.2fs\n", vcount, ecount, elapsed(start));
+
+  Graph *graph = new Graph;
+  Graph &g = *graph;
+  start = std::chrono::steady_clock::now();
+  g.add_vertices(arrays.timestamps.data(), vcount);
+  double t = elapsed(start);
+  printf("Vertex ingestion: %.0f vertices/s\n", vcount / t);
+
+  start = std::chrono::steady_clock::now();
+  g.add_edges(arrays.sources.data(), arrays.targets.data(), ecount);
+  t = elapsed(start);
+  printf("Edge ingestion: %.0f edges/s\n", ecount / t);
+  bench_builder(opt, arrays);
+  if (opt.incremental > 0)
+    bench_incremental(opt, arrays);
+
+  // Measure all but the last thread count on copies of the build phase graph
+  for (size_t i = 0; i + 1 < opt.threads.size(); i++) {
+    Graph copy;
+    copy.add_vertices(arrays.timestamps.data(), vcount);
+    copy.add_edges(arrays.sources.data(), arrays.targets.data(), ecount);
+    start = std::chrono::steady_clock::now();
+    copy.prepare_for_searching(opt.threads[i]);
+    printf("Preparation for searching, %u thread(s): %.2fs\n", opt.threads[i], elapsed(start));
+  }
+  std::vector<timestamp_t>().swap(arrays.timestamps);
+  std::vector<int64_t>().swap(arrays.sources);
+  std::vector<int64_t>().swap(arrays.targets);
+
+  start = std::chrono::steady_clock::now();
+  g.prepare_for_searching(opt.threads.back());
+  printf("Preparation for searching, %u thread(s): %.2fs\n", opt.threads.back(), elapsed(start));
+  printf("Peak RSS after preparation: %.1f MB\n", peak_rss_mb());
+
+  // Evenly spaced focal vertices, to cover all cohorts
+  size_t n = opt.sample && opt.sample < vcount ? opt.sample : vcount;
+  std::vector<vertex_index_t> focal(n);
+  for (size_t i = 0; i < n; i++)
+    focal[i] = vertex_index_t(i * (vcount / n));
+  std::vector<index_values_t> out(n);
+  timestamp_t time_delta = opt.window_years * SECONDS_PER_YEAR;
+
+  for (auto threads : opt.threads) {
+    start = std::chrono::steady_clock::now();
+    cdindex_batch(g, focal.data(), n, time_delta, out.data(), threads);
+    t = elapsed(start);
+    printf("CD index, %u thread(s): %.0f values/s (%.2fs)\n", threads, n / t, t);
+  }
+
+  if (opt.kernels) {
+    static const struct {
+      const char *name;
+      intersection_kernel_t kernel;
+    } kernels[] = {
+      {"adaptive", INTERSECT_ADAPTIVE},
+      {"binary_search", INTERSECT_BINARY_SEARCH},
+      {"merge", INTERSECT_MERGE},
+      {"gallop", INTERSECT_GALLOP},
+      {"bitmap", INTERSECT_BITMAP},
+      {"simd", INTERSECT_SIMD},
+    };
+    unsigned threads = opt.threads.back();
+
+    for (auto k : kernels) {
+      set_intersection_kernel(k.kernel);
+      start = std::chrono::steady_clock::now();
+      cdindex_batch(g, focal.data(), n, time_delta, out.data(), threads);
+      t = elapsed(start);
+      printf("Kernel %s, %u thread(s): %.0f values/s (%.2fs)\n", k.name, threads, n / t, t);
+    }
+    set_intersection_kernel(INTERSECT_ADAPTIVE);
+  }
+
+  if (opt.numa)
+    bench_numa(opt, g, focal, out);
+
+  if (opt.sweep)
+    bench_sweep(opt, g);
+
+  if (opt.compressed)
+    bench_compressed(opt, g, focal, out);
+
+  if (opt.locality)
+    bench_locality(opt, g, focal);
+
+  printf("Peak RSS: %.1f MB\n", peak_rss_mb());
+
+  start = std::chrono::steady_clock::now();
+  delete graph;
+  printf("Graph teardown: %.3fs\n", elapsed(start));
+  return 0;
+}
@@ -17,89 +17,1769 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <set>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
 
 #include "cdindex.h"
+#include "intersection.h"
+#include "parallel.h"
+
+#ifdef CDINDEX_STATS
+#include <chrono>
+#include <mutex>
+
+/* Collect statistics through the specified statements; see get_stats */
+#define STATS(...) __VA_ARGS__
+#else
+#define STATS(...)
+#endif
+
+/*
+ * Adaptive intersection thresholds: focal vertices with at least this
+ * many references are tested through a bitmap; lists differing in size
+ * by at least this factor are intersected by galloping.
+ */
+const size_t BITMAP_MIN_REFERENCES = 32;
+const size_t GALLOP_MIN_RATIO = 16;
+
+/* Normal quantile of the two-sided 95% confidence intervals of estimates */
+const double APPROXIMATE_Z = 1.959963984540054;
+
+/*
+ * Number of lists ahead of the one decoded whose compressed edges are
+ * prefetched; their offsets are prefetched twice as far ahead.
+ */
+const size_t PREFETCH_DISTANCE = 8;
+
+/*
+ * Minimum in degree of the vertices whose decoded in edges are kept in
+ * a CiterCache; the windows of smaller lists are decoded faster than
+ * the cache is searched.
+ */
+const size_t CITER_CACHE_MIN_DEGREE = 4 * CODEC_BLOCK_SIZE;
+
+static std::atomic<intersection_kernel_t> intersection_kernel(INTERSECT_ADAPTIVE);
+static std::atomic<batch_schedule_t> batch_schedule(SCHEDULE_GIVEN);
 
 /**
- * \function cdindex
- * \brief Computes the CD Index.
+ * \function set_intersection_kernel
+ * \brief Set the method used for testing whether a citer of a focal vertex
+ * also cites any of its references.
+ *
+ * \param kernel The method to use in subsequent computations.
+ */
+void set_intersection_kernel(intersection_kernel_t kernel){
+  intersection_kernel = kernel;
+}
+
+/**
+ * \function set_batch_schedule
+ * \brief Set the order in which batch computations process their
+ * focal vertices.
  *
- * \param id The focal vertex id.
+ * \param schedule The order to use in subsequent computations.
+ * Results are always stored in the order the vertices are specified.
+ */
+void set_batch_schedule(batch_schedule_t schedule){
+  batch_schedule = schedule;
+}
+
+#ifdef CDINDEX_STATS
+/* Add the specified cost to the top list of stats, if it is among the largest */
+static void add_top(cdindex_stats_t &stats, focal_cost_t cost) {
+  int i = stats.top_count;
+
+  if (i == STATS_TOP_COUNT) {
+    if (cost.nanoseconds <= stats.top[i - 1].nanoseconds)
+      return;
+    i--;
+  } else
+    stats.top_count++;
+  for (; i > 0 && stats.top[i - 1].nanoseconds < cost.nanoseconds; i--)
+    stats.top[i] = stats.top[i - 1];
+  stats.top[i] = cost;
+}
+
+/* Add the statistics of from to those of to */
+static void add_stats(cdindex_stats_t &to, const cdindex_stats_t &from) {
+  to.focal_vertices += from.focal_vertices;
+  to.citers_visited += from.citers_visited;
+  to.window_rejects += from.window_rejects;
+  to.it_vertices += from.it_vertices;
+  to.out_edge_probes += from.out_edge_probes;
+  to.intersections += from.intersections;
+  to.intersections_short_circuited += from.intersections_short_circuited;
+  for (int i = 0; i < STATS_DEGREE_BUCKETS; i++) {
+    to.degree_vertices[i] += from.degree_vertices[i];
+    to.degree_nanoseconds[i] += from.degree_nanoseconds[i];
+  }
+  for (int i = 0; i < from.top_count; i++)
+    add_top(to, from.top[i]);
+}
+
+/*
+ * The statistics of the threads that have exited, and those of the
+ * running threads, which register them when they first collect any.
+ */
+class StatsRegistry {
+public:
+  std::mutex lock;
+  cdindex_stats_t exited;
+  std::vector<cdindex_stats_t *> running;
+
+  StatsRegistry() { memset(&exited, 0, sizeof(exited)); }
+};
+
+static StatsRegistry &stats_registry() {
+  static StatsRegistry registry;
+  return registry;
+}
+
+/* The statistics of a thread, which are kept by the registry when it exits */
+class ThreadStats {
+public:
+  cdindex_stats_t stats;
+
+  ThreadStats() {
+    memset(&stats, 0, sizeof(stats));
+    StatsRegistry &r = stats_registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    r.running.push_back(&stats);
+  }
+
+  ~ThreadStats() {
+    StatsRegistry &r = stats_registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    add_stats(r.exited, stats);
+    r.running.erase(std::find(r.running.begin(), r.running.end(), &stats));
+  }
+};
+
+/* Return the statistics of the calling thread */
+static cdindex_stats_t &thread_stats() {
+  static thread_local ThreadStats t;
+  return t.stats;
+}
+#endif
+
+/**
+ * \function get_stats
+ * \brief Return the statistics of the CD index computations since
+ * the program started or reset_stats was called.
+ *
+ * \param stats The statistics of all threads, added together.
+ * Statistics of computations running while this is called may be
+ * incomplete, so it should be called between computations.
+ *
+ * \return True on success, false with errno set to ENOTSUP if the
+ * library was not compiled with CDINDEX_STATS defined.
+ */
+bool get_stats(cdindex_stats_t &stats){
+#ifdef CDINDEX_STATS
+  StatsRegistry &r = stats_registry();
+  std::lock_guard<std::mutex> guard(r.lock);
+  stats = r.exited;
+  for (auto t : r.running)
+    add_stats(stats, *t);
+  return true;
+#else
+  memset(&stats, 0, sizeof(stats));
+  errno = ENOTSUP;
+  return false;
+#endif
+}
+
+/**
+ * \function reset_stats
+ * \brief Clear the statistics of the CD index computations.
+ *
+ * Like get_stats, this should be called between computations.
+ */
+void reset_stats(){
+#ifdef CDINDEX_STATS
+  StatsRegistry &r = stats_registry();
+  std::lock_guard<std::mutex> guard(r.lock);
+  memset(&r.exited, 0, sizeof(r.exited));
+  for (auto t : r.running)
+    memset(t, 0, sizeof(*t));
+#endif
+}
+
+/* An edge staged by group_edges, as its source and target */
+typedef std::pair<vertex_index_t, vertex_index_t> staged_edge_t;
+
+/*
+ * Set offsets and adjacent to the CSR arrays of n vertices with m
+ * edges, grouped by their source, or by their target if by_target is
+ * set, through a two-level counting sort that needs no synchronization:
+ * the edges, given in nslices slices by slice_edges(s, f) calling
+ * f(source, target) for each edge of slice s, are first distributed
+ * into buckets of contiguous vertex ranges, at positions given by the
+ * prefix sums of each slice's bucket counts, and the edges of each
+ * bucket are then placed at the offsets of their vertices. Within
+ * each vertex's list the edges keep their order across the slices.
+ * The staged vector is used as scratch space for the m edges, unless
+ * a single thread places them directly.
+ * Return false if an edge refers to a vertex not below n.
+ */
+template <typename S>
+static bool
+group_edges(size_t n, size_t m, size_t nslices, S slice_edges, bool by_target,
+    std::vector<size_t> &offsets, std::vector<vertex_index_t> &adjacent,
+    std::vector<staged_edge_t> &staged, unsigned nthreads)
+{
+  size_t nbuckets = range_count(m, nthreads);
+  size_t width = std::max<size_t>(1, (n + nbuckets - 1) / nbuckets);
+  std::atomic<bool> valid(true);
+
+  // With a single bucket, staging the edges would only add a pass
+  if (nbuckets == 1) {
+    offsets.assign(n + 1, 0);
+    for (size_t s = 0; s < nslices; s++)
+      slice_edges(s, [&](vertex_index_t source, vertex_index_t target) {
+        if (source >= n || target >= n)
+          valid.store(false, std::memory_order_relaxed);
+        else
+          offsets[by_target ? target : source]++;
+      });
+    if (!valid)
+      return false;
+    parallel_prefix_sum(offsets, nthreads);
+    adjacent.resize(m);
+    std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for (size_t s = 0; s < nslices; s++)
+      slice_edges(s, [&](vertex_index_t source, vertex_index_t target) {
+        adjacent[next[by_target ? target : source]++] = by_target ? source : target;
+      });
+    return true;
+  }
+
+  // Count the edges of each slice in each bucket, ordered by bucket
+  std::vector<size_t> positions(nbuckets * nslices + 1, 0);
+  parallel_ranges(nslices, thread_count(nthreads, nslices),
+      [&](unsigned, size_t begin, size_t end) {
+    std::vector<size_t> counts(nbuckets);
+    for (size_t s = begin; s < end; s++) {
+      std::fill(counts.begin(), counts.end(), 0);
+      slice_edges(s, [&](vertex_index_t source, vertex_index_t target) {
+        if (source >= n || target >= n)
+          valid.store(false, std::memory_order_relaxed);
+        else
+          counts[(by_target ? target : source) / width]++;
+      });
+      for (size_t b = 0; b < nbuckets; b++)
+        positions[b * nslices + s] = counts[b];
+    }
+  });
+  if (!valid)
+    return false;
+  parallel_prefix_sum(positions, nthreads);
+
+  // Distribute the edges into their buckets
+  staged.resize(m);
+  parallel_ranges(nslices, thread_count(nthreads, nslices),
+      [&](unsigned, size_t begin, size_t end) {
+    std::vector<size_t> next(nbuckets);
+    for (size_t s = begin; s < end; s++) {
+      for (size_t b = 0; b < nbuckets; b++)
+        next[b] = positions[b * nslices + s];
+      slice_edges(s, [&](vertex_index_t source, vertex_index_t target) {
+        staged[next[(by_target ? target : source) / width]++] = staged_edge_t(source, target);
+      });
+    }
+  });
+
+  // Count the degrees of each bucket's vertices, and then place their edges
+  offsets.assign(n + 1, 0);
+  auto vertex = [by_target](const staged_edge_t &e) { return by_target ? e.second : e.first; };
+  parallel_ranges(nbuckets, thread_count(nthreads, nbuckets),
+      [&](unsigned, size_t begin, size_t end) {
+    for (size_t k = positions[begin * nslices]; k < positions[end * nslices]; k++)
+      offsets[vertex(staged[k])]++;
+  });
+  parallel_prefix_sum(offsets, nthreads);
+  adjacent.resize(m);
+  parallel_ranges(nbuckets, thread_count(nthreads, nbuckets),
+      [&](unsigned, size_t begin, size_t end) {
+    size_t first = std::min(begin * width, n), last = std::min(end * width, n);
+    std::vector<size_t> next(offsets.begin() + first, offsets.begin() + last);
+    for (size_t k = positions[begin * nslices]; k < positions[end * nslices]; k++) {
+      const staged_edge_t &e = staged[k];
+      adjacent[next[vertex(e) - first]++] = by_target ? e.first : e.second;
+    }
+  });
+  return true;
+}
+
+/**
+ * \function FrozenGraph::build
+ * \brief Append the specified vertices and their edges to the CSR arrays.
+ *
+ * \param vs The vertices to append, ordered by their index, which
+ * continues from the graph's vertex count. Only their out edges are
+ * used; these may also point to vertices already in the graph.
+ * \param nthreads Number of threads to use; 0 for all available cores.
+ *
+ * The existing arrays are copied into new ones, with the in edges
+ * of each vertex merged with those coming from the appended vertices,
+ * so that they remain ordered by their source's timestamp.
+ * Each step runs in parallel over ranges of vertices or edges;
+ * as all edge lists are sorted, the result does not depend on the
+ * number of threads.
+ */
+void
+FrozenGraph::build(const VertexArena &vs, unsigned nthreads)
+{
+  size_t base = get_vcount();
+  size_t n = base + vs.size();
+  unsigned ranges = range_count(n, nthreads);
+  std::vector<timestamp_t> ts(n);
+  std::vector<size_t> out_o(n + 1, 0), in_o(n + 1, 0);
+
+  parallel_ranges(n, ranges, [&](unsigned, size_t begin, size_t end) {
+    for (size_t v = begin; v < end; v++)
+      if (v < base) {
+        ts[v] = timestamps[v];
+        out_o[v] = get_out_degree(v);
+      } else {
+        ts[v] = vs[v - base].get_timestamp();
+        out_o[v] = vs[v - base].get_out_degree();
+      }
+  });
+  parallel_prefix_sum(out_o, nthreads);
+
+  // The existing out edges, followed by the sorted ones of the added vertices
+  std::vector<vertex_index_t> out_t(out_o[n]);
+  parallel_for(n, nthreads, [&](size_t v) {
+    if (v < base) {
+      EdgeList edges(get_out_edges(v));
+      std::copy(edges.begin(), edges.end(), out_t.begin() + out_o[v]);
+    } else {
+      const EdgeVector &edges(vs[v - base].get_out_edges());
+      std::copy(edges.begin(), edges.end(), out_t.begin() + out_o[v]);
+      std::sort(out_t.begin() + out_o[v], out_t.begin() + out_o[v + 1]);
+    }
+  });
+
+  // The sources of the added edges, grouped by target, from slices of these edges
+  size_t added = out_o[n] - out_o[base];
+  size_t nslices = range_count(added, nthreads);
+  size_t slice_size = std::max<size_t>(1, (added + nslices - 1) / nslices);
+  auto slice_edges = [&](size_t s, auto f) {
+    size_t begin = std::min(out_o[base] + s * slice_size, out_o[n]);
+    size_t end = std::min(begin + slice_size, out_o[n]);
+    // Start from the last vertex whose out edges start at or before the slice
+    size_t i = std::upper_bound(out_o.begin() + base, out_o.end(), begin) - out_o.begin() - 1;
+    for (; i < n && out_o[i] < end; i++)
+      for (size_t k = std::max(out_o[i], begin); k < std::min(out_o[i + 1], end); k++)
+        f(i, out_t[k]);
+  };
+  std::vector<size_t> added_o;
+  std::vector<vertex_index_t> added_s;
+  {
+    std::vector<staged_edge_t> staged;
+    group_edges(n, added, nslices, slice_edges, true, added_o, added_s, staged, nthreads);
+  }
+
+  parallel_ranges(n, ranges, [&](unsigned, size_t begin, size_t end) {
+    for (size_t v = begin; v < end; v++)
+      in_o[v] = (v < base ? get_in_degree(v) : 0) + added_o[v + 1] - added_o[v];
+  });
+  parallel_prefix_sum(in_o, nthreads);
+
+  // The existing in edges merged with the added ones, ordered by source timestamp
+  std::vector<vertex_index_t> in_s(in_o[n]);
+  std::vector<timestamp_t> in_t(in_o[n]);
+  auto earlier = [&ts](vertex_index_t a, vertex_index_t b) {
+    return ts[a] < ts[b] || (ts[a] == ts[b] && a < b);
+  };
+  parallel_for(n, nthreads, [&](size_t v) {
+    auto added_begin = added_s.begin() + added_o[v];
+    auto added_end = added_s.begin() + added_o[v + 1];
+    std::sort(added_begin, added_end, earlier);
+    if (v < base) {
+      EdgeList existing(get_in_edges(v));
+      std::merge(existing.begin(), existing.end(), added_begin, added_end,
+          in_s.begin() + in_o[v], earlier);
+    } else
+      std::copy(added_begin, added_end, in_s.begin() + in_o[v]);
+    for (size_t k = in_o[v]; k < in_o[v + 1]; k++)
+      in_t[k] = ts[in_s[k]];
+  });
+
+  unmap();
+  timestamps.assign(std::move(ts));
+  out_offsets.assign(std::move(out_o));
+  out_targets.assign(std::move(out_t));
+  in_offsets.assign(std::move(in_o));
+  in_sources.assign(std::move(in_s));
+  in_timestamps.assign(std::move(in_t));
+}
+
+/**
+ * \function FrozenGraph::build
+ * \brief Build the CSR arrays from the vertices and edges of a builder.
+ *
+ * \param builder The builder.
+ * \param nthreads Number of threads to use; 0 for all available cores.
+ *
+ * The staged edges, split into slices, are grouped by source, and then
+ * by target, through the counting sort of group_edges. Each step runs
+ * in parallel over slices, buckets, or vertices; as the edge lists are
+ * finally sorted, the result does not depend on the number of threads
+ * or producers.
+ * The existing arrays are replaced.
+ *
+ * \return True on success, false with errno set to EINVAL if the
+ * builder has more than MAX_VCOUNT vertices or an edge refers to a
+ * vertex that was not added, in which case the arrays are unchanged.
+ */
+bool
+FrozenGraph::build(const GraphBuilder &builder, unsigned nthreads)
+{
+  const std::vector<GraphBuilder::Producer> &producers = builder.producers;
+  size_t n = builder.get_vcount();
+  size_t m = builder.get_ecount();
+
+  if (n > MAX_VCOUNT) {
+    errno = EINVAL;
+    return false;
+  }
+
+  std::vector<timestamp_t> ts(n);
+  parallel_for(producers.size(), nthreads, [&](size_t p) {
+    const timestamp_t *t = producers[p].timestamps.data();
+    for (auto &r : producers[p].ranges) {
+      std::copy(t, t + r.second, ts.begin() + r.first);
+      t += r.second;
+    }
+  });
+
+  // Slices of the producers' edges, one or more per thread
+  unsigned ranges = range_count(m, nthreads);
+  size_t slice_size = std::max<size_t>(1, (m + ranges - 1) / ranges);
+  std::vector<std::pair<const GraphBuilder::Producer *, size_t>> slices;
+  for (auto &p : producers)
+    for (size_t k = 0; k < p.sources.size(); k += slice_size)
+      slices.push_back(std::make_pair(&p, k));
+  // Call f(source, target) for each edge of slice s
+  auto slice_edges = [&](size_t s, auto f) {
+    const GraphBuilder::Producer &p = *slices[s].first;
+    size_t end = std::min(slices[s].second + slice_size, p.sources.size());
+    for (size_t k = slices[s].second; k < end; k++)
+      f(p.sources[k], p.targets[k]);
+  };
+
+  std::vector<size_t> out_o, in_o;
+  std::vector<vertex_index_t> out_t, in_s;
+  std::vector<staged_edge_t> staged;
+  if (!group_edges(n, m, slices.size(), slice_edges, false, out_o, out_t, staged, nthreads)) {
+    errno = EINVAL;
+    return false;
+  }
+  group_edges(n, m, slices.size(), slice_edges, true, in_o, in_s, staged, nthreads);
+  std::vector<staged_edge_t>().swap(staged);
+
+  // Order the edges of each vertex as those built from added vertices
+  std::vector<timestamp_t> in_t(m);
+  auto earlier = [&ts](vertex_index_t a, vertex_index_t b) {
+    return ts[a] < ts[b] || (ts[a] == ts[b] && a < b);
+  };
+  parallel_for(n, nthreads, [&](size_t v) {
+    std::sort(out_t.begin() + out_o[v], out_t.begin() + out_o[v + 1]);
+    std::sort(in_s.begin() + in_o[v], in_s.begin() + in_o[v + 1], earlier);
+    for (size_t k = in_o[v]; k < in_o[v + 1]; k++)
+      in_t[k] = ts[in_s[k]];
+  });
+
+  unmap();
+  timestamps.assign(std::move(ts));
+  out_offsets.assign(std::move(out_o));
+  out_targets.assign(std::move(out_t));
+  in_offsets.assign(std::move(in_o));
+  in_sources.assign(std::move(in_s));
+  in_timestamps.assign(std::move(in_t));
+  return true;
+}
+
+/**
+ * \function FrozenGraph::relabel
+ * \brief Renumber the vertices of the CSR arrays.
+ *
+ * \param order The permutation to apply: new index i is given to
+ * the vertex whose current index is order[i].
+ * \param nthreads Number of threads to use; 0 for all available cores.
+ *
+ * The edge lists are translated to the new indices and sorted again;
+ * in edges with sources of equal timestamps are ordered by their
+ * new index, so that the arrays are the same as those built from
+ * vertices added in the new order.
+ */
+void
+FrozenGraph::relabel(const vertex_index_t *order, unsigned nthreads)
+{
+  size_t n = get_vcount();
+  unsigned ranges = range_count(n, nthreads);
+  std::vector<vertex_index_t> label(n);
+  std::vector<timestamp_t> ts(n);
+  std::vector<size_t> out_o(n + 1, 0), in_o(n + 1, 0);
+
+  parallel_ranges(n, ranges, [&](unsigned, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      label[order[i]] = i;
+      ts[i] = timestamps[order[i]];
+      out_o[i] = get_out_degree(order[i]);
+      in_o[i] = get_in_degree(order[i]);
+    }
+  });
+  parallel_prefix_sum(out_o, nthreads);
+  parallel_prefix_sum(in_o, nthreads);
+
+  std::vector<vertex_index_t> out_t(out_o[n]);
+  std::vector<vertex_index_t> in_s(in_o[n]);
+  std::vector<timestamp_t> in_t(in_o[n]);
+  auto earlier = [&ts](vertex_index_t a, vertex_index_t b) {
+    return ts[a] < ts[b] || (ts[a] == ts[b] && a < b);
+  };
+  parallel_for(n, nthreads, [&](size_t i) {
+    auto out_begin = out_t.begin() + out_o[i];
+    for (auto v : get_out_edges(order[i]))
+      *out_begin++ = label[v];
+    std::sort(out_t.begin() + out_o[i], out_t.begin() + out_o[i + 1]);
+
+    auto in_begin = in_s.begin() + in_o[i];
+    for (auto v : get_in_edges(order[i]))
+      *in_begin++ = label[v];
+    std::sort(in_s.begin() + in_o[i], in_s.begin() + in_o[i + 1], earlier);
+    for (size_t k = in_o[i]; k < in_o[i + 1]; k++)
+      in_t[k] = ts[in_s[k]];
+  });
+
+  unmap();
+  timestamps.assign(std::move(ts));
+  out_offsets.assign(std::move(out_o));
+  out_targets.assign(std::move(out_t));
+  in_offsets.assign(std::move(in_o));
+  in_sources.assign(std::move(in_s));
+  in_timestamps.assign(std::move(in_t));
+}
+
+/*
+ * Return the reference of the specified vertex with the most citations,
+ * the one with the lowest index among equally cited ones, or NO_VERTEX
+ * if it has no references. Its in edges are the longest list scanned
+ * when computing the vertex's CD index.
+ */
+static vertex_index_t most_cited_reference(const FrozenGraph &fg, vertex_index_t v) {
+  vertex_index_t result = NO_VERTEX;
+  size_t citations = 0;
+
+  for (auto r : fg.get_out_edges(v))
+    if (result == NO_VERTEX || fg.get_in_degree(r) > citations) {
+      result = r;
+      citations = fg.get_in_degree(r);
+    }
+  return result;
+}
+
+/*
+ * Return a reverse Cuthill-McKee order of the graph's vertices,
+ * treating edges as undirected. Each connected component is traversed
+ * breadth-first from one of its vertices of lowest degree, visiting
+ * the neighbors of each vertex in order of increasing degree.
+ * Vertices that are close in the graph thus get close indices.
+ */
+static std::vector<vertex_index_t> rcm_order(const FrozenGraph &fg) {
+  size_t n = fg.get_vcount();
+  auto degree = [&fg](vertex_index_t v) {
+    return fg.get_in_degree(v) + fg.get_out_degree(v);
+  };
+  auto lower_degree = [&degree](vertex_index_t a, vertex_index_t b) {
+    return degree(a) < degree(b) || (degree(a) == degree(b) && a < b);
+  };
+
+  std::vector<vertex_index_t> starts(n);
+  for (size_t v = 0; v < n; v++)
+    starts[v] = v;
+  std::sort(starts.begin(), starts.end(), lower_degree);
+
+  // The result doubles as the breadth-first search queue
+  std::vector<vertex_index_t> order;
+  order.reserve(n);
+  std::vector<bool> visited(n, false);
+  std::vector<vertex_index_t> neighbors;
+  for (auto start : starts) {
+    if (visited[start])
+      continue;
+    visited[start] = true;
+    order.push_back(start);
+    for (size_t head = order.size() - 1; head < order.size(); head++) {
+      vertex_index_t v = order[head];
+      neighbors.clear();
+      for (auto w : fg.get_out_edges(v))
+        if (!visited[w])
+          neighbors.push_back(w);
+      for (auto w : fg.get_in_edges(v))
+        if (!visited[w])
+          neighbors.push_back(w);
+      std::sort(neighbors.begin(), neighbors.end(), lower_degree);
+      for (auto w : neighbors)
+        if (!visited[w]) {
+          visited[w] = true;
+          order.push_back(w);
+        }
+    }
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+/**
+ * \function locality_order
+ * \brief Return an order of the vertices that improves the locality
+ * of the CD index computations.
+ *
+ * \param g The graph, which must have been prepared for searching.
+ * \param order The heuristic determining the order.
+ *
+ * Computing the CD index of a vertex scans the in edges of the vertex
+ * and of its references, and the out edges of the citers found.
+ * Giving adjacent indices to vertices whose neighborhoods overlap
+ * keeps these lists close in memory and in the visited set.
+ * ORDER_REFERENCES groups the works sharing their most cited reference,
+ * placing works that cite nothing before the group of their citers.
+ *
+ * \return The order for Graph::relabel: the i-th element is the
+ * current index of the vertex that should get index i.
+ */
+std::vector<vertex_index_t> locality_order(const Graph &g, vertex_order_t order) {
+  const FrozenGraph &fg = g.get_frozen();
+  size_t n = fg.get_vcount();
+
+  if (order == ORDER_RCM)
+    return rcm_order(fg);
+
+  std::vector<vertex_index_t> result(n);
+  for (size_t v = 0; v < n; v++)
+    result[v] = v;
+  if (order == ORDER_TIMESTAMP) {
+    std::stable_sort(result.begin(), result.end(), [&fg](vertex_index_t a, vertex_index_t b) {
+      return fg.get_timestamp(a) < fg.get_timestamp(b);
+    });
+    return result;
+  }
+
+  // Sort by the most cited reference, then by timestamp
+  std::vector<vertex_index_t> group(n);
+  for (size_t v = 0; v < n; v++) {
+    group[v] = most_cited_reference(fg, v);
+    if (group[v] == NO_VERTEX)
+      group[v] = v;
+  }
+  std::sort(result.begin(), result.end(), [&fg, &group](vertex_index_t a, vertex_index_t b) {
+    if (group[a] != group[b])
+      return group[a] < group[b];
+    if (fg.get_timestamp(a) != fg.get_timestamp(b))
+      return fg.get_timestamp(a) < fg.get_timestamp(b);
+    return a < b;
+  });
+  return result;
+}
+
+/*
+ * Return the positions of the specified focal vertices in the order
+ * they should be processed according to the batch schedule, or an
+ * empty vector if they should be processed as given.
+ * With SCHEDULE_TIMESTAMP consecutive computations scan overlapping
+ * time windows of the same citer lists, such as those of highly
+ * cited works, while these are still cached.
+ */
+template <typename G>
+static std::vector<size_t> batch_order(const G &fg,
+    const vertex_index_t *focal, size_t n) {
+  if (batch_schedule == SCHEDULE_GIVEN)
+    return std::vector<size_t>();
+
+  std::vector<size_t> result(n);
+  for (size_t k = 0; k < n; k++)
+    result[k] = k;
+  std::stable_sort(result.begin(), result.end(), [&fg, focal](size_t a, size_t b) {
+    return fg.get_timestamp(focal ? focal[a] : vertex_index_t(a))
+      < fg.get_timestamp(focal ? focal[b] : vertex_index_t(b));
+  });
+  return result;
+}
+
+/*
+ * Make the focal vertex's references available to the bitmap
+ * intersection kernel for the lifetime of the object.
+ */
+class ReferenceMarks {
+private:
+  EdgeList refs;
+  ScratchContext &scratch;
+  bool marked;
+
+public:
+  ReferenceMarks(const FrozenGraph &fg, vertex_index_t focal,
+      ScratchContext &s, intersection_kernel_t kernel)
+    : refs(fg.get_out_edges(focal)), scratch(s),
+    marked(kernel == INTERSECT_BITMAP || (kernel == INTERSECT_ADAPTIVE
+          && refs.size() >= BITMAP_MIN_REFERENCES)) {
+    if (marked)
+      scratch.mark_references(refs);
+  }
+
+  ~ReferenceMarks() {
+    if (marked)
+      scratch.clear_references(refs);
+  }
+};
+
+/*
+ * Return true if the citer's references include any of the focal
+ * vertex's ones, using the specified kernel.
+ */
+static inline bool
+cites_references(EdgeList citer_refs, EdgeList focal_refs,
+    const ScratchContext &scratch, intersection_kernel_t kernel)
+{
+  size_t nc = citer_refs.size(), nf = focal_refs.size();
+
+  if (kernel == INTERSECT_ADAPTIVE) {
+    if (nf >= BITMAP_MIN_REFERENCES)
+      kernel = INTERSECT_BITMAP;
+    else if (nc >= GALLOP_MIN_RATIO * nf || nf >= GALLOP_MIN_RATIO * nc)
+      kernel = INTERSECT_GALLOP;
+    else
+      kernel = INTERSECT_SIMD;
+  }
+
+  switch (kernel) {
+  case INTERSECT_BINARY_SEARCH:
+    return intersects_binary_search(citer_refs.begin(), citer_refs.end(),
+        focal_refs.begin(), focal_refs.end());
+  case INTERSECT_MERGE:
+    return intersects_merge(citer_refs.begin(), citer_refs.end(),
+        focal_refs.begin(), focal_refs.end());
+  case INTERSECT_GALLOP:
+    if (nc <= nf)
+      return intersects_gallop(citer_refs.begin(), citer_refs.end(),
+          focal_refs.begin(), focal_refs.end());
+    else
+      return intersects_gallop(focal_refs.begin(), focal_refs.end(),
+          citer_refs.begin(), citer_refs.end());
+  case INTERSECT_BITMAP:
+    for (auto j : citer_refs)
+      if (scratch.is_reference(j))
+        return true;
+    return false;
+  case INTERSECT_SIMD:
+  default:
+    return intersects_simd(citer_refs.begin(), citer_refs.end(),
+        focal_refs.begin(), focal_refs.end());
+  }
+}
+
+/*
+ * Collect in the scratch context's visited set the "it" vertices of the
+ * focal vertex: those citing it or its references with a timestamp in
+ * the window (t0, t_end]. As in edges are ordered by time, the citers
+ * in the window are located through binary search.
+ */
+static void collect_it(const FrozenGraph &fg, vertex_index_t focal,
+    timestamp_t t0, timestamp_t t_end, ScratchContext &scratch){
+
+   scratch.begin(fg.get_vcount());
+   STATS(cdindex_stats_t &stats = thread_stats());
+
+   /* add unique "in_edges" of focal vertex "out_edges" */
+   for (auto out_edge_i : fg.get_out_edges(focal)) {
+     EdgeList citers(fg.get_in_edges_between(out_edge_i, t0, t_end));
+     STATS(stats.citers_visited += citers.size();
+         stats.window_rejects += fg.get_in_degree(out_edge_i) - citers.size());
+     for (auto out_edge_i_in_edge_j : citers)
+	 scratch.visit(out_edge_i_in_edge_j);
+   }
+
+   /* add unique "in_edges" of focal vertex */
+   EdgeList citers(fg.get_in_edges_between(focal, t0, t_end));
+   STATS(stats.citers_visited += citers.size();
+       stats.window_rejects += fg.get_in_degree(focal) - citers.size());
+   for (auto in_edge_i : citers)
+       scratch.visit(in_edge_i);
+}
+
+#ifdef CDINDEX_STATS
+/*
+ * Account in the calling thread's statistics for a focal vertex whose
+ * collected "it" vertices have been classified, with the specified
+ * number of intersections of which the specified number found a
+ * common reference, in a computation that started at start.
+ */
+static void record_focal(const FrozenGraph &fg, vertex_index_t focal,
+    const ScratchContext &scratch, uint64_t intersections, uint64_t short_circuited,
+    std::chrono::steady_clock::time_point start){
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  uint64_t degree = fg.get_in_degree(focal) + fg.get_out_degree(focal);
+  int bucket = 63 - __builtin_clzll(degree + 1);
+  cdindex_stats_t &stats = thread_stats();
+
+  stats.focal_vertices++;
+  stats.it_vertices += scratch.get_visited().size();
+  stats.out_edge_probes += scratch.get_visited().size();
+  stats.intersections += intersections;
+  stats.intersections_short_circuited += short_circuited;
+  stats.degree_vertices[bucket]++;
+  stats.degree_nanoseconds[bucket] += ns;
+  add_top(stats, focal_cost_t{focal, ns});
+}
+#endif
+
+/*
+ * Return the contribution of "it" vertex i to the focal vertex's CD index
+ * sum: 1 if it cites only the focal vertex, -1 if it cites both the focal
+ * vertex and at least one of its references, 0 otherwise.
+ */
+static inline int citer_contribution(const FrozenGraph &fg,
+    vertex_index_t focal, vertex_index_t i, const ScratchContext &scratch,
+    intersection_kernel_t kernel){
+  int f_it = fg.has_out_edge(i, focal);
+  if (!f_it)
+    return 0;
+
+  int b_it = cites_references(fg.get_out_edges(i), fg.get_out_edges(focal),
+      scratch, kernel);
+  return -2*f_it*b_it + f_it;
+}
+
+/**
+ * \function frozen_citer_counts
+ * \brief Counts the "it" vertices of a vertex of a frozen graph by what they cite.
+ *
+ * \param fg The frozen graph.
+ * \param focal The focal vertex index.
  * \param time_delta Time beyond stamp of focal vertex to consider in measure.
+ * \param scratch Working storage of the calling thread.
  *
- * \return The value of the CD index.
+ * \return The counts, from which the CD index is derived.
  */
-double cdindex(vertex_id_t id, timestamp_t time_delta){
+static citer_counts_t frozen_citer_counts(const FrozenGraph &fg,
+    vertex_index_t focal, timestamp_t time_delta, ScratchContext &scratch){
+
+   timestamp_t t0 = fg.get_timestamp(focal);
+   STATS(auto start = std::chrono::steady_clock::now());
 
    /* Build a set of "it" vertices that are "in_edges" of the focal vertex's
      "out_edges" as of timestamp t. */
+   collect_it(fg, focal, t0, t0 + time_delta, scratch);
 
-   std::set<Vertex *> it;
+  /* classify the "it" vertices; those not citing the focal vertex cite its references */
+  intersection_kernel_t kernel = intersection_kernel;
+  ReferenceMarks marks(fg, focal, scratch, kernel);
+  citer_counts_t counts = {0, 0, 0};
+  for (auto i : scratch.get_visited())
+    switch (citer_contribution(fg, focal, i, scratch, kernel)) {
+    case 1: counts.f_only++; break;
+    case -1: counts.f_and_b++; break;
+    default: counts.b_only++; break;
+    }
 
-   /* add unique "in_edges" of focal vertex "out_edges" */
-   for (auto out_edge_i : id.v->get_out_edges())
-     for (auto out_edge_i_in_edge_j : out_edge_i->get_in_edges())
-       if (out_edge_i_in_edge_j->get_timestamp() > id.v->get_timestamp() &&
-           out_edge_i_in_edge_j->get_timestamp() <= (id.v->get_timestamp() + time_delta))
-	 it.insert(out_edge_i_in_edge_j);
+  // Only citers of the focal vertex are intersected; see citer_contribution
+  STATS(record_focal(fg, focal, scratch, counts.f_only + counts.f_and_b,
+        counts.f_and_b, start));
+  return counts;
+}
 
-   /* add unique "in_edges" of focal vertex */
-   for (auto in_edge_i : id.v->get_in_edges())
-     if (in_edge_i->get_timestamp() > id.v->get_timestamp() &&
-         in_edge_i->get_timestamp() <= (id.v->get_timestamp() + time_delta))
-       it.insert(in_edge_i);
-
-  /* compute the cd index */
-  double sum_i = 0.0;
-  for (auto i : it) {
-    int f_it = i->has_out_edge(id.v);
-    int b_it = 0;
-    for (auto j : i->get_out_edges())
-      if (id.v->has_out_edge(j)) {
-        b_it = 1;
-	break;
-      }
-    sum_i += -2.0*f_it*b_it + f_it;
-  }
+/**
+ * \function frozen_cdindex
+ * \brief Computes the CD Index of a vertex of a frozen graph.
+ *
+ * \param fg The frozen graph.
+ * \param focal The focal vertex index.
+ * \param time_delta Time beyond stamp of focal vertex to consider in measure.
+ * \param scratch Working storage of the calling thread.
+ *
+ * \return The value of the CD index.
+ */
+static double frozen_cdindex(const FrozenGraph &fg, vertex_index_t focal,
+    timestamp_t time_delta, ScratchContext &scratch){
+  return counts_cdindex(frozen_citer_counts(fg, focal, time_delta, scratch));
+}
+
+/**
+ * \function frozen_iindex
+ * \brief Computes the I Index of a vertex of a frozen graph.
+ *
+ * \param fg The frozen graph.
+ * \param focal The focal vertex index.
+ * \param time_delta Time beyond stamp of focal vertex to consider in computing the measure.
+ *
+ * \return The value of the I index.
+ */
+static size_t frozen_iindex(const FrozenGraph &fg, vertex_index_t focal, timestamp_t time_delta){
+
+   timestamp_t t0 = fg.get_timestamp(focal);
+
+   /* count mt vertices that are "in_edges" of the focal vertex as of timestamp t. */
+  return fg.get_in_degree_until(focal, t0 + time_delta);
+}
 
-  return sum_i/it.size();
+/**
+ * \function cdindex
+ * \brief Computes the CD Index.
+ *
+ * \param g The graph, which must have been prepared for searching.
+ * \param v The focal vertex index.
+ * \param time_delta Time beyond stamp of focal vertex to consider in measure.
+ *
+ * \return The value of the CD index.
+ */
+double cdindex(const Graph &g, vertex_index_t v, timestamp_t time_delta){
+  static thread_local ScratchContext scratch;
+
+  return cdindex(g, v, time_delta, scratch);
+}
+
+/**
+ * \function cdindex
+ * \brief Computes the CD Index using the caller's working storage.
+ *
+ * \param g The graph, which must have been prepared for searching.
+ * \param v The focal vertex index.
+ * \param time_delta Time beyond stamp of focal vertex to consider in measure.
+ * \param scratch Working storage, reused across calls by the same thread.
+ *
+ * \return The value of the CD index.
+ */
+double cdindex(const Graph &g, vertex_index_t v, timestamp_t time_delta,
+    ScratchContext &scratch){
+  return frozen_cdindex(g.get_frozen(), v, time_delta, scratch);
 }
 
 /**
  * \function iindex
  * \brief Computes the I Index (i.e., the in degree of the focal vertex at time t).
  *
- * \param id The focal vertex id.
+ * \param g The graph, which must have been prepared for searching.
+ * \param v The focal vertex index.
  * \param time_delta Time beyond stamp of focal vertex to consider in computing the measure.
  *
  * \return The value of the I index.
  */
-size_t iindex(vertex_id_t id, timestamp_t time_delta){
+size_t iindex(const Graph &g, vertex_index_t v, timestamp_t time_delta){
+  return frozen_iindex(g.get_frozen(), v, time_delta);
+}
 
-   /* count mt vertices that are "in_edges" of the focal vertex as of timestamp t. */
-   size_t mt_count = 0;
-   for (auto in_edge_i : id.v->get_in_edges())
-     if (in_edge_i->get_timestamp() <= (id.v->get_timestamp() + time_delta))
-       mt_count++;
+/**
+ * \function cdindex_windows
+ * \brief Computes the CD, mCD, and I indices for many time windows in a single pass.
+ *
+ * \param g The graph, which must have been prepared for searching.
+ * \param focal The focal vertex index.
+ * \param time_deltas Times beyond stamp of focal vertex to consider, in ascending order.
+ * \param k The number of time deltas.
+ * \param out Array of k elements where the values for each time delta are stored.
+ * \param scratch Working storage, reused across calls by the same thread.
+ *
+ * The neighborhood of the focal vertex is traversed once for the widest
+ * window. The contribution of each "it" vertex is counted in the
+ * narrowest window containing it, and the counts are then accumulated
+ * across successively wider windows.
+ */
+void cdindex_windows(const Graph &g, vertex_index_t focal,
+    const timestamp_t *time_deltas, size_t k, index_values_t *out,
+    ScratchContext &scratch){
 
-  return mt_count;
+  if (k == 0)
+    return;
+
+  const FrozenGraph &fg = g.get_frozen();
+  timestamp_t t0 = fg.get_timestamp(focal);
+  std::vector<double> sum(k, 0.0);
+  std::vector<size_t> it_count(k, 0);
+
+  // Index of the narrowest window containing timestamp t, or k if none
+  auto window = [&](timestamp_t t) {
+    return size_t(std::lower_bound(time_deltas, time_deltas + k, t - t0) - time_deltas);
+  };
+
+  STATS(auto start = std::chrono::steady_clock::now();
+      uint64_t intersections = 0, short_circuited = 0);
+  collect_it(fg, focal, t0, t0 + time_deltas[k - 1], scratch);
+  intersection_kernel_t kernel = intersection_kernel;
+  ReferenceMarks marks(fg, focal, scratch, kernel);
+  for (auto i : scratch.get_visited()) {
+    size_t w = window(fg.get_timestamp(i));
+    int contribution = citer_contribution(fg, focal, i, scratch, kernel);
+    sum[w] += contribution;
+    it_count[w]++;
+    STATS(intersections += contribution != 0;
+        short_circuited += contribution < 0);
+  }
+  STATS(record_focal(fg, focal, scratch, intersections, short_circuited, start));
+
+  for (size_t w = 0; w < k; w++) {
+    if (w > 0) {
+      sum[w] += sum[w - 1];
+      it_count[w] += it_count[w - 1];
+    }
+    out[w].cdindex = sum[w] / it_count[w];
+    out[w].iindex = fg.get_in_degree_until(focal, t0 + time_deltas[w]);
+    out[w].mcdindex = out[w].cdindex * out[w].iindex;
+  }
 }
 
 /**
  * \function mcdindex
  * \brief Computes the mCD Index.
  *
- * \param id The focal vertex id.
+ * \param g The graph, which must have been prepared for searching.
+ * \param v The focal vertex index.
  * \param time_delta Time beyond stamp of focal vertex to consider in computing the measure.
  *
  * \return The value of the mCD index.
  */
-double mcdindex(vertex_id_t id, timestamp_t time_delta){
+double mcdindex(const Graph &g, vertex_index_t v, timestamp_t time_delta){
 
-  double cdindex_value = cdindex(id, time_delta);
-  size_t iindex_value = iindex(id, time_delta);
+  double cdindex_value = cdindex(g, v, time_delta);
+  size_t iindex_value = iindex(g, v, time_delta);
 
   return cdindex_value * iindex_value;
 
 }
+
+/* Working storage of a batch computation thread, and the replica of the graph it reads */
+typedef struct {
+  ScratchContext scratch;
+  const FrozenGraph *fg = NULL;
+} batch_state_t;
+
+/**
+ * \function cdindex_batch
+ * \brief Computes the CD, mCD, and I indices of many vertices in parallel.
+ *
+ * \param g The graph, which must have been prepared for searching.
+ * \param focal The indices of the focal vertices, or NULL for all vertices.
+ * \param n The number of focal vertices.
+ * \param time_delta Time beyond stamp of focal vertex to consider in computing the measures.
+ * \param out Array of n elements where the computed values are stored.
+ * \param nthreads Number of threads to use; 0 for all available cores.
+ *
+ * Threads dynamically claim small chunks of focal vertices, so that
+ * vertices with a costly neighborhood do not leave other cores idle.
+ * The vertices are processed in the order set by set_batch_schedule.
+ * If the graph is replicated on the NUMA nodes, the threads started
+ * are pinned to the nodes in turn, and each thread reads the replica
+ * of its node.
+ */
+void cdindex_batch(const Graph &g, const vertex_index_t *focal, size_t n,
+    timestamp_t time_delta, index_values_t *out, unsigned nthreads) {
+
+  std::vector<batch_state_t> states;
+  std::vector<size_t> schedule(batch_order(g.get_frozen(), focal, n));
+  std::thread::id caller(std::this_thread::get_id());
+  std::atomic<unsigned> started(0);
+
+  parallel_for(n, nthreads, states, [&](size_t j, batch_state_t &state) {
+    if (!state.fg) {
+      unsigned replicas = g.get_replica_count();
+      unsigned node = 0;
+      // The calling thread is left where it runs
+      if (replicas && std::this_thread::get_id() == caller)
+        node = numa_current_node();
+      else if (replicas) {
+        node = started++ % replicas;
+        numa_pin_thread(node);
+      }
+      state.fg = &g.get_frozen(node);
+    }
+    const FrozenGraph &fg = *state.fg;
+    size_t k = schedule.empty() ? j : schedule[j];
+    vertex_index_t v = focal ? focal[k] : vertex_index_t(k);
+    out[k].cdindex = frozen_cdindex(fg, v, time_delta, state.scratch);
+    out[k].iindex = frozen_iindex(fg, v, time_delta);
+    out[k].mcdindex = out[k].cdindex * out[k].iindex;
+  });
+}
+
+/**
+ * \function cdindex_all
+ * \brief Computes the CD, mCD, and I indices of all graph vertices in parallel.
+ *
+ * \param g The graph, which must have been prepared for searching.
+ * \param time_delta Time beyond stamp of focal vertex to consider in computing the measures.
+ * \param out Array with an element for each vertex, in the order vertices were added.
+ * \param nthreads Number of threads to use; 0 for all available cores.
+ */
+void cdindex_all(const Graph &g, timestamp_t time_delta, index_values_t *out,
+    unsigned nthreads) {
+  cdindex_batch(g, NULL, g.get_frozen().get_vcount(), time_delta, out, nthreads);
+}
+
+/*
+ * The counts of a focal vertex whose time window is open in a sweep,
+ * with the last citer counted and whether it cites the focal vertex,
+ * so that each citer is counted once, however it is reached.
+ */
+typedef struct {
+  citer_counts_t counts;
+  vertex_index_t last_citer;
+  bool last_cites_focal;
+} open_window_t;
+
+/*
+ * Compute the indices of the vertices at positions [begin, end) of
+ * the timestamp order of a time sweep, through their citers. The
+ * order is given as a function returning the vertex at a position,
+ * and the position of a vertex.
+ */
+template <typename O, typename P>
+static void sweep_range(const FrozenGraph &fg, O order, P position, size_t begin,
+    size_t end, timestamp_t time_delta, index_values_t *out) {
+
+  if (begin == end)
+    return;
+  size_t n = fg.get_vcount();
+  /*
+   * The windows of the vertices at positions [lo, hi) are open, each
+   * at its position modulo the power of two size of the ring
+   */
+  std::vector<open_window_t> ring(64);
+  size_t lo = begin, hi = begin;
+  auto open = [&]() {
+    if (hi - lo == ring.size()) {
+      std::vector<open_window_t> larger(2 * ring.size());
+      for (size_t p = lo; p < hi; p++)
+        larger[p & (larger.size() - 1)] = ring[p & (ring.size() - 1)];
+      ring.swap(larger);
+    }
+    ring[hi & (ring.size() - 1)] = open_window_t{{0, 0, 0}, order(hi), false};
+    hi++;
+  };
+  auto close = [&]() {
+    vertex_index_t v = order(lo);
+    out[v].cdindex = counts_cdindex(ring[lo & (ring.size() - 1)].counts);
+    out[v].iindex = frozen_iindex(fg, v, time_delta);
+    out[v].mcdindex = out[v].cdindex * out[v].iindex;
+    lo++;
+  };
+
+  // Citers later than the first vertex, up to the last one's window end
+  timestamp_t first = fg.get_timestamp(order(begin));
+  timestamp_t last = fg.get_timestamp(order(end - 1)) + time_delta;
+  size_t c_lo = 0, c_hi = n;
+  while (c_lo < c_hi) {
+    size_t mid = c_lo + (c_hi - c_lo) / 2;
+    if (fg.get_timestamp(order(mid)) <= first)
+      c_lo = mid + 1;
+    else
+      c_hi = mid;
+  }
+
+  for (size_t k = c_lo; k < n; k++) {
+    vertex_index_t c = order(k);
+    timestamp_t tc = fg.get_timestamp(c);
+    if (tc > last)
+      break;
+    // Open the windows of the vertices before c; close those ending before it
+    while (hi < end && fg.get_timestamp(order(hi)) < tc)
+      open();
+    while (lo < hi && fg.get_timestamp(order(lo)) + time_delta < tc)
+      close();
+    if (lo == hi)
+      continue;
+
+    // Vertices citing c's references count c as citing their references
+    EdgeList refs(fg.get_out_edges(c));
+    timestamp_t after = std::max(tc - time_delta, fg.get_timestamp(order(lo))) - 1;
+    timestamp_t until = fg.get_timestamp(order(hi - 1));
+    size_t mask = ring.size() - 1;
+    for (auto r : refs)
+      for (auto f : fg.get_in_edges_between(r, after, until)) {
+        size_t p = position(f);
+        if (p < lo || p >= hi)
+          continue;
+        open_window_t &w = ring[p & mask];
+        if (w.last_citer != c) {
+          w.last_citer = c;
+          w.last_cites_focal = false;
+          w.counts.b_only++;
+        }
+      }
+    // c's references count it as citing them, and possibly their references
+    for (auto f : refs) {
+      size_t p = position(f);
+      if (p < lo || p >= hi)
+        continue;
+      open_window_t &w = ring[p & mask];
+      if (w.last_citer != c) {
+        w.last_citer = c;
+        w.last_cites_focal = true;
+        w.counts.f_only++;
+      } else if (!w.last_cites_focal) {
+        w.last_cites_focal = true;
+        w.counts.b_only--;
+        w.counts.f_and_b++;
+      }
+    }
+  }
+
+  while (lo < end) {
+    if (lo == hi)
+      open();
+    close();
+  }
+}
+
+/**
+ * \function cdindex_sweep
+ * \brief Computes the CD, mCD, and I indices of all graph vertices in a
+ * sweep of their citers by timestamp.
+ *
+ * \param g The graph, which must have been prepared for searching.
+ * \param time_delta Time beyond stamp of focal vertex to consider in computing the measures.
+ * \param out Array with an element for each vertex, in the order vertices were added.
+ * \param nthreads Number of threads to use; 0 for all available cores.
+ *
+ * Rather than expanding the neighborhood of each focal vertex, as
+ * cdindex_all does, each citer is visited once, in timestamp order,
+ * counting itself in the open windows of the vertices it cites and of
+ * those citing its references, as in CDIndexTracker::update. This
+ * classifies the citers without searching their references, and
+ * visits each citer's two-hop paths once. The values of each vertex
+ * are stored as its window closes. Apart from the timestamp order,
+ * which is not stored if the vertices are already in it, memory is
+ * proportional to the number of open windows.
+ *
+ * The vertices are split into ranges of the timestamp order, each
+ * swept by a thread through the citers within its windows.
+ * The results are the same as those of cdindex_all.
+ */
+void cdindex_sweep(const Graph &g, timestamp_t time_delta, index_values_t *out,
+    unsigned nthreads) {
+
+  const FrozenGraph &fg = g.get_frozen();
+  size_t n = fg.get_vcount();
+  unsigned ranges = range_count(n, nthreads);
+  bool ordered = true;
+
+  for (size_t v = 1; v < n && ordered; v++)
+    ordered = fg.get_timestamp(v - 1) <= fg.get_timestamp(v);
+  if (ordered) {
+    auto identity = [](size_t v) { return vertex_index_t(v); };
+    parallel_ranges(n, ranges, [&](unsigned, size_t begin, size_t end) {
+      sweep_range(fg, identity, identity, begin, end, time_delta, out);
+    });
+    return;
+  }
+
+  std::vector<vertex_index_t> order(locality_order(g, ORDER_TIMESTAMP));
+  std::vector<vertex_index_t> position(n);
+  for (size_t k = 0; k < n; k++)
+    position[order[k]] = k;
+  parallel_ranges(n, ranges, [&](unsigned, size_t begin, size_t end) {
+    sweep_range(fg, [&order](size_t k) { return order[k]; },
+        [&position](vertex_index_t v) { return position[v]; },
+        begin, end, time_delta, out);
+  });
+}
+
+/*
+ * Call f(u) for each source u of an in edge of v in a compressed graph
+ * with a timestamp in (after, until]. The blocks holding the window
+ * are found through the first timestamps in the list's skip table;
+ * the timestamps of the sources of the blocks holding its ends are
+ * looked up.
+ */
+template <typename F>
+static void compressed_in_edges_between(const CompressedGraph &cg, vertex_index_t v,
+    timestamp_t after, timestamp_t until, F f){
+  CompressedList edges(cg.get_in_edges(v));
+  size_t nb = edges.block_count();
+  size_t lo = 1, hi = nb;
+
+  if (nb == 0)
+    return;
+  // Find the first block starting after the window's start
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (edges.block_first_timestamp(mid) <= after)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  vertex_index_t block[CODEC_BLOCK_SIZE];
+  for (size_t k = lo - 1; k < nb; k++) {
+    if (k > 0 && edges.block_first_timestamp(k) > until)
+      return;
+    size_t m = edges.decode(k, block);
+    // Blocks starting and followed by one starting within the window lie in it
+    if (k > 0 && edges.block_first_timestamp(k) > after && k + 1 < nb
+        && edges.block_first_timestamp(k + 1) <= until) {
+      for (size_t i = 0; i < m; i++)
+        f(block[i]);
+      continue;
+    }
+    for (size_t i = 0; i < m; i++) {
+      timestamp_t t = cg.get_timestamp(block[i]);
+      if (t > until)
+        return;
+      if (t > after)
+        f(block[i]);
+    }
+  }
+}
+
+/**
+ * \function compressed_citer_counts
+ * \brief Counts the "it" vertices of a vertex of a compressed graph by what they cite.
+ *
+ * \param cg The compressed graph.
+ * \param focal The focal vertex index.
+ * \param time_delta Time beyond stamp of focal vertex to consider in measure.
+ * \param scratch Working storage of the calling thread.
+ * \param cache If not NULL, holds the decoded in edges of widely cited
+ * vertices, shared among threads.
+ *
+ * This follows frozen_citer_counts, decoding the adjacency lists as
+ * they are traversed. The focal vertex's references are decoded once
+ * and marked in the scratch bitmap, against which each citer's
+ * references are tested block by block.
+ *
+ * \return The counts, from which the CD index is derived.
+ */
+static citer_counts_t compressed_citer_counts(const CompressedGraph &cg,
+    vertex_index_t focal, timestamp_t time_delta, ScratchContext &scratch,
+    CiterCache *cache){
+
+  timestamp_t t0 = cg.get_timestamp(focal);
+  CompressedList out(cg.get_out_edges(focal));
+  std::vector<vertex_index_t> &refs = scratch.get_decoded();
+
+  refs.resize(out.size());
+  for (size_t k = 0; k < out.block_count(); k++)
+    out.decode(k, refs.data() + k * CODEC_BLOCK_SIZE);
+
+  scratch.begin(cg.get_vcount());
+  auto visit = [&scratch](vertex_index_t v) { scratch.visit(v); };
+  auto visit_citers = [&](vertex_index_t r) {
+    if (!cache || cg.get_in_degree(r) < CITER_CACHE_MIN_DEGREE) {
+      compressed_in_edges_between(cg, r, t0, t0 + time_delta, visit);
+      return;
+    }
+    CiterCache::citers_t citers(cache->find(r));
+    if (!citers) {
+      CompressedList edges(cg.get_in_edges(r));
+      std::vector<vertex_index_t> decoded(edges.size());
+      for (size_t k = 0; k < edges.block_count(); k++)
+        edges.decode(k, decoded.data() + k * CODEC_BLOCK_SIZE);
+      citers = cache->insert(r, std::move(decoded));
+    }
+    auto earlier = [&cg](timestamp_t t, vertex_index_t v) { return t < cg.get_timestamp(v); };
+    auto begin = std::upper_bound(citers->begin(), citers->end(), t0, earlier);
+    auto end = std::upper_bound(begin, citers->end(), t0 + time_delta, earlier);
+    for (auto i = begin; i != end; i++)
+      scratch.visit(*i);
+  };
+  for (size_t j = 0; j < refs.size(); j++) {
+    if (j + 2 * PREFETCH_DISTANCE < refs.size())
+      cg.prefetch_in_offset(refs[j + 2 * PREFETCH_DISTANCE]);
+    if (j + PREFETCH_DISTANCE < refs.size())
+      cg.prefetch_in_edges(refs[j + PREFETCH_DISTANCE]);
+    visit_citers(refs[j]);
+  }
+  visit_citers(focal);
+
+  EdgeList marked(refs.data(), refs.data() + refs.size());
+  scratch.mark_references(marked);
+  citer_counts_t counts = {0, 0, 0};
+  vertex_index_t block[CODEC_BLOCK_SIZE];
+  const std::vector<vertex_index_t> &visited = scratch.get_visited();
+  for (size_t j = 0; j < visited.size(); j++) {
+    if (j + 2 * PREFETCH_DISTANCE < visited.size())
+      cg.prefetch_out_offset(visited[j + 2 * PREFETCH_DISTANCE]);
+    if (j + PREFETCH_DISTANCE < visited.size())
+      cg.prefetch_out_edges(visited[j + PREFETCH_DISTANCE]);
+    vertex_index_t i = visited[j];
+    // Most citers have a single block, decoded once for both tests
+    CompressedList citer_refs(cg.get_out_edges(i));
+    size_t nb = citer_refs.block_count();
+    size_t m = nb == 1 ? citer_refs.decode(0, block) : 0;
+    if (nb == 1 ? !std::binary_search(block, block + m, focal) : !cg.has_out_edge(i, focal)) {
+      counts.b_only++;
+      continue;
+    }
+    bool b_it = false;
+    for (size_t k = 0; k < nb && !b_it; k++) {
+      if (nb > 1)
+        m = citer_refs.decode(k, block);
+      for (size_t j = 0; j < m && !b_it; j++)
+        b_it = scratch.is_reference(block[j]);
+    }
+    if (b_it)
+      counts.f_and_b++;
+    else
+      counts.f_only++;
+  }
+  scratch.clear_references(marked);
+  return counts;
+}
+
+/**
+ * \function cdindex
+ * \brief Computes the CD Index of a vertex of a compressed graph.
+ *
+ * \param g The compressed graph.
+ * \param v The focal vertex index.
+ * \param time_delta Time beyond stamp of focal vertex to consider in measure.
+ * \param scratch Working storage, reused across calls by the same thread.
+ * \param cache If not NULL, a cache of the graph's citers, which can be
+ * shared by concurrent calls.
+ *
+ * \return The value of the CD index.
+ */
+double cdindex(const CompressedGraph &g, vertex_index_t v, timestamp_t time_delta,
+    ScratchContext &scratch, CiterCache *cache){
+  return counts_cdindex(compressed_citer_counts(g, v, time_delta, scratch, cache));
+}
+
+/**
+ * \function iindex
+ * \brief Computes the I Index of a vertex of a compressed graph.
+ *
+ * \param g The compressed graph.
+ * \param v The focal vertex index.
+ * \param time_delta Time beyond stamp of focal vertex to consider in computing the measure.
+ *
+ * \return The value of the I index.
+ */
+size_t iindex(const CompressedGraph &g, vertex_index_t v, timestamp_t time_delta){
+  return g.get_in_degree_until(v, g.get_timestamp(v) + time_delta);
+}
+
+/**
+ * \function cdindex_batch
+ * \brief Computes the CD, mCD, and I indices of many vertices of a
+ * compressed graph in parallel.
+ *
+ * \param g The compressed graph.
+ * \param focal The indices of the focal vertices, or NULL for all vertices.
+ * \param n The number of focal vertices.
+ * \param time_delta Time beyond stamp of focal vertex to consider in computing the measures.
+ * \param out Array of n elements where the computed values are stored.
+ * \param nthreads Number of threads to use; 0 for all available cores.
+ * \param cache If not NULL, a cache of the graph's citers shared by
+ * the threads.
+ */
+void cdindex_batch(const CompressedGraph &g, const vertex_index_t *focal, size_t n,
+    timestamp_t time_delta, index_values_t *out, unsigned nthreads,
+    CiterCache *cache) {
+
+  std::vector<ScratchContext> scratches;
+  std::vector<size_t> schedule(batch_order(g, focal, n));
+
+  parallel_for(n, nthreads, scratches, [&](size_t j, ScratchContext &scratch) {
+    size_t k = schedule.empty() ? j : schedule[j];
+    vertex_index_t v = focal ? focal[k] : vertex_index_t(k);
+    out[k].cdindex = cdindex(g, v, time_delta, scratch, cache);
+    out[k].iindex = iindex(g, v, time_delta);
+    out[k].mcdindex = out[k].cdindex * out[k].iindex;
+  });
+}
+
+/*
+ * A splitmix64 pseudo-random number generator, cheap enough to be
+ * seeded anew for each focal vertex, so that estimates do not depend
+ * on the thread or order in which vertices are computed.
+ */
+class SampleRandom {
+private:
+  uint64_t state;
+
+public:
+  SampleRandom(uint64_t seed) : state(seed) {}
+
+  uint64_t next() {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  // Return a number in [0, n)
+  uint64_t below(uint64_t n) {
+    return uint64_t(((unsigned __int128)next() * n) >> 64);
+  }
+};
+
+/*
+ * Estimate the CD index of a focal vertex of a frozen graph; see
+ * cdindex_approximate. The "it" vertices are the direct citers D of
+ * the focal vertex and the union U of its references' citers R_r,
+ * all within the time window, and
+ * CD = (|D| - 2|D & U|) / (|D| + |U - D|).
+ * |D| is known, and the fraction of D in U is estimated from a sample
+ * of D. |U - D| is estimated by the Karp-Luby method: citers c are
+ * sampled uniformly from the M elements of all R_r, and each one not
+ * in D counts as M / m(c), where m(c) is the number of the focal
+ * vertex's references c cites. The interval follows from the
+ * variances of the two independent estimates through the delta method.
+ */
+static cdindex_estimate_t frozen_cdindex_approximate(const FrozenGraph &fg,
+    vertex_index_t focal, timestamp_t time_delta, size_t budget, uint64_t seed,
+    ScratchContext &scratch){
+
+  timestamp_t t0 = fg.get_timestamp(focal);
+  EdgeList refs(fg.get_out_edges(focal));
+  EdgeList direct(fg.get_in_edges_between(focal, t0, t0 + time_delta));
+  std::vector<EdgeList> citers;
+  std::vector<size_t> citers_end;
+  size_t m = 0;
+
+  citers.reserve(refs.size());
+  citers_end.reserve(refs.size());
+  for (auto r : refs) {
+    citers.push_back(fg.get_in_edges_between(r, t0, t0 + time_delta));
+    citers_end.push_back(m += citers.back().size());
+  }
+
+  double a = direct.size();
+  if (direct.size() + m <= budget || a == 0 || m == 0) {
+    // Without direct citers the index is 0, without references' citers 1
+    double value = a == 0 && m == 0 ? NAN : a == 0 ? 0 : m == 0 ? 1
+      : frozen_cdindex(fg, focal, time_delta, scratch);
+    return cdindex_estimate_t{value, value, value, true};
+  }
+
+  scratch.begin(fg.get_vcount());
+  scratch.mark_references(refs);
+  // Return the number of the focal vertex's references c cites, or -1 if it cites the vertex
+  auto cited_references = [&](vertex_index_t c) {
+    int n = 0;
+    for (auto j : fg.get_out_edges(c))
+      if (j == focal)
+        return -1;
+      else if (scratch.is_reference(j))
+        n++;
+    return n;
+  };
+  SampleRandom random(seed ^ (uint64_t(focal) * 0xd1b54a32d192ed03ULL));
+
+  // The fraction of the direct citers that also cite a reference
+  size_t nd = std::min(direct.size(), std::max(budget / 2, size_t(1)));
+  size_t shared = 0;
+  for (size_t i = 0; i < nd; i++) {
+    vertex_index_t c = direct.begin()[nd == direct.size() ? i : random.below(direct.size())];
+    for (auto j : fg.get_out_edges(c))
+      if (scratch.is_reference(j)) {
+        shared++;
+        break;
+      }
+  }
+  double p = double(shared) / nd;
+  // Keep the interval open when none or all sampled citers are shared
+  double pv = (shared + 1.0) / (nd + 2.0);
+  double p_variance = nd == direct.size() ? 0 : pv * (1 - pv) / nd;
+
+  // The number of the references' citers that do not cite the focal vertex
+  size_t nu = budget > nd + 2 ? budget - nd : 2;
+  double sum = 0, sum_squares = 0;
+  for (size_t i = 0; i < nu; i++) {
+    size_t k = random.below(m);
+    size_t r = std::upper_bound(citers_end.begin(), citers_end.end(), k) - citers_end.begin();
+    vertex_index_t c = citers[r].begin()[k - (citers_end[r] - citers[r].size())];
+    int n = cited_references(c);
+    double y = n > 0 ? 1.0 / n : 0;
+    sum += y;
+    sum_squares += y * y;
+  }
+  scratch.clear_references(refs);
+  double mean = sum / nu;
+  double b = m * mean;
+  double b_variance = double(m) * m * std::max(0.0, sum_squares - nu * mean * mean)
+    / (nu - 1) / nu;
+
+  double numerator = a * (1 - 2 * p);
+  double denominator = a + b;
+  double value = numerator / denominator;
+  double d_p = 2 * a / denominator;
+  double d_b = numerator / (denominator * denominator);
+  double error = APPROXIMATE_Z * std::sqrt(d_p * d_p * p_variance + d_b * d_b * b_variance);
+  return cdindex_estimate_t{value, std::max(-1.0, value - error),
+    std::min(1.0, value + error), false};
+}
+
+/**
+ * \function cdindex_approximate
+ * \brief Estimates the CD Index from a sample of the "it" vertices.
+ *
+ * \param g The graph, which must have been prepared for searching.
+ * \param v The focal vertex index.
+ * \param time_delta Time beyond stamp of focal vertex to consider in measure.
+ * \param budget The number of "it" vertices to examine.
+ * \param scratch Working storage, reused across calls by the same thread.
+ * \param seed Seed of the random sample, which together with the
+ *   vertex index determines it.
+ *
+ * Half the budget at most samples the direct citers of the focal vertex,
+ * and the rest the citers of its references, so that the cost does not
+ * grow with the size of the neighborhood. Vertices whose direct citers
+ * and citers of references are together no more than the budget are
+ * computed exactly.
+ *
+ * \return The estimate with its 95% confidence interval.
+ */
+cdindex_estimate_t cdindex_approximate(const Graph &g, vertex_index_t v,
+    timestamp_t time_delta, size_t budget, ScratchContext &scratch, uint64_t seed){
+  return frozen_cdindex_approximate(g.get_frozen(), v, time_delta, budget, seed, scratch);
+}
+
+/**
+ * \function cdindex_approximate_batch
+ * \brief Estimates the CD indices of many vertices in parallel.
+ *
+ * \param g The graph, which must have been prepared for searching.
+ * \param focal The indices of the focal vertices, or NULL for all vertices.
+ * \param n The number of focal vertices.
+ * \param time_delta Time beyond stamp of focal vertex to consider in computing the measures.
+ * \param budget The number of "it" vertices to examine for each focal vertex.
+ * \param out Array of n elements where the estimates are stored.
+ * \param nthreads Number of threads to use; 0 for all available cores.
+ * \param seed Seed of the random samples; see cdindex_approximate.
+ */
+void cdindex_approximate_batch(const Graph &g, const vertex_index_t *focal, size_t n,
+    timestamp_t time_delta, size_t budget, cdindex_estimate_t *out, unsigned nthreads,
+    uint64_t seed) {
+
+  const FrozenGraph &fg = g.get_frozen();
+  std::vector<ScratchContext> scratches;
+  std::vector<size_t> schedule(batch_order(fg, focal, n));
+
+  parallel_for(n, nthreads, scratches, [&](size_t j, ScratchContext &scratch) {
+    size_t k = schedule.empty() ? j : schedule[j];
+    vertex_index_t v = focal ? focal[k] : vertex_index_t(k);
+    out[k] = frozen_cdindex_approximate(fg, v, time_delta, budget, seed, scratch);
+  });
+}
+
+/*
+ * Append to changes the vertices with an index below first_added for
+ * which the added vertex c is an additional "it" vertex, each with the
+ * contribution of c to its CD index sum. These are the vertices within
+ * whose time window c falls, and which c cites, or which cite one of
+ * c's references.
+ */
+static void added_citer_changes(const FrozenGraph &fg, vertex_index_t first_added,
+    vertex_index_t c, timestamp_t time_delta, ScratchContext &scratch,
+    std::vector<std::pair<vertex_index_t, int>> &changes) {
+
+  timestamp_t tc = fg.get_timestamp(c);
+  EdgeList refs(fg.get_out_edges(c));
+
+  // Collect vertices whose timestamp t satisfies t < tc <= t + time_delta
+  scratch.begin(fg.get_vcount());
+  for (auto r : refs) {
+    if (r < first_added && fg.get_timestamp(r) < tc && tc - fg.get_timestamp(r) <= time_delta)
+      scratch.visit(r);
+    for (auto f : fg.get_in_edges_between(r, tc - time_delta - 1, tc - 1))
+      if (f < first_added)
+        scratch.visit(f);
+  }
+
+  scratch.mark_references(refs);
+  for (auto f : scratch.get_visited()) {
+    int f_it = scratch.is_reference(f);
+    int b_it = 0;
+    for (auto j : fg.get_out_edges(f))
+      if (scratch.is_reference(j)) {
+        b_it = 1;
+        break;
+      }
+    changes.push_back(std::make_pair(f, -2*f_it*b_it + f_it));
+  }
+  scratch.clear_references(refs);
+}
+
+/* Working storage of a thread updating a CDIndexTracker */
+typedef struct {
+  ScratchContext scratch;
+  std::vector<std::pair<vertex_index_t, int>> changes;
+} tracker_state_t;
+
+/**
+ * \function CDIndexTracker::update
+ * \brief Account for the vertices added to the graph since the last update.
+ *
+ * \param g The graph, which must have been prepared for searching after
+ *   the vertices were added. Since the last update, edges must have been
+ *   added to the graph only from the added vertices.
+ * \param nthreads Number of threads to use; 0 for all available cores.
+ *
+ * The counts of the added vertices are computed from their neighborhoods.
+ * Each added vertex is then counted as an additional citer of the
+ * earlier vertices it affects, according to what it cites.
+ *
+ * \return The indices of the vertices whose counts have been set or
+ * changed, in ascending order.
+ */
+std::vector<vertex_index_t>
+CDIndexTracker::update(const Graph &g, unsigned nthreads) {
+
+  const FrozenGraph &fg = g.get_frozen();
+  size_t first_added = counts.size(), n = fg.get_vcount();
+
+  counts.resize(n);
+  std::vector<ScratchContext> scratches;
+  parallel_for(n - first_added, nthreads, scratches, [&](size_t k, ScratchContext &scratch) {
+    counts[first_added + k] = frozen_citer_counts(fg, first_added + k, time_delta, scratch);
+  });
+
+  std::vector<vertex_index_t> changed;
+  if (first_added > 0) {
+    std::vector<tracker_state_t> states;
+    parallel_for(n - first_added, nthreads, states, [&](size_t k, tracker_state_t &state) {
+      added_citer_changes(fg, first_added, first_added + k, time_delta,
+          state.scratch, state.changes);
+    });
+
+    for (auto &state : states)
+      for (auto change : state.changes) {
+        citer_counts_t &c = counts[change.first];
+        switch (change.second) {
+        case 1: c.f_only++; break;
+        case -1: c.f_and_b++; break;
+        default: c.b_only++; break;
+        }
+        changed.push_back(change.first);
+      }
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+  }
+
+  for (size_t v = first_added; v < n; v++)
+    changed.push_back(v);
+  return changed;
+}
+
+/**
+ * \function CDIndexTracker::get_values
+ * \brief Return the CD, mCD, and I indices of a vertex accounted for by the tracker.
+ *
+ * \param g The graph passed to update.
+ * \param v The vertex index.
+ */
+index_values_t
+CDIndexTracker::get_values(const Graph &g, vertex_index_t v) const {
+  index_values_t values;
+
+  values.cdindex = counts_cdindex(counts[v]);
+  values.iindex = frozen_iindex(g.get_frozen(), v, time_delta);
+  values.mcdindex = values.cdindex * values.iindex;
+  return values;
+}
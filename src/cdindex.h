@@ -18,62 +18,223 @@
 */
 
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <new>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
+#include "gap_codec.h"
+
 
 typedef long long int timestamp_t;
-class Vertex;
 
 /*
- * A data type that allows accessing graph vertices either
- * through their Python-visible integer id (id), or through
- * the internally-used Vertex pointer (v).
+ * Dense index of a vertex in the order it was added to its graph.
+ * Indices are 32-bit, unless CDINDEX_64BIT_INDICES is defined
+ * to support graphs of more than about four billion vertices.
  */
-typedef union {
-	unsigned long long int id;
-	Vertex *v;
-} vertex_id_t;
+#ifdef CDINDEX_64BIT_INDICES
+typedef uint64_t vertex_index_t;
+#else
+typedef uint32_t vertex_index_t;
+#endif
 
-inline vertex_id_t
-make_vertex_id(unsigned long long int id)
-{
-	vertex_id_t ret;
-	ret.id = id;
-	return ret;
-}
+/* The maximum number of vertices a graph can hold */
+const size_t MAX_VCOUNT = std::numeric_limits<vertex_index_t>::max();
 
-inline vertex_id_t
-make_vertex_id(Vertex *v)
-{
-	vertex_id_t ret;
-	ret.v = v;
-	return ret;
-}
+/*
+ * A pool from which the edge lists of the graph's vertices are allocated
+ * while the graph is being built. Blocks are carved from large chunks,
+ * and blocks released when an edge list grows are kept in free lists
+ * of power-of-two size classes for reuse. All memory is released
+ * together, in time proportional to the number of chunks.
+ */
+class EdgePool {
+private:
+  // Number of elements in each chunk; larger blocks get their own chunk
+  static const size_t CHUNK_SIZE = 1 << 20;
+  static const int SIZE_CLASSES = 33;
+  // Smallest size class whose blocks can hold a free list link
+  static const int MIN_SIZE_CLASS = sizeof(void *) > sizeof(vertex_index_t) ? 1 : 0;
+
+  std::vector<std::unique_ptr<vertex_index_t[]>> chunks;
+  vertex_index_t *next;
+  size_t available;
+  // Singly-linked lists of released blocks, threaded through their first elements
+  vertex_index_t *free_blocks[SIZE_CLASSES];
+
+  // Return the base-2 logarithm of n rounded down and up
+  static int floor_log2(size_t n) { return 63 - __builtin_clzll(n); }
+  static int ceil_log2(size_t n) { return n <= 1 ? 0 : floor_log2(n - 1) + 1; }
+
+  void push_free(vertex_index_t *block, size_t capacity) {
+    int c = floor_log2(capacity);
+    if (c < MIN_SIZE_CLASS)
+      return;
+    memcpy(block, &free_blocks[c], sizeof(vertex_index_t *));
+    free_blocks[c] = block;
+  }
+
+public:
+  EdgePool() : next(NULL), available(0) {
+    std::fill(free_blocks, free_blocks + SIZE_CLASSES, (vertex_index_t *)NULL);
+  }
+  EdgePool(const EdgePool &) = delete;
+  EdgePool &operator=(const EdgePool &) = delete;
+
+  /*
+   * Return a block of at least the specified (non-zero) number
+   * of elements, and set capacity to its actual size.
+   * If exact is false, fresh blocks are rounded up to a power of two,
+   * so that they can be reused by any list of that size class.
+   */
+  vertex_index_t *allocate(size_t n, uint32_t &capacity, bool exact) {
+    int c = ceil_log2(n);
+    if (c < MIN_SIZE_CLASS)
+      c = MIN_SIZE_CLASS;
+    if (free_blocks[c]) {
+      vertex_index_t *block = free_blocks[c];
+      memcpy(&free_blocks[c], block, sizeof(vertex_index_t *));
+      capacity = uint32_t(1) << c;
+      return block;
+    }
+
+    n = exact ? std::max(n, size_t(1) << MIN_SIZE_CLASS) : size_t(1) << c;
+    if (n > available) {
+      if (n > CHUNK_SIZE / 4) {
+        chunks.emplace_back(new vertex_index_t[n]);
+        capacity = n;
+        return chunks.back().get();
+      }
+      if (available)
+        push_free(next, available);
+      chunks.emplace_back(new vertex_index_t[CHUNK_SIZE]);
+      next = chunks.back().get();
+      available = CHUNK_SIZE;
+    }
+    vertex_index_t *block = next;
+    next += n;
+    available -= n;
+    capacity = n;
+    return block;
+  }
+
+  // Make the specified block available for reuse
+  void release(vertex_index_t *block, size_t capacity) {
+    if (capacity)
+      push_free(block, capacity);
+  }
+
+  // Release all blocks
+  void clear() {
+    std::vector<std::unique_ptr<vertex_index_t[]>>().swap(chunks);
+    next = NULL;
+    available = 0;
+    std::fill(free_blocks, free_blocks + SIZE_CLASSES, (vertex_index_t *)NULL);
+  }
+
+  void swap(EdgePool &other) {
+    chunks.swap(other.chunks);
+    std::swap(next, other.next);
+    std::swap(available, other.available);
+    std::swap_ranges(free_blocks, free_blocks + SIZE_CLASSES, other.free_blocks);
+  }
+};
 
+/*
+ * A growable list of edges, whose elements are stored in an EdgePool.
+ * The list does not own its storage, which is released with the pool.
+ */
+class EdgeVector {
+private:
+  vertex_index_t *elements;
+  uint32_t length;
+  uint32_t capacity;
+
+  // Move the elements to a block of at least the specified capacity
+  void reallocate(size_t n, EdgePool &pool, bool exact) {
+    uint32_t new_capacity;
+    vertex_index_t *block = pool.allocate(n, new_capacity, exact);
+    std::copy(elements, elements + length, block);
+    pool.release(elements, capacity);
+    elements = block;
+    capacity = new_capacity;
+  }
+
+public:
+  EdgeVector() : elements(NULL), length(0), capacity(0) {}
+
+  vertex_index_t *begin() { return elements; }
+  vertex_index_t *end() { return elements + length; }
+  const vertex_index_t *begin() const { return elements; }
+  const vertex_index_t *end() const { return elements + length; }
+  size_t size() const { return length; }
+
+  void push_back(vertex_index_t v, EdgePool &pool) {
+    if (length == capacity)
+      reallocate(size_t(length) + 1, pool, false);
+    elements[length++] = v;
+  }
+
+  // Make room for the specified number of additional elements
+  void reserve(size_t extra, EdgePool &pool) {
+    if (length + extra > capacity)
+      reallocate(length + extra, pool, true);
+  }
+
+  // Move the elements into an exactly-sized block allocated from pool
+  void compact(EdgePool &pool) {
+    vertex_index_t *block = NULL;
+    uint32_t new_capacity = 0;
+    if (length)
+      block = pool.allocate(length, new_capacity, true);
+    std::copy(elements, elements + length, block);
+    elements = block;
+    capacity = new_capacity;
+  }
+};
+
+/*
+ * A vertex of a graph that is being built.
+ * Its edges are stored as the indices of the vertices they link to.
+ */
 class Vertex {
 
 private:
   timestamp_t timestamp;
-  std::vector<Vertex *> in_edges;
-  std::vector<Vertex *> out_edges;
+  EdgeVector in_edges;
+  EdgeVector out_edges;
 
 public:
   Vertex(timestamp_t t) : timestamp(t) {}
 
-  const std::vector<Vertex *> &get_out_edges() const { return out_edges; }
-  const std::vector<Vertex *> &get_in_edges() const { return in_edges; }
+  const EdgeVector &get_out_edges() const { return out_edges; }
+  const EdgeVector &get_in_edges() const { return in_edges; }
 
   size_t get_in_degree() const { return in_edges.size(); }
   size_t get_out_degree() const { return out_edges.size(); }
 
   timestamp_t get_timestamp() const { return timestamp; }
 
-  // Reduce used memory from capacity to what is actuall required
-  void shrink_to_fit() {
-    out_edges.shrink_to_fit();
-    in_edges.shrink_to_fit();
+  // Make room for the specified number of additional edges
+  void reserve_edges(size_t extra_in, size_t extra_out, EdgePool &pool) {
+    in_edges.reserve(extra_in, pool);
+    out_edges.reserve(extra_out, pool);
+  }
+
+  // Move the edges into exactly-sized blocks of the specified pool
+  void compact_edges(EdgePool &pool) {
+    out_edges.compact(pool);
+    in_edges.compact(pool);
   }
 
   // Sort out_edges to allow binary search on them
@@ -81,53 +242,724 @@ public:
       std::sort(out_edges.begin(), out_edges.end());
   }
 
-  bool has_out_edge(Vertex *out) const {
+  bool has_out_edge(vertex_index_t out) const {
       return std::binary_search(out_edges.begin(), out_edges.end(),  out);
   }
 
-  friend void add_edge(vertex_id_t source_id, vertex_id_t target_id);
+  friend class Graph;
+};
+
+/*
+ * A bump allocator for a graph's vertices. Vertices are constructed
+ * in place in large chunks, which are released together, and are
+ * addressed by their index.
+ */
+class VertexArena {
+private:
+  // Number of vertices in each chunk, as a power of two
+  static const int CHUNK_BITS = 16;
+  static const size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+
+  std::vector<std::unique_ptr<char[]>> chunks;
+  size_t count;
 
+  Vertex *chunk(size_t i) const {
+    return reinterpret_cast<Vertex *>(chunks[i].get());
+  }
+
+public:
+  VertexArena() : count(0) {}
+  VertexArena(const VertexArena &) = delete;
+  VertexArena &operator=(const VertexArena &) = delete;
+
+  // Construct a vertex, which gets the next index
+  void create(timestamp_t timestamp) {
+    if (count % CHUNK_SIZE == 0)
+      chunks.emplace_back(new char[CHUNK_SIZE * sizeof(Vertex)]);
+    new (chunk(count >> CHUNK_BITS) + count % CHUNK_SIZE) Vertex(timestamp);
+    count++;
+  }
+
+  Vertex &operator[](vertex_index_t i) { return chunk(i >> CHUNK_BITS)[i % CHUNK_SIZE]; }
+  const Vertex &operator[](vertex_index_t i) const { return chunk(i >> CHUNK_BITS)[i % CHUNK_SIZE]; }
+  size_t size() const { return count; }
+
+  // Release all vertices
+  void clear() {
+    std::vector<std::unique_ptr<char[]>>().swap(chunks);
+    count = 0;
+  }
+
+  // Vertices need no destruction, because their edges are owned by an EdgePool
+  static_assert(std::is_trivially_destructible<Vertex>::value,
+      "Vertex objects are released without calling their destructor");
 };
 
-/**
- * \function add_edge
- * \brief Add a edge to a graph.
- *
- * \param graph The input graph.
- * \param source_id The source vertex id.
- * \param target_id The target vertex id.
- *
- * Adges must be added only once.
+/*
+ * A contiguous range of vertex indices stored in a FrozenGraph.
  */
-inline void add_edge(vertex_id_t source_id, vertex_id_t target_id) {
+class EdgeList {
+private:
+  const vertex_index_t *first;
+  const vertex_index_t *last;
 
-  source_id.v->out_edges.push_back(target_id.v);
-  target_id.v->in_edges.push_back(source_id.v);
-}
+public:
+  EdgeList(const vertex_index_t *f, const vertex_index_t *l) : first(f), last(l) {}
 
-class Graph {
+  const vertex_index_t *begin() const { return first; }
+  const vertex_index_t *end() const { return last; }
+  size_t size() const { return last - first; }
+};
+
+/* function prototypes for numa.cpp */
+unsigned numa_node_count();
+unsigned numa_current_node();
+bool numa_pin_thread(unsigned node);
+bool numa_interleave(const void *addr, size_t length);
+bool numa_bind(const void *addr, size_t length, unsigned node);
+void numa_advise_huge_pages(const void *addr, size_t length);
+
+/*
+ * A read-only array that either owns its elements or views memory
+ * owned by another object, such as a mapped file.
+ */
+template <typename T>
+class FrozenArray {
 private:
-  std::vector<Vertex *> vs;
+  std::vector<T> owned;
+  const T *elements;
+  size_t length;
 
 public:
-  ~Graph() {
-    for (auto i : vs)
-      delete i;
+  FrozenArray() : elements(NULL), length(0) {}
+  FrozenArray(const FrozenArray &) = delete;
+  FrozenArray &operator=(const FrozenArray &) = delete;
+
+  // Take over the elements of the specified vector
+  void assign(std::vector<T> &&v) {
+    owned = std::move(v);
+    elements = owned.data();
+    length = owned.size();
   }
 
-  const std::vector<Vertex *> &get_vertices() { return vs; }
+  // View the specified externally-owned elements
+  void view(const T *p, size_t n) {
+    std::vector<T>().swap(owned);
+    elements = p;
+    length = n;
+  }
+
+  // Own a copy of the elements of another array, advised to use huge pages
+  void copy(const FrozenArray &from) {
+    std::vector<T> v;
+    v.reserve(from.size());
+    numa_advise_huge_pages(v.data(), from.size() * sizeof(T));
+    v.assign(from.data(), from.data() + from.size());
+    assign(std::move(v));
+  }
+
+  const T &operator[](size_t i) const { return elements[i]; }
+  const T *data() const { return elements; }
+  size_t size() const { return length; }
+};
+
+/* The value returned when looking up a vertex that does not exist */
+const vertex_index_t NO_VERTEX = std::numeric_limits<vertex_index_t>::max();
+
+/*
+ * A mapping between vertex names, such as DOIs, and the indices of
+ * the vertices they name, which are assigned to names in the order
+ * the names are added. Names are arbitrary byte strings, normally
+ * UTF-8, packed one after the other in an arena and delimited by an
+ * offsets array, which provides the mapping from indices to names.
+ * The mapping from names to indices is an open addressing hash table
+ * with linear probing, whose slots hold the name's index.
+ * The arrays are either owned or mapped from a graph file; mapped
+ * arrays are copied before they are modified.
+ */
+class NameIndex {
+private:
+  std::vector<char> owned_chars;
+  std::vector<uint64_t> owned_offsets;
+  std::vector<vertex_index_t> owned_slots;
+
+  // The arrays in use, which are either the owned or the mapped ones
+  const char *chars;
+  const uint64_t *offsets;
+  const vertex_index_t *slots;
+  size_t count;
+  size_t slot_count;
+  bool mapped;
 
-  size_t get_vcount() {
-	  return vs.size();
+  void use_owned() {
+    chars = owned_chars.data();
+    offsets = owned_offsets.data();
+    slots = owned_slots.data();
+    mapped = false;
   }
 
+  bool equals(vertex_index_t v, const char *name, size_t length) const {
+    return get_length(v) == length && memcmp(get_name(v), name, length) == 0;
+  }
+
+  void rehash(size_t n);
+  void grow();
+
+public:
+  NameIndex() : owned_offsets(1, 0), count(0), slot_count(0) { use_owned(); }
+  NameIndex(const NameIndex &) = delete;
+  NameIndex &operator=(const NameIndex &) = delete;
+
+  static uint64_t hash(const char *name, size_t length);
+
+  // Return the number of names
+  size_t size() const { return count; }
+
+  // Return the name of the vertex with the specified index, which is not NUL-terminated
+  const char *get_name(vertex_index_t v) const { return chars + offsets[v]; }
+  size_t get_length(vertex_index_t v) const { return offsets[v + 1] - offsets[v]; }
+
+  vertex_index_t find(const char *name, size_t length) const;
+  bool add(const char *name, size_t length);
+  void own();
+  void clear();
+  void reorder(const vertex_index_t *order);
+
+  // The underlying arrays, for saving them to a file
+  const char *get_chars() const { return chars; }
+  const uint64_t *get_offsets() const { return offsets; }
+  const vertex_index_t *get_slots() const { return slots; }
+  size_t get_slot_count() const { return slot_count; }
+
+  void view(const char *c, const uint64_t *o, size_t n, const vertex_index_t *s,
+      size_t ns);
+};
+
+/*
+ * A staging area for the vertices and edges of a graph added
+ * concurrently by many producer threads, for example ones parsing
+ * different parts of the input. Each thread appends to its own
+ * Producer, without locking; vertices get their indices by reserving
+ * them from a shared counter, so the vertices added through a single
+ * call get consecutive indices. Edges can refer to vertices added by
+ * any producer, and are checked when the graph is built from them
+ * with Graph::build, by a parallel counting sort. As with add_edge,
+ * each edge must be added only once.
+ */
+class GraphBuilder {
+public:
+  // The buffers of a producer thread, aligned to avoid false sharing
+  class alignas(64) Producer {
+  private:
+    std::atomic<size_t> *vcount;
+    // The first index and number of the vertices added by each call
+    std::vector<std::pair<vertex_index_t, size_t>> ranges;
+    std::vector<timestamp_t> timestamps;
+    std::vector<vertex_index_t> sources;
+    std::vector<vertex_index_t> targets;
+
+    friend class GraphBuilder;
+    friend class FrozenGraph;
+
+  public:
+    Producer() : vcount(NULL) {}
+
+    /**
+     * \function add_vertices
+     * \brief Add many vertices, which get consecutive indices.
+     *
+     * \param ts The timestamps of the new vertices.
+     * \param n The number of vertices to add.
+     *
+     * \return The index of the first added vertex, or NO_VERTEX with
+     * errno set to EINVAL, and no vertex added, if the builder would
+     * have more than MAX_VCOUNT vertices.
+     */
+    vertex_index_t add_vertices(const timestamp_t *ts, size_t n) {
+      size_t first = vcount->load(std::memory_order_relaxed);
+      do {
+        if (n > MAX_VCOUNT - first) {
+          errno = EINVAL;
+          return NO_VERTEX;
+        }
+      } while (!vcount->compare_exchange_weak(first, first + n, std::memory_order_relaxed));
+      if (!ranges.empty() && ranges.back().first + ranges.back().second == first)
+        ranges.back().second += n;
+      else
+        ranges.push_back(std::make_pair(first, n));
+      timestamps.insert(timestamps.end(), ts, ts + n);
+      return first;
+    }
+
+    vertex_index_t add_vertex(timestamp_t timestamp) { return add_vertices(&timestamp, 1); }
+
+    void add_edge(vertex_index_t source, vertex_index_t target) {
+      sources.push_back(source);
+      targets.push_back(target);
+    }
+
+    /**
+     * \function add_edges
+     * \brief Add many edges, specified through vertex indices.
+     *
+     * \return False if an index is not a valid vertex index, in which
+     * case no edge is added.
+     */
+    bool add_edges(const int64_t *s, const int64_t *t, size_t n) {
+      for (size_t i = 0; i < n; i++)
+        if (s[i] < 0 || uint64_t(s[i]) >= MAX_VCOUNT || t[i] < 0 || uint64_t(t[i]) >= MAX_VCOUNT)
+          return false;
+      sources.insert(sources.end(), s, s + n);
+      targets.insert(targets.end(), t, t + n);
+      return true;
+    }
+  };
+
+private:
+  std::atomic<size_t> vcount;
+  std::vector<Producer> producers;
+
+  friend class FrozenGraph;
+
+public:
+  /*
+   * Create a builder for the specified number of producer threads,
+   * numbered from 0, each of which must only use its own Producer.
+   */
+  GraphBuilder(unsigned nproducers) : vcount(0), producers(std::max(1u, nproducers)) {
+    for (auto &p : producers)
+      p.vcount = &vcount;
+  }
+  GraphBuilder(const GraphBuilder &) = delete;
+  GraphBuilder &operator=(const GraphBuilder &) = delete;
+
+  unsigned get_producer_count() const { return producers.size(); }
+  Producer &get_producer(unsigned i) { return producers[i]; }
+
+  size_t get_vcount() const { return vcount; }
+
   size_t get_ecount() const {
     size_t count = 0;
-    for (auto i : vs)
-      count += i->get_in_degree();
+    for (auto &p : producers)
+      count += p.sources.size();
     return count;
   }
 
+  // Release the added vertices and edges
+  void clear() {
+    for (auto &p : producers) {
+      std::vector<std::pair<vertex_index_t, size_t>>().swap(p.ranges);
+      std::vector<timestamp_t>().swap(p.timestamps);
+      std::vector<vertex_index_t>().swap(p.sources);
+      std::vector<vertex_index_t>().swap(p.targets);
+    }
+    vcount = 0;
+  }
+};
+
+/*
+ * An immutable compressed sparse row (CSR) representation of a graph.
+ * Out edges are stored as sorted target indices (CSR) and in edges
+ * as source indices (CSC), both delimited by per-vertex offset arrays.
+ * Vertex timestamps are held in an array parallel to the offsets.
+ * In edges are ordered by the timestamp of their source, which is also
+ * stored inline in an array parallel to the sources, so that the citers
+ * within a time window can be found through binary search.
+ * The arrays are either built in memory or mapped from a graph file.
+ */
+class FrozenGraph {
+private:
+  FrozenArray<timestamp_t> timestamps;
+  FrozenArray<size_t> out_offsets;
+  FrozenArray<vertex_index_t> out_targets;
+  FrozenArray<size_t> in_offsets;
+  FrozenArray<vertex_index_t> in_sources;
+  FrozenArray<timestamp_t> in_timestamps;
+
+  // Mapped graph file backing the arrays, if any
+  void *mapping;
+  size_t mapping_length;
+
+  void unmap();
+
+public:
+  FrozenGraph() : mapping(NULL), mapping_length(0) {}
+  FrozenGraph(const FrozenGraph &) = delete;
+  FrozenGraph &operator=(const FrozenGraph &) = delete;
+  ~FrozenGraph() { unmap(); }
+
+  size_t get_vcount() const { return timestamps.size(); }
+  size_t get_ecount() const { return out_targets.size(); }
+
+  // Return true if the arrays are mapped from a graph file
+  bool is_mapped() const { return mapping != NULL; }
+
+  // Call f(data, bytes) for each of the arrays
+  template <typename F>
+  void for_each_array(F f) const {
+    f(timestamps.data(), timestamps.size() * sizeof(timestamp_t));
+    f(out_offsets.data(), out_offsets.size() * sizeof(size_t));
+    f(out_targets.data(), out_targets.size() * sizeof(vertex_index_t));
+    f(in_offsets.data(), in_offsets.size() * sizeof(size_t));
+    f(in_sources.data(), in_sources.size() * sizeof(vertex_index_t));
+    f(in_timestamps.data(), in_timestamps.size() * sizeof(timestamp_t));
+  }
+
+  // Return the number of bytes taken by the arrays
+  size_t get_size() const {
+    return timestamps.size() * sizeof(timestamp_t)
+      + (out_offsets.size() + in_offsets.size()) * sizeof(size_t)
+      + (out_targets.size() + in_sources.size()) * sizeof(vertex_index_t)
+      + in_timestamps.size() * sizeof(timestamp_t);
+  }
+
+  timestamp_t get_timestamp(vertex_index_t v) const { return timestamps[v]; }
+
+  /*
+   * The underlying arrays, for exporting them without copying.
+   * They remain valid until the graph is built again.
+   */
+  const timestamp_t *get_timestamps() const { return timestamps.data(); }
+  const size_t *get_out_offsets() const { return out_offsets.data(); }
+  const vertex_index_t *get_out_targets() const { return out_targets.data(); }
+  const size_t *get_in_offsets() const { return in_offsets.data(); }
+  const vertex_index_t *get_in_sources() const { return in_sources.data(); }
+
+  EdgeList get_out_edges(vertex_index_t v) const {
+    return EdgeList(out_targets.data() + out_offsets[v],
+                    out_targets.data() + out_offsets[v + 1]);
+  }
+
+  EdgeList get_in_edges(vertex_index_t v) const {
+    return EdgeList(in_sources.data() + in_offsets[v],
+                    in_sources.data() + in_offsets[v + 1]);
+  }
+
+  /*
+   * Return the in edges of the specified vertex whose source has
+   * a timestamp in the range (after, until].
+   */
+  EdgeList get_in_edges_between(vertex_index_t v, timestamp_t after,
+      timestamp_t until) const {
+    const timestamp_t *first = in_timestamps.data() + in_offsets[v];
+    const timestamp_t *last = in_timestamps.data() + in_offsets[v + 1];
+    const timestamp_t *lo = std::upper_bound(first, last, after);
+    const timestamp_t *hi = std::upper_bound(lo, last, until);
+    return EdgeList(in_sources.data() + (lo - in_timestamps.data()),
+                    in_sources.data() + (hi - in_timestamps.data()));
+  }
+
+  // Return the number of in edges whose source has a timestamp up to until
+  size_t get_in_degree_until(vertex_index_t v, timestamp_t until) const {
+    const timestamp_t *first = in_timestamps.data() + in_offsets[v];
+    const timestamp_t *last = in_timestamps.data() + in_offsets[v + 1];
+    return std::upper_bound(first, last, until) - first;
+  }
+
+  // Return the timestamp of the source of the in edge at the specified position
+  timestamp_t get_in_edge_timestamp(const vertex_index_t *edge) const {
+    return in_timestamps[edge - in_sources.data()];
+  }
+
+  size_t get_out_degree(vertex_index_t v) const {
+    return out_offsets[v + 1] - out_offsets[v];
+  }
+
+  size_t get_in_degree(vertex_index_t v) const {
+    return in_offsets[v + 1] - in_offsets[v];
+  }
+
+  bool has_out_edge(vertex_index_t v, vertex_index_t out) const {
+    EdgeList edges(get_out_edges(v));
+    return std::binary_search(edges.begin(), edges.end(), out);
+  }
+
+  bool save(const char *path, const NameIndex &names) const;
+  bool map(const char *path, bool verify, NameIndex &names);
+
+  void build(const VertexArena &vs, unsigned nthreads);
+  bool build(const GraphBuilder &builder, unsigned nthreads);
+  void relabel(const vertex_index_t *order, unsigned nthreads);
+  void copy(const FrozenGraph &from);
+
+  /**
+   * \function is_sane
+   * \brief Run a few basic (not comprehensive) checks on the CSR arrays.
+   *
+   * \return Whether the graph is sane.
+   */
+  bool is_sane() const {
+    size_t n = get_vcount();
+
+    if (out_offsets.size() != n + 1 || in_offsets.size() != n + 1)
+      return false;
+    if (in_sources.size() != out_targets.size()
+        || in_timestamps.size() != in_sources.size())
+      return false;
+    if (out_offsets[0] != 0 || out_offsets[n] != out_targets.size()
+        || in_offsets[0] != 0 || in_offsets[n] != in_sources.size())
+      return false;
+
+    size_t found = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (out_offsets[i] > out_offsets[i + 1] || in_offsets[i] > in_offsets[i + 1])
+        return false;
+      for (auto j : get_out_edges(i))
+        found += j < n && has_out_edge(i, j);
+      for (size_t k = in_offsets[i]; k < in_offsets[i + 1]; k++)
+        if (in_sources[k] >= n || in_timestamps[k] != timestamps[in_sources[k]]
+            || (k > in_offsets[i] && in_timestamps[k - 1] > in_timestamps[k]))
+          return false;
+    }
+
+    return found == out_targets.size();
+  }
+};
+
+/* The arrays of a graph file; see GraphFile */
+typedef enum {
+  GRAPH_FILE_TIMESTAMPS,
+  GRAPH_FILE_OUT_OFFSETS,
+  GRAPH_FILE_OUT_TARGETS,
+  GRAPH_FILE_IN_OFFSETS,
+  GRAPH_FILE_IN_SOURCES,
+  GRAPH_FILE_IN_TIMESTAMPS,
+  GRAPH_FILE_NAME_OFFSETS,
+  GRAPH_FILE_NAME_SLOTS,
+  GRAPH_FILE_NAME_CHARS,
+  GRAPH_FILE_ARRAYS
+} graph_file_array_t;
+
+/*
+ * A graph file written by FrozenGraph::save, whose arrays are read
+ * on demand rather than mapped, so that parts of graphs larger than
+ * the available memory can be processed; see cdindex_shard.
+ * Reads can be issued concurrently.
+ */
+class GraphFile {
+private:
+  int fd;
+  uint64_t vcount;
+  uint64_t name_count;
+  // Position and number of elements of each array in the file
+  uint64_t offset[GRAPH_FILE_ARRAYS];
+  uint64_t length[GRAPH_FILE_ARRAYS];
+
+public:
+  GraphFile() : fd(-1), vcount(0), name_count(0) {}
+  GraphFile(const GraphFile &) = delete;
+  GraphFile &operator=(const GraphFile &) = delete;
+  ~GraphFile() { close(); }
+
+  bool open(const char *path);
+  void close();
+
+  size_t get_vcount() const { return vcount; }
+  size_t get_name_count() const { return name_count; }
+
+  bool read(graph_file_array_t array, uint64_t first, uint64_t n, void *data) const;
+};
+
+/*
+ * Working storage for the CD index computations, to be reused across
+ * focal vertices by a single thread. Vertices are marked as visited by
+ * stamping them with the current epoch, so that clearing the visited set
+ * only requires advancing the epoch.
+ */
+class ScratchContext {
+private:
+  std::vector<uint32_t> visit_epoch;
+  uint32_t epoch;
+  std::vector<vertex_index_t> visited;
+  // Bitmap of the focal vertex's references; see mark_references
+  std::vector<uint64_t> reference_bits;
+  // References of the focal vertex decoded from a CompressedGraph
+  std::vector<vertex_index_t> decoded;
+
+public:
+  ScratchContext() : epoch(0) {}
+
+  /*
+   * Start a new computation on a graph of the specified number
+   * of vertices, with an empty set of visited vertices.
+   */
+  void begin(size_t vcount) {
+    if (visit_epoch.size() < vcount)
+      visit_epoch.resize(vcount, 0);
+    if (reference_bits.size() * 64 < vcount)
+      reference_bits.resize((vcount + 63) / 64, 0);
+    visited.clear();
+    if (++epoch == 0) {
+      // Wrapped around; stale stamps could match the new epoch
+      std::fill(visit_epoch.begin(), visit_epoch.end(), 0);
+      epoch = 1;
+    }
+  }
+
+  // Add the specified vertex to the visited set, if not already there
+  void visit(vertex_index_t v) {
+    if (visit_epoch[v] != epoch) {
+      visit_epoch[v] = epoch;
+      visited.push_back(v);
+    }
+  }
+
+  // Return the vertices visited since begin(), in order of their first visit
+  const std::vector<vertex_index_t> &get_visited() const { return visited; }
+
+  /*
+   * Set or clear the bits of the specified references in the bitmap.
+   * Every marked set must be cleared before the next one is marked.
+   */
+  void mark_references(EdgeList refs) {
+    for (auto v : refs)
+      reference_bits[v / 64] |= uint64_t(1) << (v % 64);
+  }
+
+  void clear_references(EdgeList refs) {
+    for (auto v : refs)
+      reference_bits[v / 64] = 0;
+  }
+
+  bool is_reference(vertex_index_t v) const {
+    return reference_bits[v / 64] & (uint64_t(1) << (v % 64));
+  }
+
+  std::vector<vertex_index_t> &get_decoded() { return decoded; }
+};
+
+/* Placement of a graph's arrays on the memory of the NUMA nodes */
+typedef enum {
+  NUMA_LOCAL,		// Where they were first written, by default
+  NUMA_INTERLEAVE,	// Interleaved across the nodes page by page
+  NUMA_REPLICATE,	// Copied to each node, for the threads running on it
+} numa_placement_t;
+
+/*
+ * A graph whose vertices are addressed by their dense index.
+ * The graph is built by adding vertices and edges, and is then frozen
+ * by prepare_for_searching into a FrozenGraph on which the indices
+ * are computed. Vertices can also be added to a prepared graph, together
+ * with their out edges; these are merged into the frozen graph when
+ * it is prepared again. Vertex indices passed to the methods are not
+ * checked; callers taking indices from outside must check them against
+ * get_vcount().
+ */
+class Graph {
+private:
+  // Vertices added since the graph was last prepared
+  VertexArena vs;
+  // Storage of the added vertices' edges until the graph is prepared
+  EdgePool edge_pool;
+  FrozenGraph frozen;
+  // Copies of the frozen graph on each NUMA node, if replicated; see place
+  std::vector<std::unique_ptr<FrozenGraph>> replicas;
+  // Names of the vertices, if they are named
+  NameIndex names;
+  bool prepared;
+
+  // Return the added vertex with the specified index
+  Vertex &added(vertex_index_t v) { return vs[v - frozen.get_vcount()]; }
+  const Vertex &added(vertex_index_t v) const { return vs[v - frozen.get_vcount()]; }
+
+public:
+  Graph() : prepared(false) {}
+
+  /*
+   * Return the frozen representation of the graph on which the
+   * indices are computed. Valid after prepare_for_searching().
+   */
+  const FrozenGraph &get_frozen() const { return frozen; }
+
+  /*
+   * Return the replica of the frozen graph on the specified NUMA node,
+   * which is the frozen graph itself if it is not replicated to it.
+   */
+  const FrozenGraph &get_frozen(unsigned node) const {
+    return node < replicas.size() && replicas[node] ? *replicas[node] : frozen;
+  }
+
+  // Return the number of NUMA nodes to which the graph is replicated, or 0
+  unsigned get_replica_count() const { return replicas.size(); }
+
+  bool place(numa_placement_t placement);
+
+  /*
+   * Return the names of the graph's vertices. Either all vertices
+   * are named, or only those added before any unnamed vertex.
+   */
+  const NameIndex &get_names() const { return names; }
+
+  // Return the index of the vertex with the specified name, or NO_VERTEX
+  vertex_index_t find_vertex(const char *name, size_t length) const {
+    return names.find(name, length);
+  }
+
+  bool is_prepared() const { return prepared; }
+
+  size_t get_vcount() const { return frozen.get_vcount() + vs.size(); }
+
+  /*
+   * Return the number of vertices in the frozen graph. Edges can only
+   * be added from vertices with a higher index.
+   */
+  size_t get_frozen_vcount() const { return frozen.get_vcount(); }
+
+  size_t get_ecount() const {
+    size_t count = frozen.get_ecount();
+    for (size_t i = 0; i < vs.size(); i++)
+      count += vs[i].get_out_degree();
+    return count;
+  }
+
+  timestamp_t get_timestamp(vertex_index_t v) const {
+    if (v < frozen.get_vcount())
+      return frozen.get_timestamp(v);
+    return added(v).get_timestamp();
+  }
+
+  /*
+   * The following functions return the edges of vertices of the frozen
+   * graph as they were when it was last prepared.
+   */
+  size_t get_in_degree(vertex_index_t v) const {
+    if (v < frozen.get_vcount())
+      return frozen.get_in_degree(v);
+    return added(v).get_in_degree();
+  }
+
+  size_t get_out_degree(vertex_index_t v) const {
+    if (v < frozen.get_vcount())
+      return frozen.get_out_degree(v);
+    return added(v).get_out_degree();
+  }
+
+  /**
+   * \function get_in_edges
+   * \brief Return the indices of the vertices that have an edge to the specified one.
+   */
+  std::vector<vertex_index_t> get_in_edges(vertex_index_t v) const {
+    if (v < frozen.get_vcount()) {
+      EdgeList edges(frozen.get_in_edges(v));
+      return std::vector<vertex_index_t>(edges.begin(), edges.end());
+    }
+    const EdgeVector &edges(added(v).get_in_edges());
+    return std::vector<vertex_index_t>(edges.begin(), edges.end());
+  }
+
+  /**
+   * \function get_out_edges
+   * \brief Return the indices of the vertices to which the specified one has an edge.
+   */
+  std::vector<vertex_index_t> get_out_edges(vertex_index_t v) const {
+    if (v < frozen.get_vcount()) {
+      EdgeList edges(frozen.get_out_edges(v));
+      return std::vector<vertex_index_t>(edges.begin(), edges.end());
+    }
+    const EdgeVector &edges(added(v).get_out_edges());
+    return std::vector<vertex_index_t>(edges.begin(), edges.end());
+  }
+
   /**
    * \function is_sane
    * \brief Run a few basic (not comprehensive) checks on graph data structure.
@@ -135,50 +967,702 @@ public:
    * \return Whether the graph is sane.
    */
   bool is_sane() const {
+    size_t base = frozen.get_vcount();
+
+    if (!frozen.is_sane())
+      return false;
 
     size_t in_edges = 0;
     size_t out_edges = 0;
-    for (auto i : vs) {
-      in_edges += i->get_in_degree();
-      out_edges += i->get_out_degree();
+    for (size_t i = 0; i < vs.size(); i++) {
+      in_edges += vs[i].get_in_degree();
+      out_edges += vs[i].get_out_degree();
     }
 
+    // Edges to frozen vertices are only recorded as out edges
     size_t found = 0;
-    for (auto i : vs)
-      for (auto j : i->get_out_edges())
-	found += i->has_out_edge(j);
+    for (size_t i = 0; i < vs.size(); i++)
+      for (auto j : vs[i].get_out_edges()) {
+	if (j < base)
+	  in_edges++;
+	found += j < get_vcount() && vs[i].has_out_edge(j);
+      }
 
     return in_edges == out_edges && found == out_edges;
   }
 
   /**
    * \function prepare_for_searching
-   * \brief Sort the out edges so that has_out_edge can use binary search
+   * \brief Freeze the graph into its CSR representation.
+   *
+   * The out edges of each vertex are stored sorted so that has_out_edge
+   * can use binary search. Vertices added since the graph was last
+   * prepared are merged into its frozen representation, and their
+   * storage and the pool of their edge lists are released.
+   *
+   * \param nthreads Number of threads to use; 0 for all available cores.
+   */
+  void prepare_for_searching(unsigned nthreads = 0) {
+    if (prepared)
+      return;
+    // The names may be in the file mapping released by the build
+    names.own();
+    std::vector<std::unique_ptr<FrozenGraph>>().swap(replicas);
+    frozen.build(vs, nthreads);
+    vs.clear();
+    edge_pool.clear();
+    prepared = true;
+  }
+
+  /**
+   * \function relabel
+   * \brief Renumber the vertices of the prepared graph.
+   *
+   * \param order The permutation to apply: new index i is given to
+   * the vertex whose current index is order[i].
+   * \param nthreads Number of threads to use; 0 for all available cores.
+   *
+   * Vertices keep their names, timestamps, and edges, so that their
+   * CD and other indices remain the same, but these are computed with fewer cache
+   * misses when vertices whose neighborhoods overlap get adjacent
+   * indices; see locality_order. Callers holding vertex indices,
+   * such as trackers, must translate them through order.
+   *
+   * \return True on success, false with errno set to EINVAL if the
+   * graph is not prepared, has only some of its vertices named,
+   * or order is not a permutation of its vertex indices.
+   */
+  bool relabel(const std::vector<vertex_index_t> &order, unsigned nthreads = 0) {
+    size_t n = get_vcount();
+    if (!prepared || order.size() != n || (names.size() && names.size() != n)) {
+      errno = EINVAL;
+      return false;
+    }
+    std::vector<bool> seen(n, false);
+    for (auto v : order) {
+      if (v >= n || seen[v]) {
+        errno = EINVAL;
+        return false;
+      }
+      seen[v] = true;
+    }
+    // The names may be in the file mapping released by the relabeling
+    names.reorder(order.data());
+    std::vector<std::unique_ptr<FrozenGraph>>().swap(replicas);
+    frozen.relabel(order.data(), nthreads);
+    return true;
+  }
+
+  /**
+   * \function shrink_to_fit
+   * \brief Compact the edges of the vertices added since the graph was prepared.
+   *
+   * The edge lists are copied in vertex order into exactly-sized
+   * blocks of a new pool, and the previous pool is released.
+   * This removes the slack left by the lists' growth.
+   */
+  void shrink_to_fit() {
+    EdgePool compacted;
+    for (size_t i = 0; i < vs.size(); i++)
+      vs[i].compact_edges(compacted);
+    edge_pool.swap(compacted);
+  }
+
+  /**
+   * \function save
+   * \brief Save the prepared graph to a file that can be loaded with mmap_load.
+   *
+   * \param path The name of the file to write.
+   *
+   * \return True on success, false with errno set on failure.
+   */
+  bool save(const char *path) const {
+    if (!prepared) {
+      errno = EINVAL;
+      return false;
+    }
+    return frozen.save(path, names);
+  }
+
+  /**
+   * \function mmap_load
+   * \brief Load an empty graph by mapping a file written by save.
+   *
+   * \param path The name of the file to load.
+   * \param verify Whether to verify the file's checksum.
+   *
+   * The graph's edges and vertex names are used in place from the
+   * read-only mapped file; the loaded graph is prepared for searching.
+   * Vertices keep the indices they had in the saved graph.
+   *
+   * \return True on success, false with errno set on failure.
    */
-  void prepare_for_searching() {
-    for (auto i : vs) {
-      // Improve locality of reference
-      i->shrink_to_fit();
-      i->sort_out_edges();
+  bool mmap_load(const char *path, bool verify = true) {
+    if (get_vcount() != 0) {
+      errno = EINVAL;
+      return false;
     }
+    std::vector<std::unique_ptr<FrozenGraph>>().swap(replicas);
+    if (!frozen.map(path, verify, names))
+      return false;
+    prepared = true;
+    return true;
+  }
+
+  /**
+   * \function build
+   * \brief Load an empty graph with the vertices and edges added to a builder.
+   *
+   * \param builder The builder, whose producers must have finished
+   * adding; its vertices and edges are released on success.
+   * \param nthreads Number of threads to use; 0 for all available cores.
+   *
+   * The edges are placed directly into the graph's CSR arrays, whose
+   * contents are the same as those of a graph to which the vertices
+   * and edges were added in index order; the loaded graph is prepared
+   * for searching.
+   *
+   * \return True on success, false with errno set to EINVAL if the
+   * graph is not empty, the builder has more than MAX_VCOUNT vertices,
+   * or an edge refers to a vertex that was not added.
+   */
+  bool build(GraphBuilder &builder, unsigned nthreads = 0) {
+    if (get_vcount() != 0) {
+      errno = EINVAL;
+      return false;
+    }
+    std::vector<std::unique_ptr<FrozenGraph>>().swap(replicas);
+    if (!frozen.build(builder, nthreads))
+      return false;
+    builder.clear();
+    prepared = true;
+    return true;
   }
 
   /**
    * \function add_vertex
    * \brief Add a vertex to a graph.
    *
-   * \param graph The input graph.
-   * \param id The new vertex id.
    * \param timestamp The new vertex timestamp.
+   *
+   * \return The index of the new vertex, or NO_VERTEX with errno set
+   * to EINVAL if the graph already has MAX_VCOUNT vertices.
+   */
+  vertex_index_t add_vertex(timestamp_t timestamp) {
+    if (get_vcount() >= MAX_VCOUNT) {
+      errno = EINVAL;
+      return NO_VERTEX;
+    }
+    vs.create(timestamp);
+    prepared = false;
+    return get_vcount() - 1;
+  }
+
+  /**
+   * \function add_vertex
+   * \brief Add a named vertex to a graph.
+   *
+   * \param name The vertex name, which need not be NUL-terminated.
+   * \param length The length of the name in bytes.
+   * \param timestamp The new vertex timestamp.
+   *
+   * \return The index of the new vertex, or NO_VERTEX with errno set
+   * to EEXIST if the name is taken, or to EINVAL if the graph has
+   * unnamed vertices or already has MAX_VCOUNT vertices.
+   */
+  vertex_index_t add_vertex(const char *name, size_t length, timestamp_t timestamp) {
+    if (names.size() != get_vcount() || get_vcount() >= MAX_VCOUNT) {
+      errno = EINVAL;
+      return NO_VERTEX;
+    }
+    if (!names.add(name, length))
+      return NO_VERTEX;
+    return add_vertex(timestamp);
+  }
+
+  /**
+   * \function name_vertex
+   * \brief Name the first unnamed vertex.
+   *
+   * \param name The vertex name, which need not be NUL-terminated.
+   * \param length The length of the name in bytes.
+   *
+   * This allows naming the vertices of a graph loaded from a file
+   * saved without names.
+   *
+   * \return True on success, false with errno set to EEXIST if the
+   * name is taken, or to EINVAL if all vertices are already named.
+   */
+  bool name_vertex(const char *name, size_t length) {
+    if (names.size() >= get_vcount()) {
+      errno = EINVAL;
+      return false;
+    }
+    return names.add(name, length);
+  }
+
+  /**
+   * \function add_vertices
+   * \brief Add many vertices to a graph.
+   *
+   * \param timestamps The timestamps of the new vertices.
+   * \param n The number of vertices to add.
+   *
+   * \return The index of the first added vertex, or NO_VERTEX with
+   * errno set to EINVAL, and no vertex added, if the graph would have
+   * more than MAX_VCOUNT vertices.
+   */
+  vertex_index_t add_vertices(const timestamp_t *timestamps, size_t n) {
+    if (n > MAX_VCOUNT - get_vcount()) {
+      errno = EINVAL;
+      return NO_VERTEX;
+    }
+    vertex_index_t first = get_vcount();
+
+    for (size_t i = 0; i < n; i++)
+      vs.create(timestamps[i]);
+    if (n)
+      prepared = false;
+    return first;
+  }
+
+  /**
+   * \function add_edges
+   * \brief Add many edges, specified through vertex indices, to a graph.
+   *
+   * \param sources The indices of the edges' source vertices.
+   * \param targets The indices of the edges' target vertices.
+   * \param n The number of edges to add.
+   *
+   * The degree increase of each vertex is counted in a first pass,
+   * so that each vertex's edge storage is allocated only once.
+   *
+   * \return False if an index is out of range or a source vertex
+   * belongs to the frozen graph, in which case no edge is added.
+   */
+  bool add_edges(const int64_t *sources, const int64_t *targets, size_t n) {
+    size_t base = frozen.get_vcount();
+    size_t vcount = get_vcount();
+
+    for (size_t i = 0; i < n; i++)
+      if (sources[i] < int64_t(base) || size_t(sources[i]) >= vcount
+          || targets[i] < 0 || size_t(targets[i]) >= vcount)
+        return false;
+
+    std::vector<uint32_t> extra_in(vs.size(), 0), extra_out(vs.size(), 0);
+    for (size_t i = 0; i < n; i++) {
+      extra_out[sources[i] - base]++;
+      if (size_t(targets[i]) >= base)
+        extra_in[targets[i] - base]++;
+    }
+    for (size_t i = 0; i < vs.size(); i++)
+      if (extra_in[i] || extra_out[i])
+        vs[i].reserve_edges(extra_in[i], extra_out[i], edge_pool);
+
+    for (size_t i = 0; i < n; i++)
+      add_edge(sources[i], targets[i]);
+    return true;
+  }
+
+  /**
+   * \function add_edge
+   * \brief Add a edge to a graph.
+   *
+   * \param source The source vertex index, which must not belong
+   * to the frozen graph.
+   * \param target The target vertex index.
+   *
+   * Adges must be added only once.
+   */
+  void add_edge(vertex_index_t source, vertex_index_t target) {
+    added(source).out_edges.push_back(target, edge_pool);
+    if (target >= frozen.get_vcount())
+      added(target).in_edges.push_back(source, edge_pool);
+    prepared = false;
+  }
+};
+
+/*
+ * A view of an adjacency list of a CompressedGraph. Its vertex indices
+ * are coded as gaps in blocks of CODEC_BLOCK_SIZE, preceded by a skip
+ * table holding the first index and byte position of every block but
+ * the first, so that any block can be decoded on its own. Out lists
+ * are sorted by index. In lists, ordered by their source's timestamp,
+ * are not, so their gaps are signed and zigzag-coded; their skip table
+ * also holds the timestamp of each block's first source, so that the
+ * blocks of a time window are found without looking up timestamps.
+ */
+class CompressedList {
+private:
+  const uint8_t *skips;		// Skip table entries; see skip_entry_size
+  const uint8_t *blocks;	// The coded blocks
+  size_t n;			// Number of vertex indices
+  bool timed;			// An in list, with signed gaps and block timestamps
+
+  const uint8_t *skip_entry(size_t k) const {
+    return skips + (k - 1) * skip_entry_size(timed);
+  }
+
+public:
+  // Bytes of a skip table entry: a block's first index and timestamp, if timed, and position
+  static size_t skip_entry_size(bool timed) {
+    return sizeof(vertex_index_t) + (timed ? sizeof(timestamp_t) : 0) + sizeof(uint32_t);
+  }
+
+  CompressedList(const uint8_t *s, const uint8_t *b, size_t count, bool t)
+    : skips(s), blocks(b), n(count), timed(t) {}
+
+  size_t size() const { return n; }
+  size_t block_count() const { return (n + CODEC_BLOCK_SIZE - 1) / CODEC_BLOCK_SIZE; }
+
+  size_t block_size(size_t k) const {
+    return std::min(CODEC_BLOCK_SIZE, n - k * CODEC_BLOCK_SIZE);
+  }
+
+  // Return the first vertex index of block k, which must be after the first
+  vertex_index_t block_first(size_t k) const {
+    vertex_index_t first;
+    memcpy(&first, skip_entry(k), sizeof(first));
+    return first;
+  }
+
+  // Return the first timestamp of block k of an in list, which must be after the first
+  timestamp_t block_first_timestamp(size_t k) const {
+    timestamp_t first;
+    memcpy(&first, skip_entry(k) + sizeof(vertex_index_t), sizeof(first));
+    return first;
+  }
+
+  /*
+   * Decode into out the block_size(k) vertex indices of block k,
+   * returning their number.
+   */
+  size_t decode(size_t k, vertex_index_t *out) const {
+    size_t m = block_size(k);
+    const uint8_t *p = blocks;
+    vertex_index_t previous = 0;
+    size_t i = 0;
+
+    if (k > 0) {
+      uint32_t position;
+      memcpy(&position, skip_entry(k) + skip_entry_size(timed) - sizeof(position),
+          sizeof(position));
+      p += position;
+      previous = out[i++] = block_first(k);
+    }
+    decode_block(p, m - i, out + i);
+    if (timed)
+      for (; i < m; i++)
+        previous = out[i] = previous + ((out[i] >> 1) ^ (vertex_index_t(0) - (out[i] & 1)));
+    else
+      for (; i < m; i++)
+        previous = out[i] = previous + out[i];
+    return m;
+  }
+};
+
+/*
+ * A prepared graph whose adjacency lists are held in compressed form,
+ * taking a fraction of the memory of the FrozenGraph arrays, at the
+ * cost of decoding the lists as they are traversed.
+ * The graph is read-only; its indices are computed through the
+ * cdindex, iindex, and cdindex_batch overloads taking it.
+ */
+class CompressedGraph {
+private:
+  std::vector<timestamp_t> timestamps;
+  // Byte positions of each vertex's list in the data, followed by their end
+  std::vector<uint64_t> out_offsets;
+  std::vector<uint64_t> in_offsets;
+  std::vector<uint8_t> out_data;
+  std::vector<uint8_t> in_data;
+  size_t ecount;
+
+  // Return the list coded in data at the specified position
+  static CompressedList list(const std::vector<uint8_t> &data, uint64_t position, bool timed) {
+    const uint8_t *p = data.data() + position;
+    size_t n = 0;
+    for (int shift = 0; ; shift += 7) {
+      n |= size_t(*p & 0x7f) << shift;
+      if (!(*p++ & 0x80))
+        break;
+    }
+    size_t blocks = (n + CODEC_BLOCK_SIZE - 1) / CODEC_BLOCK_SIZE;
+    size_t skips = blocks > 1 ? (blocks - 1) * CompressedList::skip_entry_size(timed) : 0;
+    return CompressedList(p, p + skips, n, timed);
+  }
+
+public:
+  CompressedGraph() : ecount(0) {}
+
+  void build(const Graph &g, unsigned nthreads);
+  bool load(const GraphFile &file, unsigned nthreads);
+
+  size_t get_vcount() const { return timestamps.size(); }
+  size_t get_ecount() const { return ecount; }
+
+  // Return the number of bytes taken by the graph
+  size_t get_size() const {
+    return timestamps.size() * sizeof(timestamp_t)
+      + (out_offsets.size() + in_offsets.size()) * sizeof(uint64_t)
+      + out_data.size() + in_data.size();
+  }
+
+  timestamp_t get_timestamp(vertex_index_t v) const { return timestamps[v]; }
+
+  // Return the out edges of v, sorted by target index
+  CompressedList get_out_edges(vertex_index_t v) const {
+    return list(out_data, out_offsets[v], false);
+  }
+
+  // Return the in edges of v, ordered by their source's timestamp
+  CompressedList get_in_edges(vertex_index_t v) const {
+    return list(in_data, in_offsets[v], true);
+  }
+
+  /*
+   * Hint that the offset of the out or in edges of v, or the edges
+   * themselves, will soon be read, so that the cache misses of
+   * traversing many lists overlap rather than stall their decoding.
    */
-  vertex_id_t add_vertex(timestamp_t timestamp) {
-    Vertex *v = new Vertex(timestamp);
-    vs.push_back(v);
-    return make_vertex_id(v);
+  void prefetch_out_offset(vertex_index_t v) const { __builtin_prefetch(&out_offsets[v]); }
+  void prefetch_in_offset(vertex_index_t v) const { __builtin_prefetch(&in_offsets[v]); }
+  void prefetch_out_edges(vertex_index_t v) const { __builtin_prefetch(&out_data[out_offsets[v]]); }
+  void prefetch_in_edges(vertex_index_t v) const { __builtin_prefetch(&in_data[in_offsets[v]]); }
+
+  size_t get_out_degree(vertex_index_t v) const { return get_out_edges(v).size(); }
+  size_t get_in_degree(vertex_index_t v) const { return get_in_edges(v).size(); }
+
+  bool has_out_edge(vertex_index_t v, vertex_index_t out) const;
+  size_t get_in_degree_until(vertex_index_t v, timestamp_t until) const;
+};
+
+/* Number of independently locked shards of a CiterCache */
+const size_t CITER_CACHE_SHARDS = 16;
+
+/* The use of a CiterCache */
+typedef struct {
+  uint64_t hits;		// Lists found in the cache
+  uint64_t misses;		// Lists decoded, and cached if they fit
+  uint64_t evictions;		// Lists evicted to make room for others
+  size_t entries;		// Lists cached
+  size_t bytes;			// Bytes taken by the cached lists
+} citer_cache_stats_t;
+
+/*
+ * A bounded cache of the decoded in edges of widely cited vertices of
+ * a CompressedGraph, shared by the threads computing its indices.
+ * Such a vertex is found in the neighborhood of many focal vertices,
+ * with windows differing by their focal vertex's timestamp. As the
+ * decoded list is ordered by timestamp, each window is then found by
+ * binary search, rather than by decoding its blocks and filtering
+ * their sources by timestamp again. Lists are spread by vertex over
+ * shards locked independently, each evicting its least recently used
+ * lists when they exceed its share of the byte budget. Lists larger
+ * than a shard's share are not cached.
+ */
+class CiterCache {
+public:
+  // The in edges of a vertex, which remain valid while held, even if evicted
+  typedef std::shared_ptr<const std::vector<vertex_index_t>> citers_t;
+
+private:
+  typedef struct {
+    vertex_index_t v;
+    citers_t citers;
+    size_t bytes;
+  } entry_t;
+
+  // Entries most recently used first, indexed by their vertex
+  struct alignas(64) Shard {
+    std::mutex lock;
+    std::list<entry_t> entries;
+    std::unordered_map<vertex_index_t, std::list<entry_t>::iterator> index;
+    size_t bytes = 0;
+    uint64_t hits = 0, misses = 0, evictions = 0;
+  };
+
+  std::unique_ptr<Shard[]> shards;
+  size_t capacity;		// Byte budget of each shard
+
+  Shard &shard(vertex_index_t v) const {
+    return shards[(uint64_t(v) * 0x9e3779b97f4a7c15ULL >> 32) % CITER_CACHE_SHARDS];
   }
+
+public:
+  CiterCache(size_t max_bytes)
+    : shards(new Shard[CITER_CACHE_SHARDS]), capacity(max_bytes / CITER_CACHE_SHARDS) {}
+
+  // Return the byte budget of the cache
+  size_t get_capacity() const { return capacity * CITER_CACHE_SHARDS; }
+
+  citers_t find(vertex_index_t v);
+  citers_t insert(vertex_index_t v, std::vector<vertex_index_t> &&citers);
+  void clear();
+  citer_cache_stats_t get_stats() const;
+};
+
+/* Methods for testing whether a citer cites any of the focal vertex's references */
+typedef enum {
+  INTERSECT_ADAPTIVE,		// Choose among the following by list sizes
+  INTERSECT_BINARY_SEARCH,	// Binary search of each citer reference
+  INTERSECT_MERGE,		// Linear merge of the two sorted lists
+  INTERSECT_GALLOP,		// Exponential search of the shorter list's elements
+  INTERSECT_BITMAP,		// Bitmap of the focal vertex's references
+  INTERSECT_SIMD,		// Blockwise SIMD merge, if supported by the CPU
+} intersection_kernel_t;
+
+/* Vertex orders that improve the locality of the computations; see Graph::relabel */
+typedef enum {
+  ORDER_TIMESTAMP,		// By timestamp, so that time windows span adjacent vertices
+  ORDER_RCM,			// Reverse Cuthill-McKee, a breadth-first order of the citation graph
+  ORDER_REFERENCES,		// Works grouped with others citing their most-cited reference
+} vertex_order_t;
+
+/* Orders in which batch computations process their focal vertices */
+typedef enum {
+  SCHEDULE_GIVEN,		// The order in which they are specified
+  SCHEDULE_TIMESTAMP,		// By timestamp, so that their time windows overlap
+} batch_schedule_t;
+
+/* The indices computed for a focal vertex by a batch computation */
+typedef struct {
+  double cdindex;
+  double mcdindex;
+  size_t iindex;
+} index_values_t;
+
+/*
+ * A CD index estimated from a sample of a focal vertex's "it" vertices,
+ * with the bounds of its 95% confidence interval. Values computed
+ * exactly, because the vertex's neighborhood fits within the sampling
+ * budget, have bounds equal to the value.
+ */
+typedef struct {
+  double cdindex;
+  double low;
+  double high;
+  bool exact;
+} cdindex_estimate_t;
+
+/*
+ * The "it" vertices of a focal vertex, counted by what they cite.
+ * The CD index is (f_only - f_and_b) / (f_only + b_only + f_and_b).
+ */
+typedef struct {
+  vertex_index_t f_only;	// The focal vertex, but none of its references
+  vertex_index_t b_only;	// Some of its references, but not the focal vertex
+  vertex_index_t f_and_b;	// The focal vertex and some of its references
+} citer_counts_t;
+
+/* Return the CD index corresponding to the specified counts */
+inline double
+counts_cdindex(const citer_counts_t &c)
+{
+  return (double(c.f_only) - double(c.f_and_b)) / (double(c.f_only) + c.b_only + c.f_and_b);
+}
+
+/*
+ * Number of buckets of focal vertices by degree, and number of most
+ * expensive focal vertices, kept in the computation statistics
+ */
+const int STATS_DEGREE_BUCKETS = 64;
+const int STATS_TOP_COUNT = 10;
+
+/* A focal vertex and the time its CD index computation took */
+typedef struct {
+  vertex_index_t vertex;
+  uint64_t nanoseconds;
+} focal_cost_t;
+
+/*
+ * Statistics of the work done by the CD index computations, which are
+ * collected by each thread when the library is compiled with
+ * CDINDEX_STATS defined. Otherwise they cost nothing.
+ */
+typedef struct {
+  uint64_t focal_vertices;	// Focal vertices whose "it" vertices were classified
+  uint64_t citers_visited;	// Candidate "it" vertices found in the time windows
+  uint64_t window_rejects;	// Citers outside the windows, skipped through binary search
+  uint64_t it_vertices;		// Distinct "it" vertices, inserted in the visited set
+  uint64_t out_edge_probes;	// Searches for the focal vertex among a citer's references
+  uint64_t intersections;	// Intersections of a citer's references with the focal vertex's
+  uint64_t intersections_short_circuited;	// Intersections ending at a common reference
+  // Focal vertices and their computation time by floor(log2(in + out degree + 1))
+  uint64_t degree_vertices[STATS_DEGREE_BUCKETS];
+  uint64_t degree_nanoseconds[STATS_DEGREE_BUCKETS];
+  // The most expensive focal vertices, most expensive first
+  focal_cost_t top[STATS_TOP_COUNT];
+  int top_count;
+} cdindex_stats_t;
+
+/*
+ * Maintain the citer counts, and thereby the CD index, of all vertices
+ * of a graph for a fixed time window, as vertices citing earlier ones
+ * are added to the graph. After the graph is prepared again, update
+ * takes time proportional to the added vertices' neighborhoods rather
+ * than to the whole graph.
+ */
+class CDIndexTracker {
+private:
+  timestamp_t time_delta;
+  // Citer counts of each vertex, for the vertices already accounted for
+  std::vector<citer_counts_t> counts;
+
+public:
+  CDIndexTracker(timestamp_t delta) : time_delta(delta) {}
+
+  timestamp_t get_time_delta() const { return time_delta; }
+
+  // Return the number of vertices accounted for
+  size_t get_vcount() const { return counts.size(); }
+
+  const citer_counts_t &get_counts(vertex_index_t v) const { return counts[v]; }
+
+  std::vector<vertex_index_t> update(const Graph &g, unsigned nthreads);
+  index_values_t get_values(const Graph &g, vertex_index_t v) const;
 };
 
+/* The size of the neighborhood loaded by cdindex_shard */
+typedef struct {
+  size_t vertices;
+  size_t edges;
+  uint64_t bytes_read;
+} shard_info_t;
+
 /* function prototypes for cdindex.c */
-double cdindex(vertex_id_t id, timestamp_t time_delta);
-double mcdindex(vertex_id_t id, timestamp_t time_delta);
-size_t iindex(vertex_id_t id, timestamp_t time_delta);
+void set_intersection_kernel(intersection_kernel_t kernel);
+void set_batch_schedule(batch_schedule_t schedule);
+bool get_stats(cdindex_stats_t &stats);
+void reset_stats();
+std::vector<vertex_index_t> locality_order(const Graph &g, vertex_order_t order);
+double cdindex(const Graph &g, vertex_index_t v, timestamp_t time_delta);
+double cdindex(const Graph &g, vertex_index_t v, timestamp_t time_delta,
+    ScratchContext &scratch);
+double mcdindex(const Graph &g, vertex_index_t v, timestamp_t time_delta);
+size_t iindex(const Graph &g, vertex_index_t v, timestamp_t time_delta);
+void cdindex_windows(const Graph &g, vertex_index_t focal,
+    const timestamp_t *time_deltas, size_t k, index_values_t *out,
+    ScratchContext &scratch);
+void cdindex_batch(const Graph &g, const vertex_index_t *focal, size_t n,
+    timestamp_t time_delta, index_values_t *out, unsigned nthreads);
+void cdindex_all(const Graph &g, timestamp_t time_delta, index_values_t *out,
+    unsigned nthreads);
+void cdindex_sweep(const Graph &g, timestamp_t time_delta, index_values_t *out,
+    unsigned nthreads);
+double cdindex(const CompressedGraph &g, vertex_index_t v, timestamp_t time_delta,
+    ScratchContext &scratch, CiterCache *cache = NULL);
+size_t iindex(const CompressedGraph &g, vertex_index_t v, timestamp_t time_delta);
+void cdindex_batch(const CompressedGraph &g, const vertex_index_t *focal, size_t n,
+    timestamp_t time_delta, index_values_t *out, unsigned nthreads,
+    CiterCache *cache = NULL);
+cdindex_estimate_t cdindex_approximate(const Graph &g, vertex_index_t v,
+    timestamp_t time_delta, size_t budget, ScratchContext &scratch, uint64_t seed = 0);
+void cdindex_approximate_batch(const Graph &g, const vertex_index_t *focal, size_t n,
+    timestamp_t time_delta, size_t budget, cdindex_estimate_t *out, unsigned nthreads,
+    uint64_t seed = 0);
+
+/* function prototypes for shard.cpp */
+bool cdindex_shard(const GraphFile &file, vertex_index_t begin, vertex_index_t end,
+    timestamp_t time_delta, index_values_t *out, unsigned nthreads,
+    shard_info_t *info = NULL);
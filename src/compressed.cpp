@@ -0,0 +1,406 @@
+/*
+  fast-cdindex library.
+  Copyright (C) 2017 Russell J. Funk <russellfunk@gmail.com>
+  Copyright (C) 2023 Diomidis Spinellis <dds@aueb.gr>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Construction and searching of graphs with compressed adjacency lists,
+ * and the caching of their decoded in edges.
+ */
+
+#include <atomic>
+
+#include "cdindex.h"
+#include "parallel.h"
+
+/* Number of vertices whose lists are read from a graph file at a time */
+const size_t LOAD_CHUNK_SIZE = 1 << 16;
+
+/*
+ * Code the n vertex indices of an adjacency list into out, or only
+ * measure their coding if out is NULL. The list is coded as its
+ * length in LEB128 form, followed by its skip table and its blocks;
+ * see CompressedList. For in lists, vertex_timestamps holds the
+ * timestamps of all vertices, for the skip table; it is NULL for out
+ * lists. Block positions in the skip table take 32 bits, limiting a
+ * single list's coding to 4GB.
+ *
+ * Return the number of bytes of the coding.
+ */
+static size_t
+encode_list(const vertex_index_t *v, size_t n, const timestamp_t *vertex_timestamps,
+    uint8_t *out)
+{
+  const int bits = 8 * sizeof(vertex_index_t);
+  const bool timed = vertex_timestamps != NULL;
+  const size_t entry_size = CompressedList::skip_entry_size(timed);
+  size_t size = 0;
+
+  for (size_t c = n; ; ) {
+    uint8_t b = c & 0x7f;
+    c >>= 7;
+    if (out)
+      out[size] = c ? b | 0x80 : b;
+    size++;
+    if (!c)
+      break;
+  }
+
+  size_t blocks = (n + CODEC_BLOCK_SIZE - 1) / CODEC_BLOCK_SIZE;
+  uint8_t *skips = out ? out + size : NULL;
+  if (blocks > 1)
+    size += (blocks - 1) * entry_size;
+  size_t data_start = size;
+
+  vertex_index_t gaps[CODEC_BLOCK_SIZE];
+  for (size_t k = 0; k < blocks; k++) {
+    size_t first = k * CODEC_BLOCK_SIZE;
+    size_t m = std::min(CODEC_BLOCK_SIZE, n - first);
+    vertex_index_t previous = 0;
+    size_t i = 0;
+    if (k > 0) {
+      previous = v[first];
+      i = 1;
+      if (skips) {
+        uint32_t position = size - data_start;
+        uint8_t *entry = skips + (k - 1) * entry_size;
+        memcpy(entry, &previous, sizeof(previous));
+        if (timed)
+          memcpy(entry + sizeof(previous), &vertex_timestamps[previous], sizeof(timestamp_t));
+        memcpy(entry + entry_size - sizeof(position), &position, sizeof(position));
+      }
+    }
+    size_t ngaps = 0;
+    for (; i < m; i++) {
+      vertex_index_t d = v[first + i] - previous;
+      gaps[ngaps++] = timed ? (d << 1) ^ (vertex_index_t(0) - (d >> (bits - 1))) : d;
+      previous = v[first + i];
+    }
+    if (out)
+      size = encode_block(gaps, ngaps, out + size) - out;
+    else
+      size += encoded_size(gaps, ngaps);
+  }
+  return size;
+}
+
+/*
+ * Set offsets to the positions of the lists whose coding takes the
+ * specified sizes, and allocate data to hold them.
+ */
+static void
+allocate_lists(std::vector<size_t> &sizes, std::vector<uint64_t> &offsets,
+    std::vector<uint8_t> &data, unsigned nthreads)
+{
+  parallel_prefix_sum(sizes, nthreads);
+  offsets.assign(sizes.begin(), sizes.end());
+  std::vector<size_t>().swap(sizes);
+  std::vector<uint8_t>(offsets.back() + CODEC_PADDING, 0).swap(data);
+}
+
+/**
+ * \function CompressedGraph::build
+ * \brief Compress the adjacency lists of a graph.
+ *
+ * \param g The graph, which must have been prepared for searching.
+ * \param nthreads Number of threads to use; 0 for all available cores.
+ */
+void
+CompressedGraph::build(const Graph &g, unsigned nthreads)
+{
+  const FrozenGraph &fg = g.get_frozen();
+  size_t n = fg.get_vcount();
+  std::vector<size_t> out_sizes(n + 1, 0), in_sizes(n + 1, 0);
+
+  timestamps.resize(n);
+  parallel_for(n, nthreads, [&](size_t v) { timestamps[v] = fg.get_timestamp(v); });
+  parallel_for(n, nthreads, [&](size_t v) {
+    EdgeList out(fg.get_out_edges(v)), in(fg.get_in_edges(v));
+    out_sizes[v] = encode_list(out.begin(), out.size(), NULL, NULL);
+    in_sizes[v] = encode_list(in.begin(), in.size(), timestamps.data(), NULL);
+  });
+  allocate_lists(out_sizes, out_offsets, out_data, nthreads);
+  allocate_lists(in_sizes, in_offsets, in_data, nthreads);
+  parallel_for(n, nthreads, [&](size_t v) {
+    EdgeList out(fg.get_out_edges(v)), in(fg.get_in_edges(v));
+    encode_list(out.begin(), out.size(), NULL, out_data.data() + out_offsets[v]);
+    encode_list(in.begin(), in.size(), timestamps.data(), in_data.data() + in_offsets[v]);
+  });
+  ecount = g.get_ecount();
+}
+
+/*
+ * Call f(v, out, nout, in, nin) with the out and in edges of each
+ * vertex v in [begin, end) of a graph file, reading them a chunk of
+ * vertices at a time.
+ *
+ * Return true on success, false with errno set on a read error.
+ */
+template <typename F>
+static bool
+scan_lists(const GraphFile &file, size_t begin, size_t end, F f)
+{
+  std::vector<size_t> out_o, in_o;
+  std::vector<vertex_index_t> out_t, in_s;
+
+  for (size_t first = begin; first < end; first += LOAD_CHUNK_SIZE) {
+    size_t m = std::min(LOAD_CHUNK_SIZE, end - first);
+    out_o.resize(m + 1);
+    in_o.resize(m + 1);
+    if (!file.read(GRAPH_FILE_OUT_OFFSETS, first, m + 1, out_o.data())
+        || !file.read(GRAPH_FILE_IN_OFFSETS, first, m + 1, in_o.data()))
+      return false;
+    out_t.resize(out_o[m] - out_o[0]);
+    in_s.resize(in_o[m] - in_o[0]);
+    if (!file.read(GRAPH_FILE_OUT_TARGETS, out_o[0], out_t.size(), out_t.data())
+        || !file.read(GRAPH_FILE_IN_SOURCES, in_o[0], in_s.size(), in_s.data()))
+      return false;
+    for (size_t i = 0; i < m; i++)
+      if (!f(first + i, out_t.data() + (out_o[i] - out_o[0]), out_o[i + 1] - out_o[i],
+            in_s.data() + (in_o[i] - in_o[0]), in_o[i + 1] - in_o[i]))
+        return false;
+  }
+  return true;
+}
+
+/**
+ * \function CompressedGraph::load
+ * \brief Load the graph of a graph file, compressing its adjacency lists.
+ *
+ * \param file The graph file.
+ * \param nthreads Number of threads to use; 0 for all available cores.
+ *
+ * The lists are read twice, a chunk at a time, first to measure their
+ * coding and then to code them in place, so that the memory required
+ * is that of the compressed graph, rather than that of the file.
+ * Vertex names are not loaded.
+ *
+ * \return True on success, false with errno set on failure, to EINVAL
+ * if the file's edges are invalid.
+ */
+bool
+CompressedGraph::load(const GraphFile &file, unsigned nthreads)
+{
+  size_t n = file.get_vcount();
+  std::vector<size_t> out_sizes(n + 1, 0), in_sizes(n + 1, 0);
+  unsigned ranges = range_count(n, nthreads);
+  std::atomic<int> error(0);
+
+  timestamps.resize(n);
+  if (!file.read(GRAPH_FILE_TIMESTAMPS, 0, n, timestamps.data()))
+    return false;
+
+  // Measure the lists, verifying that they are ordered as in a FrozenGraph
+  parallel_ranges(n, ranges, [&](unsigned, size_t begin, size_t end) {
+    if (!scan_lists(file, begin, end, [&](size_t v, const vertex_index_t *out, size_t nout,
+            const vertex_index_t *in, size_t nin) {
+          for (size_t i = 0; i < nout; i++)
+            if (out[i] >= n || (i > 0 && out[i] <= out[i - 1])) {
+              errno = EINVAL;
+              return false;
+            }
+          for (size_t i = 0; i < nin; i++)
+            if (in[i] >= n || (i > 0 && timestamps[in[i]] < timestamps[in[i - 1]])) {
+              errno = EINVAL;
+              return false;
+            }
+          out_sizes[v] = encode_list(out, nout, NULL, NULL);
+          in_sizes[v] = encode_list(in, nin, timestamps.data(), NULL);
+          return true;
+        }))
+      error = errno;
+  });
+  if (error) {
+    errno = error;
+    return false;
+  }
+
+  allocate_lists(out_sizes, out_offsets, out_data, nthreads);
+  allocate_lists(in_sizes, in_offsets, in_data, nthreads);
+  std::atomic<size_t> edges(0);
+  parallel_ranges(n, ranges, [&](unsigned, size_t begin, size_t end) {
+    if (!scan_lists(file, begin, end, [&](size_t v, const vertex_index_t *out, size_t nout,
+            const vertex_index_t *in, size_t nin) {
+          encode_list(out, nout, NULL, out_data.data() + out_offsets[v]);
+          encode_list(in, nin, timestamps.data(), in_data.data() + in_offsets[v]);
+          edges += nout;
+          return true;
+        }))
+      error = errno;
+  });
+  if (error) {
+    errno = error;
+    return false;
+  }
+  ecount = edges;
+  return true;
+}
+
+/**
+ * \function CompressedGraph::has_out_edge
+ * \brief Return true if v has an edge to out, decoding a single block.
+ */
+bool
+CompressedGraph::has_out_edge(vertex_index_t v, vertex_index_t out) const
+{
+  CompressedList edges(get_out_edges(v));
+  size_t lo = 1, hi = edges.block_count();
+
+  if (hi == 0)
+    return false;
+  // Find the block after the last one starting at most at out
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (edges.block_first(mid) <= out)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  vertex_index_t block[CODEC_BLOCK_SIZE];
+  size_t m = edges.decode(lo - 1, block);
+  return std::binary_search(block, block + m, out);
+}
+
+/**
+ * \function CompressedGraph::get_in_degree_until
+ * \brief Return the number of in edges of v whose source has a timestamp up to until.
+ */
+size_t
+CompressedGraph::get_in_degree_until(vertex_index_t v, timestamp_t until) const
+{
+  CompressedList edges(get_in_edges(v));
+  size_t lo = 1, hi = edges.block_count();
+
+  if (hi == 0)
+    return 0;
+  // Find the first block starting after until; the previous one holds the boundary
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (edges.block_first_timestamp(mid) <= until)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  vertex_index_t block[CODEC_BLOCK_SIZE];
+  size_t m = edges.decode(lo - 1, block);
+  size_t count = 0;
+  while (count < m && timestamps[block[count]] <= until)
+    count++;
+  return (lo - 1) * CODEC_BLOCK_SIZE + count;
+}
+
+/**
+ * \function CiterCache::find
+ * \brief Return the cached in edges of v, or an empty pointer if they
+ * are not cached.
+ */
+CiterCache::citers_t
+CiterCache::find(vertex_index_t v)
+{
+  Shard &s = shard(v);
+  std::lock_guard<std::mutex> guard(s.lock);
+
+  auto i = s.index.find(v);
+  if (i == s.index.end()) {
+    s.misses++;
+    return citers_t();
+  }
+  s.hits++;
+  s.entries.splice(s.entries.begin(), s.entries, i->second);
+  return i->second->citers;
+}
+
+/**
+ * \function CiterCache::insert
+ * \brief Cache the in edges of v.
+ *
+ * \param v The cited vertex.
+ * \param citers Its decoded in edges, which are moved into the cache.
+ *
+ * Least recently used lists are evicted to make room for them;
+ * if they exceed the budget of their shard, they are not cached.
+ *
+ * \return The cached in edges, which are those already cached if
+ * another thread cached them first.
+ */
+CiterCache::citers_t
+CiterCache::insert(vertex_index_t v, std::vector<vertex_index_t> &&citers)
+{
+  // The vector, its entry, and the list, map, and reference count nodes
+  size_t bytes = citers.capacity() * sizeof(vertex_index_t) + sizeof(entry_t)
+    + sizeof(std::vector<vertex_index_t>) + 8 * sizeof(void *);
+  citers_t cached(std::make_shared<const std::vector<vertex_index_t>>(std::move(citers)));
+  if (bytes > capacity)
+    return cached;
+
+  Shard &s = shard(v);
+  std::lock_guard<std::mutex> guard(s.lock);
+  auto i = s.index.find(v);
+  if (i != s.index.end())
+    return i->second->citers;
+  while (s.bytes + bytes > capacity) {
+    s.index.erase(s.entries.back().v);
+    s.bytes -= s.entries.back().bytes;
+    s.entries.pop_back();
+    s.evictions++;
+  }
+  s.entries.push_front(entry_t{v, cached, bytes});
+  s.index.emplace(v, s.entries.begin());
+  s.bytes += bytes;
+  return cached;
+}
+
+/**
+ * \function CiterCache::clear
+ * \brief Evict all lists, as required before computing another graph,
+ * and reset the cache's statistics.
+ */
+void
+CiterCache::clear()
+{
+  for (size_t k = 0; k < CITER_CACHE_SHARDS; k++) {
+    Shard &s = shards[k];
+    std::lock_guard<std::mutex> guard(s.lock);
+    s.index.clear();
+    s.entries.clear();
+    s.bytes = 0;
+    s.hits = s.misses = s.evictions = 0;
+  }
+}
+
+/**
+ * \function CiterCache::get_stats
+ * \brief Return the use of the cache since its construction or clearing.
+ */
+citer_cache_stats_t
+CiterCache::get_stats() const
+{
+  citer_cache_stats_t stats = {0, 0, 0, 0, 0};
+
+  for (size_t k = 0; k < CITER_CACHE_SHARDS; k++) {
+    Shard &s = shards[k];
+    std::lock_guard<std::mutex> guard(s.lock);
+    stats.hits += s.hits;
+    stats.misses += s.misses;
+    stats.evictions += s.evictions;
+    stats.entries += s.entries.size();
+    stats.bytes += s.bytes;
+  }
+  return stats;
+}
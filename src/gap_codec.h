@@ -0,0 +1,202 @@
+/*
+  fast-cdindex library.
+  Copyright (C) 2017 Russell J. Funk <russellfunk@gmail.com>
+  Copyright (C) 2023 Diomidis Spinellis <dds@aueb.gr>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Coding of blocks of unsigned integers, such as the gaps between the
+ * vertex indices of an adjacency list, in the stream VByte format:
+ * control bytes holding the 2-bit length code of each integer, four
+ * per byte, followed by the integers' significant little-endian bytes.
+ * The lengths of 32-bit integers are 1 to 4 bytes, those of 64-bit
+ * ones 1, 2, 4, or 8. Decoding takes no branch per integer, and with
+ * SSSE3 decodes four 32-bit integers through a single shuffle.
+ * As decoding reads whole integers, CODEC_PADDING readable bytes must
+ * follow the encoded data.
+ */
+
+#ifndef GAP_CODEC_H
+#define GAP_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+/* Number of integers coded in a block */
+const size_t CODEC_BLOCK_SIZE = 64;
+
+/* Number of bytes that decoding can read beyond the end of the data */
+const size_t CODEC_PADDING = 16;
+
+/* Return the number of bytes of an integer of type T with the specified length code */
+template <typename T>
+inline size_t
+codec_length(unsigned code)
+{
+  return sizeof(T) == 4 ? code + 1 : size_t(1) << code;
+}
+
+/* Return the length code of the specified integer */
+inline int
+codec_code(uint32_t v)
+{
+  return (v >> 8 != 0) + (v >> 16 != 0) + (v >> 24 != 0);
+}
+
+inline int
+codec_code(uint64_t v)
+{
+  return (v >> 8 != 0) + (v >> 16 != 0) + (v >> 32 != 0);
+}
+
+/* Return the number of bytes taken by the coding of n integers */
+template <typename T>
+inline size_t
+encoded_size(const T *v, size_t n)
+{
+  size_t size = (n + 3) / 4;
+
+  for (size_t i = 0; i < n; i++)
+    size += codec_length<T>(codec_code(v[i]));
+  return size;
+}
+
+/* Code n integers into out, returning a pointer past their coding */
+template <typename T>
+inline uint8_t *
+encode_block(const T *v, size_t n, uint8_t *out)
+{
+  uint8_t *control = out;
+  uint8_t *data = out + (n + 3) / 4;
+
+  memset(control, 0, (n + 3) / 4);
+  for (size_t i = 0; i < n; i++) {
+    int code = codec_code(v[i]);
+    control[i / 4] |= code << (2 * (i % 4));
+    // Little-endian: the integer's low bytes come first
+    memcpy(data, &v[i], codec_length<T>(code));
+    data += codec_length<T>(code);
+  }
+  return data;
+}
+
+#if defined(__SSSE3__)
+/*
+ * Shuffle masks gathering the four 32-bit integers coded with each
+ * control byte, and the number of bytes these take
+ */
+struct codec_shuffles_t {
+  uint8_t masks[256][16];
+  uint8_t lengths[256];
+
+  codec_shuffles_t() {
+    for (int c = 0; c < 256; c++) {
+      int position = 0;
+      for (int i = 0; i < 4; i++) {
+        int length = ((c >> (2 * i)) & 3) + 1;
+        for (int b = 0; b < 4; b++)
+          masks[c][4 * i + b] = b < length ? position + b : 0x80;
+        position += length;
+      }
+      lengths[c] = position;
+    }
+  }
+};
+
+inline const codec_shuffles_t &
+codec_shuffles()
+{
+  static const codec_shuffles_t shuffles;
+  return shuffles;
+}
+#endif
+
+/* Return an integer read at data, keeping the bytes of the specified length code */
+template <typename T>
+inline T
+codec_value(const uint8_t *data, unsigned code)
+{
+  static const T masks[4] = {
+    T(0xff), T(0xffff),
+    sizeof(T) == 4 ? T(0xffffff) : T(0xffffffff),
+    T(~T(0))
+  };
+  T v;
+  memcpy(&v, data, sizeof(v));
+  return v & masks[code];
+}
+
+/* Decode n integers from in into out, returning a pointer past their coding */
+template <typename T>
+inline const uint8_t *
+decode_block(const uint8_t *in, size_t n, T *out)
+{
+  const uint8_t *control = in;
+  const uint8_t *data = in + (n + 3) / 4;
+  size_t i = 0;
+
+  // The positions of the four integers of a control byte depend only on it
+  for (; i + 4 <= n; i += 4) {
+    unsigned c = control[i / 4];
+    const uint8_t *d1 = data + codec_length<T>(c & 3);
+    const uint8_t *d2 = d1 + codec_length<T>((c >> 2) & 3);
+    const uint8_t *d3 = d2 + codec_length<T>((c >> 4) & 3);
+    out[i] = codec_value<T>(data, c & 3);
+    out[i + 1] = codec_value<T>(d1, (c >> 2) & 3);
+    out[i + 2] = codec_value<T>(d2, (c >> 4) & 3);
+    out[i + 3] = codec_value<T>(d3, c >> 6);
+    data = d3 + codec_length<T>(c >> 6);
+  }
+  for (; i < n; i++) {
+    unsigned code = (control[i / 4] >> (2 * (i % 4))) & 3;
+    out[i] = codec_value<T>(data, code);
+    data += codec_length<T>(code);
+  }
+  return data;
+}
+
+#if defined(__SSSE3__)
+template <>
+inline const uint8_t *
+decode_block(const uint8_t *in, size_t n, uint32_t *out)
+{
+  const codec_shuffles_t &shuffles = codec_shuffles();
+  const uint8_t *control = in;
+  const uint8_t *data = in + (n + 3) / 4;
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    uint8_t c = control[i / 4];
+    __m128i bytes = _mm_loadu_si128((const __m128i *)data);
+    __m128i mask = _mm_loadu_si128((const __m128i *)shuffles.masks[c]);
+    _mm_storeu_si128((__m128i *)(out + i), _mm_shuffle_epi8(bytes, mask));
+    data += shuffles.lengths[c];
+  }
+  for (; i < n; i++) {
+    unsigned code = (control[i / 4] >> (2 * (i % 4))) & 3;
+    out[i] = codec_value<uint32_t>(data, code);
+    data += codec_length<uint32_t>(code);
+  }
+  return data;
+}
+#endif
+
+#endif /* GAP_CODEC_H */
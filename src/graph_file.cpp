@@ -0,0 +1,449 @@
+/*
+  fast-cdindex library.
+  Copyright (C) 2017 Russell J. Funk <russellfunk@gmail.com>
+  Copyright (C) 2023 Diomidis Spinellis <dds@aueb.gr>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Binary graph file format.
+ *
+ * A file starts with a graph_file_header, followed by the frozen graph's
+ * arrays in the order timestamps, out offsets, out targets, in offsets,
+ * in sources, in timestamps, and then by the vertex name index arrays
+ * name offsets, name hash slots, and packed names, which are empty
+ * for graphs without names. Each array starts at an offset that is a multiple of 8,
+ * so that the file can be mapped and its arrays used in place.
+ * Values are stored in the native byte order, and vertex indices in
+ * the width of the build, both of which are recorded in the header.
+ * The checksum covers all bytes following the header.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cdindex.h"
+
+static const char GRAPH_FILE_MAGIC[8] = {'C', 'D', 'I', 'N', 'D', 'E', 'X', 'G'};
+static const uint32_t GRAPH_FILE_VERSION = 4;
+static const uint32_t GRAPH_FILE_BYTE_ORDER = 0x01020304;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t vcount;
+  uint64_t ecount;
+  uint64_t checksum;
+  uint32_t index_size;		// Size of a vertex index in bytes
+  uint32_t reserved;
+  uint64_t name_count;		// Number of named vertices
+  uint64_t name_slot_count;	// Number of name hash table slots
+  uint64_t name_bytes;		// Total length of the packed names
+} graph_file_header_t;
+
+static_assert(sizeof(size_t) == sizeof(uint64_t), "Offsets are stored as 64-bit values");
+
+/* Offsets of the arrays in a graph file with the specified dimensions */
+typedef struct {
+  uint64_t timestamps;
+  uint64_t out_offsets;
+  uint64_t out_targets;
+  uint64_t in_offsets;
+  uint64_t in_sources;
+  uint64_t in_timestamps;
+  uint64_t name_offsets;
+  uint64_t name_slots;
+  uint64_t name_chars;
+  uint64_t end;
+} graph_file_layout_t;
+
+static uint64_t
+align8(uint64_t n)
+{
+  return (n + 7) & ~uint64_t(7);
+}
+
+static graph_file_layout_t
+graph_file_layout(const graph_file_header_t &h)
+{
+  uint64_t vcount = h.vcount, ecount = h.ecount;
+  graph_file_layout_t l;
+
+  l.timestamps = align8(sizeof(graph_file_header_t));
+  l.out_offsets = align8(l.timestamps + vcount * sizeof(timestamp_t));
+  l.out_targets = align8(l.out_offsets + (vcount + 1) * sizeof(size_t));
+  l.in_offsets = align8(l.out_targets + ecount * sizeof(vertex_index_t));
+  l.in_sources = align8(l.in_offsets + (vcount + 1) * sizeof(size_t));
+  l.in_timestamps = align8(l.in_sources + ecount * sizeof(vertex_index_t));
+  l.name_offsets = align8(l.in_timestamps + ecount * sizeof(timestamp_t));
+  l.name_slots = align8(l.name_offsets + (h.name_count + 1) * sizeof(uint64_t));
+  l.name_chars = align8(l.name_slots + h.name_slot_count * sizeof(vertex_index_t));
+  l.end = align8(l.name_chars + h.name_bytes);
+  return l;
+}
+
+/*
+ * Return true if the header describes a graph file of the specified
+ * size that this build can read.
+ */
+static bool
+valid_header(const graph_file_header_t &h, uint64_t size)
+{
+  return memcmp(h.magic, GRAPH_FILE_MAGIC, sizeof(h.magic)) == 0
+    && h.version == GRAPH_FILE_VERSION
+    && h.byte_order == GRAPH_FILE_BYTE_ORDER
+    && h.index_size == sizeof(vertex_index_t)
+    && h.vcount <= MAX_VCOUNT
+    && h.name_count <= h.vcount
+    && !(h.name_slot_count & (h.name_slot_count - 1))
+    && !(h.name_count && h.name_slot_count <= h.name_count)
+    && graph_file_layout(h).end == size;
+}
+
+/*
+ * Incrementally compute a checksum over a sequence of 64-bit words.
+ * Four independent lanes are combined at the end, so that the
+ * computation is not limited by the latency of the multiplication.
+ */
+class Checksum {
+private:
+  uint64_t lane[4];
+  unsigned next;
+
+public:
+  Checksum() : next(0) {
+    lane[0] = 0xcbf29ce484222325ULL;
+    lane[1] = 0x84222325cbf29ce4ULL;
+    lane[2] = 0x9e3779b97f4a7c15ULL;
+    lane[3] = 0x7f4a7c159e3779b9ULL;
+  }
+
+  void add(const uint64_t *words, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      lane[next] = (lane[next] ^ words[i]) * 0x100000001b3ULL;
+      next = (next + 1) & 3;
+    }
+  }
+
+  uint64_t value() const {
+    uint64_t h = 0;
+    for (int i = 0; i < 4; i++)
+      h = (h ^ lane[i]) * 0x100000001b3ULL;
+    return h;
+  }
+};
+
+/*
+ * Write n bytes followed by zero padding up to a multiple of 8,
+ * adding them to the specified checksum.
+ */
+static bool
+write_padded(FILE *f, const void *data, size_t n, Checksum &sum)
+{
+  const size_t CHUNK = 1 << 20;
+  const char *p = (const char *)data;
+  size_t whole = n & ~size_t(7);
+
+  // Write in chunks so that checksumming proceeds from the cache
+  for (size_t done = 0; done < whole; done += CHUNK) {
+    size_t len = std::min(CHUNK, whole - done);
+    sum.add((const uint64_t *)(p + done), len / 8);
+    if (fwrite(p + done, 1, len, f) != len)
+      return false;
+  }
+
+  if (n != whole) {
+    uint64_t tail = 0;
+    memcpy(&tail, p + whole, n - whole);
+    sum.add(&tail, 1);
+    if (fwrite(&tail, 1, sizeof(tail), f) != sizeof(tail))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * \function save
+ * \brief Write the frozen graph to the specified file.
+ *
+ * \param path The name of the file to write.
+ * \param names The names of the graph's vertices.
+ *
+ * \return True on success, false with errno set on failure.
+ */
+bool
+FrozenGraph::save(const char *path, const NameIndex &names) const
+{
+  graph_file_header_t header;
+  Checksum sum;
+  FILE *f;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, GRAPH_FILE_MAGIC, sizeof(header.magic));
+  header.version = GRAPH_FILE_VERSION;
+  header.byte_order = GRAPH_FILE_BYTE_ORDER;
+  header.index_size = sizeof(vertex_index_t);
+  header.vcount = get_vcount();
+  header.ecount = get_ecount();
+  header.name_count = names.size();
+  header.name_slot_count = names.get_slot_count();
+  header.name_bytes = names.get_offsets()[names.size()];
+
+  if (!(f = fopen(path, "wb")))
+    return false;
+
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+    && write_padded(f, timestamps.data(), timestamps.size() * sizeof(timestamp_t), sum)
+    && write_padded(f, out_offsets.data(), out_offsets.size() * sizeof(size_t), sum)
+    && write_padded(f, out_targets.data(), out_targets.size() * sizeof(vertex_index_t), sum)
+    && write_padded(f, in_offsets.data(), in_offsets.size() * sizeof(size_t), sum)
+    && write_padded(f, in_sources.data(), in_sources.size() * sizeof(vertex_index_t), sum)
+    && write_padded(f, in_timestamps.data(), in_timestamps.size() * sizeof(timestamp_t), sum)
+    && write_padded(f, names.get_offsets(), (names.size() + 1) * sizeof(uint64_t), sum)
+    && write_padded(f, names.get_slots(), names.get_slot_count() * sizeof(vertex_index_t), sum)
+    && write_padded(f, names.get_chars(), header.name_bytes, sum);
+
+  // Rewrite the header with the now known checksum
+  header.checksum = sum.value();
+  ok = ok && fseek(f, 0, SEEK_SET) == 0
+    && fwrite(&header, sizeof(header), 1, f) == 1;
+
+  int saved_errno = errno;
+  if (fclose(f) != 0)
+    ok = false;
+  else if (!ok)
+    errno = saved_errno;
+  return ok;
+}
+
+/* Release the mapped graph file, if any */
+void
+FrozenGraph::unmap()
+{
+  if (mapping)
+    munmap(mapping, mapping_length);
+  mapping = NULL;
+  mapping_length = 0;
+}
+
+/**
+ * \function map
+ * \brief Map the frozen graph's arrays read-only from the specified file.
+ *
+ * \param path The name of the file to map.
+ * \param verify Whether to verify the file's checksum, which requires
+ *   reading all of it.
+ * \param names Set to view the names of the vertices stored in the file.
+ *
+ * Processes mapping the same file share a single copy of it in the
+ * page cache.
+ *
+ * \return True on success, false with errno set on failure.
+ * Files that are not graph files or were written by an incompatible
+ * version or build set errno to EINVAL; a checksum mismatch sets it to EIO.
+ */
+bool
+FrozenGraph::map(const char *path, bool verify, NameIndex &names)
+{
+  struct stat st;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY)) < 0)
+    return false;
+  if (fstat(fd, &st) < 0) {
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return false;
+  }
+  if (size_t(st.st_size) < sizeof(graph_file_header_t)) {
+    close(fd);
+    errno = EINVAL;
+    return false;
+  }
+
+  void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  int saved_errno = errno;
+  close(fd);
+  if (p == MAP_FAILED) {
+    errno = saved_errno;
+    return false;
+  }
+
+  const char *base = (const char *)p;
+  const graph_file_header_t *header = (const graph_file_header_t *)base;
+  graph_file_layout_t l = graph_file_layout(*header);
+  if (!valid_header(*header, st.st_size)) {
+    munmap(p, st.st_size);
+    errno = EINVAL;
+    return false;
+  }
+
+  if (verify) {
+    Checksum sum;
+    sum.add((const uint64_t *)(base + l.timestamps), (l.end - l.timestamps) / 8);
+    if (sum.value() != header->checksum) {
+      munmap(p, st.st_size);
+      errno = EIO;
+      return false;
+    }
+  }
+
+  // Guard edge accesses against offsets beyond the arrays
+  const size_t *out_o = (const size_t *)(base + l.out_offsets);
+  const size_t *in_o = (const size_t *)(base + l.in_offsets);
+  const uint64_t *name_o = (const uint64_t *)(base + l.name_offsets);
+  if (out_o[header->vcount] != header->ecount || in_o[header->vcount] != header->ecount
+      || name_o[header->name_count] != header->name_bytes) {
+    munmap(p, st.st_size);
+    errno = EINVAL;
+    return false;
+  }
+
+  unmap();
+  mapping = p;
+  mapping_length = st.st_size;
+  timestamps.view((const timestamp_t *)(base + l.timestamps), header->vcount);
+  out_offsets.view((const size_t *)(base + l.out_offsets), header->vcount + 1);
+  out_targets.view((const vertex_index_t *)(base + l.out_targets), header->ecount);
+  in_offsets.view((const size_t *)(base + l.in_offsets), header->vcount + 1);
+  in_sources.view((const vertex_index_t *)(base + l.in_sources), header->ecount);
+  in_timestamps.view((const timestamp_t *)(base + l.in_timestamps), header->ecount);
+  names.view(base + l.name_chars, name_o, header->name_count,
+      (const vertex_index_t *)(base + l.name_slots), header->name_slot_count);
+  return true;
+}
+
+/**
+ * \function GraphFile::open
+ * \brief Open the specified graph file for reading its arrays.
+ *
+ * \param path The name of the file, written by FrozenGraph::save.
+ *
+ * The checksum is not verified, as this would require reading all
+ * of the file.
+ *
+ * \return True on success, false with errno set on failure.
+ * As with FrozenGraph::map, files that are not graph files or were
+ * written by an incompatible version or build set errno to EINVAL.
+ */
+bool
+GraphFile::open(const char *path)
+{
+  graph_file_header_t header;
+  struct stat st;
+
+  close();
+  if ((fd = ::open(path, O_RDONLY)) < 0)
+    return false;
+  if (fstat(fd, &st) < 0) {
+    int saved_errno = errno;
+    close();
+    errno = saved_errno;
+    return false;
+  }
+  if (size_t(st.st_size) < sizeof(header)
+      || pread(fd, &header, sizeof(header), 0) != sizeof(header)
+      || !valid_header(header, st.st_size)) {
+    close();
+    errno = EINVAL;
+    return false;
+  }
+
+  graph_file_layout_t l = graph_file_layout(header);
+  vcount = header.vcount;
+  name_count = header.name_count;
+  uint64_t offsets[GRAPH_FILE_ARRAYS] = {l.timestamps, l.out_offsets, l.out_targets,
+    l.in_offsets, l.in_sources, l.in_timestamps, l.name_offsets, l.name_slots, l.name_chars};
+  uint64_t lengths[GRAPH_FILE_ARRAYS] = {vcount, vcount + 1, header.ecount,
+    vcount + 1, header.ecount, header.ecount, name_count + 1, header.name_slot_count,
+    header.name_bytes};
+  std::copy(offsets, offsets + GRAPH_FILE_ARRAYS, offset);
+  std::copy(lengths, lengths + GRAPH_FILE_ARRAYS, length);
+
+  // Guard edge accesses against offsets beyond the arrays
+  uint64_t out_end, in_end, names_end;
+  if (!read(GRAPH_FILE_OUT_OFFSETS, vcount, 1, &out_end)
+      || !read(GRAPH_FILE_IN_OFFSETS, vcount, 1, &in_end)
+      || !read(GRAPH_FILE_NAME_OFFSETS, name_count, 1, &names_end)
+      || out_end != header.ecount || in_end != header.ecount
+      || names_end != header.name_bytes) {
+    close();
+    errno = EINVAL;
+    return false;
+  }
+  return true;
+}
+
+/* Close the graph file, if it is open */
+void
+GraphFile::close()
+{
+  if (fd >= 0)
+    ::close(fd);
+  fd = -1;
+  vcount = name_count = 0;
+  std::fill(length, length + GRAPH_FILE_ARRAYS, 0);
+}
+
+/**
+ * \function GraphFile::read
+ * \brief Read elements of one of the graph file's arrays.
+ *
+ * \param array The array to read.
+ * \param first The index of the first element to read.
+ * \param n The number of elements to read.
+ * \param data Where to store the elements.
+ *
+ * \return True on success, false with errno set on failure, to
+ * EINVAL if the elements lie beyond the end of the array.
+ */
+bool
+GraphFile::read(graph_file_array_t array, uint64_t first, uint64_t n, void *data) const
+{
+  static const size_t element_size[GRAPH_FILE_ARRAYS] = {sizeof(timestamp_t),
+    sizeof(size_t), sizeof(vertex_index_t), sizeof(size_t), sizeof(vertex_index_t),
+    sizeof(timestamp_t), sizeof(uint64_t), sizeof(vertex_index_t), 1};
+
+  if (first > length[array] || n > length[array] - first) {
+    errno = EINVAL;
+    return false;
+  }
+
+  char *p = (char *)data;
+  uint64_t position = offset[array] + first * element_size[array];
+  size_t remaining = n * element_size[array];
+  while (remaining) {
+    ssize_t got = pread(fd, p, remaining, position);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0) {
+      if (got == 0)
+        errno = EIO;
+      return false;
+    }
+    p += got;
+    position += got;
+    remaining -= got;
+  }
+  return true;
+}
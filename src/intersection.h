@@ -0,0 +1,159 @@
+/*
+  fast-cdindex library.
+  Copyright (C) 2017 Russell J. Funk <russellfunk@gmail.com>
+  Copyright (C) 2023 Diomidis Spinellis <dds@aueb.gr>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Kernels testing whether two sorted vertex index lists share an element.
+ * They are templates over the index type; the SIMD kernel is specialized
+ * for 32-bit indices and falls back to merging for other types.
+ */
+
+#ifndef INTERSECTION_H
+#define INTERSECTION_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Return true if an element of [a, a_end) is found through binary search
+ * in [b, b_end).
+ */
+template <typename T>
+inline bool
+intersects_binary_search(const T *a, const T *a_end, const T *b, const T *b_end)
+{
+  for (; a < a_end; a++)
+    if (std::binary_search(b, b_end, *a))
+      return true;
+  return false;
+}
+
+/*
+ * Return true if the two lists share an element, by merging them.
+ * Suitable for lists of similar size.
+ */
+template <typename T>
+inline bool
+intersects_merge(const T *a, const T *a_end, const T *b, const T *b_end)
+{
+  while (a < a_end && b < b_end) {
+    if (*a < *b)
+      a++;
+    else if (*b < *a)
+      b++;
+    else
+      return true;
+  }
+  return false;
+}
+
+/*
+ * Return true if the two lists share an element, by searching each
+ * element of the short list a in the long list b through exponential
+ * search from the position of the previous one.
+ * Suitable for lists of very different sizes.
+ */
+template <typename T>
+inline bool
+intersects_gallop(const T *a, const T *a_end, const T *b, const T *b_end)
+{
+  for (; a < a_end && b < b_end; a++) {
+    if (*b >= *a) {
+      if (*b == *a)
+        return true;
+      continue;
+    }
+
+    // Find a range (b + lo, b + hi] that must contain *a, if present
+    size_t lo = 0, hi = 1;
+    size_t n = b_end - b;
+    while (hi < n && b[hi] < *a) {
+      lo = hi;
+      hi *= 2;
+    }
+    b = std::lower_bound(b + lo + 1, b + std::min(hi + 1, n), *a);
+    if (b < b_end && *b == *a)
+      return true;
+  }
+  return false;
+}
+
+/*
+ * Return true if the two lists share an element, by merging them in
+ * blocks compared all-against-all with SIMD instructions, when these
+ * are available.
+ */
+template <typename T>
+inline bool
+intersects_simd(const T *a, const T *a_end, const T *b, const T *b_end)
+{
+  return intersects_merge(a, a_end, b, b_end);
+}
+
+inline bool
+intersects_simd(const uint32_t *a, const uint32_t *a_end,
+    const uint32_t *b, const uint32_t *b_end)
+{
+#if defined(__AVX2__)
+  const __m256i rotate = _mm256_set_epi32(0, 7, 6, 5, 4, 3, 2, 1);
+  while (a_end - a >= 8 && b_end - b >= 8) {
+    __m256i va = _mm256_loadu_si256((const __m256i *)a);
+    __m256i vb = _mm256_loadu_si256((const __m256i *)b);
+    __m256i eq = _mm256_cmpeq_epi32(va, vb);
+    for (int r = 1; r < 8; r++) {
+      vb = _mm256_permutevar8x32_epi32(vb, rotate);
+      eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(va, vb));
+    }
+    if (!_mm256_testz_si256(eq, eq))
+      return true;
+    uint32_t a_max = a[7], b_max = b[7];
+    if (a_max <= b_max)
+      a += 8;
+    if (b_max <= a_max)
+      b += 8;
+  }
+#elif defined(__SSE2__)
+  while (a_end - a >= 4 && b_end - b >= 4) {
+    __m128i va = _mm_loadu_si128((const __m128i *)a);
+    __m128i vb = _mm_loadu_si128((const __m128i *)b);
+    __m128i eq = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+          _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+        _mm_or_si128(
+          _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+          _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+    if (_mm_movemask_epi8(eq))
+      return true;
+    uint32_t a_max = a[3], b_max = b[3];
+    if (a_max <= b_max)
+      a += 4;
+    if (b_max <= a_max)
+      b += 4;
+  }
+#endif
+  return intersects_merge(a, a_end, b, b_end);
+}
+
+#endif /* INTERSECTION_H */
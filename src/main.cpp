@@ -17,74 +17,697 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+/*
+ * Compute the CD, mCD, and I indices of the vertices of a graph read
+ * from a vertex file and an edge file.
+ *
+ * In text form each vertex file line contains a vertex id and its
+ * timestamp, and each edge file line the ids of an edge's source and
+ * target vertices. Fields are separated by tabs, commas, or spaces.
+ * A first line not starting with a number, such as a header, and blank
+ * lines are ignored; any other line that cannot be parsed is an error.
+ * In binary form (-b) the files consist of pairs of native 64-bit
+ * integers with the same meaning.
+ *
+ * Results are written as tab-separated id, CD, mCD, and I index values,
+ * followed, for CD indices estimated through sampling (-a), by the
+ * bounds of their 95% confidence interval.
+ *
+ * Alternatively, the graph can be saved into a graph file (-w), whose
+ * vertices are then computed in shards read from it (-g), allowing
+ * the processing of graphs larger than the available memory, and its
+ * division into parts processed by independent processes (-p).
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
 
-#include <map>
-#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "cdindex.h"
 
+/* Number of focal vertices whose results are computed and output at a time */
+const size_t OUTPUT_BLOCK_SIZE = 1 << 16;
+
+/* Default number of focal vertices of each shard computed from a graph file */
+const size_t DEFAULT_SHARD_SIZE = 1 << 20;
+
+/* A pair of integers read from an input file */
+typedef std::pair<int64_t, int64_t> record_t;
+
+static const char *program_name;
+
+/* Report the printf-style formatted error and exit */
+static void
+fatal(const char *fmt, ...)
+{
+  va_list ap;
+
+  fprintf(stderr, "%s: ", program_name);
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+  exit(1);
+}
+
+/* A read-only memory mapping of an input file */
+class MappedFile {
+private:
+  const char *data;
+  size_t length;
+
+public:
+  MappedFile(const char *path) : data(NULL), length(0) {
+    struct stat st;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+      fatal("%s: %s", path, strerror(errno));
+    length = st.st_size;
+    if (length > 0) {
+      void *p = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED)
+        fatal("%s: %s", path, strerror(errno));
+      data = (const char *)p;
+    }
+    close(fd);
+  }
+
+  ~MappedFile() {
+    if (data)
+      munmap((void *)data, length);
+  }
+
+  const char *begin() const { return data; }
+  const char *end() const { return data + length; }
+  size_t size() const { return length; }
+};
+
+/*
+ * Parse an optionally signed decimal integer at p, storing it in n.
+ * Return a pointer past its end, or NULL if p does not point to a number
+ * or the number does not fit in 64 bits.
+ */
+static const char *
+parse_integer(const char *p, const char *end, int64_t *n)
+{
+  bool negative = false;
+
+  if (p < end && *p == '-') {
+    negative = true;
+    p++;
+  }
+  if (p == end || *p < '0' || *p > '9')
+    return NULL;
+
+  // Accumulate the magnitude, which may reach 2^63 for negative numbers
+  uint64_t limit = negative ? uint64_t(INT64_MAX) + 1 : INT64_MAX;
+  uint64_t v = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    unsigned digit = *p - '0';
+    if (v > (limit - digit) / 10)
+      return NULL;
+    v = v * 10 + digit;
+  }
+  *n = negative ? int64_t(0 - v) : int64_t(v);
+  return p;
+}
+
+/*
+ * Parse the lines in [p, end) containing one or two integer fields
+ * into the specified records, skipping blank lines.
+ * Return the start of the first line that cannot be parsed, or NULL
+ * if all were parsed.
+ */
+static const char *
+parse_text_lines(const char *p, const char *end, int fields,
+    std::vector<record_t> *records)
+{
+  for (; p < end; p++) {
+    const char *eol = (const char *)memchr(p, '\n', end - p);
+    if (!eol)
+      eol = end;
+
+    const char *q = p;
+    while (q < eol && isspace((unsigned char)*q))
+      q++;
+    if (q == eol) {
+      p = eol;
+      continue;
+    }
+
+    record_t r(0, 0);
+    q = parse_integer(p, eol, &r.first);
+    if (q && fields == 2) {
+      while (q < eol && (*q == '\t' || *q == ',' || *q == ' '))
+        q++;
+      q = parse_integer(q, eol, &r.second);
+    }
+    if (!q)
+      return p;
+    records->push_back(r);
+    p = eol;
+  }
+  return NULL;
+}
+
+/*
+ * Read the records of the specified file, with one or two integer
+ * fields per record, using the specified number of threads.
+ * A first line that does not start with a number is taken as a header
+ * and skipped; any other line that cannot be parsed is a fatal error.
+ */
+static std::vector<record_t>
+read_records(const char *path, int fields, bool binary, unsigned nthreads)
+{
+  MappedFile f(path);
+  std::vector<record_t> result;
+
+  if (binary) {
+    size_t record_size = fields * sizeof(int64_t);
+    if (f.size() % record_size)
+      fatal("%s: size is not a multiple of the record size", path);
+    size_t n = f.size() / record_size;
+    result.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      memcpy(&result[i].first, f.begin() + i * record_size, sizeof(int64_t));
+      if (fields == 2)
+        memcpy(&result[i].second, f.begin() + i * record_size + sizeof(int64_t), sizeof(int64_t));
+    }
+    return result;
+  }
+
+  // Skip the header, if any
+  const char *begin = f.begin();
+  if (begin < f.end() && *begin != '-' && (*begin < '0' || *begin > '9')) {
+    const char *eol = (const char *)memchr(begin, '\n', f.size());
+    begin = eol ? eol + 1 : f.end();
+  }
+
+  // Split the file into chunks at line boundaries, one per thread
+  std::vector<const char *> bounds(1, begin);
+  for (unsigned i = 1; i < nthreads; i++) {
+    const char *p = std::max(bounds.back(), f.begin() + f.size() / nthreads * i);
+    const char *eol = (const char *)memchr(p, '\n', f.end() - p);
+    bounds.push_back(eol ? eol + 1 : f.end());
+  }
+  bounds.push_back(f.end());
+
+  std::vector<std::vector<record_t>> parts(nthreads);
+  std::vector<const char *> errors(nthreads);
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < nthreads; i++)
+    workers.emplace_back([&, i]() {
+      errors[i] = parse_text_lines(bounds[i], bounds[i + 1], fields, &parts[i]);
+    });
+  for (auto &w : workers)
+    w.join();
+  for (auto error : errors)
+    if (error)
+      fatal("%s:%zu: expected %s in the range of 64-bit integers", path,
+          size_t(std::count(f.begin(), error, '\n') + 1),
+          fields == 2 ? "two numbers" : "a number");
+
+  size_t n = 0;
+  for (auto &part : parts)
+    n += part.size();
+  result.reserve(n);
+  for (auto &part : parts) {
+    result.insert(result.end(), part.begin(), part.end());
+    std::vector<record_t>().swap(part);
+  }
+  return result;
+}
+
+/*
+ * Map of external vertex ids to vertex indices, held as an array of
+ * (id, index) pairs ordered by id.
+ */
+class IdMap {
+private:
+  std::vector<std::pair<int64_t, vertex_index_t>> ids;
+
+public:
+  IdMap(const std::vector<record_t> &vertices) {
+    ids.reserve(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+      ids.push_back(std::make_pair(vertices[i].first, vertex_index_t(i)));
+    std::sort(ids.begin(), ids.end());
+    for (size_t i = 1; i < ids.size(); i++)
+      if (ids[i].first == ids[i - 1].first)
+        fatal("duplicate vertex id %lld", (long long)ids[i].first);
+  }
+
+  // Return the index of the specified id, or -1 if it is unknown
+  int64_t find(int64_t id) const {
+    auto p = std::lower_bound(ids.begin(), ids.end(),
+        std::make_pair(id, vertex_index_t(0)));
+    return p != ids.end() && p->first == id ? int64_t(p->second) : -1;
+  }
+};
+
+/*
+ * Map the external ids in the first or second field of the specified
+ * records to vertex indices using many threads.
+ */
+static std::vector<int64_t>
+map_ids(const IdMap &map, const std::vector<record_t> &records, bool second,
+    unsigned nthreads)
+{
+  std::vector<int64_t> out(records.size());
+  std::vector<std::thread> workers;
+  size_t n = records.size();
+
+  for (unsigned t = 0; t < nthreads; t++)
+    workers.emplace_back([&, t]() {
+      for (size_t i = n * t / nthreads; i < n * (t + 1) / nthreads; i++) {
+        int64_t id = second ? records[i].second : records[i].first;
+        if ((out[i] = map.find(id)) < 0)
+          fatal("unknown vertex id %lld", (long long)id);
+      }
+    });
+  for (auto &w : workers)
+    w.join();
+  return out;
+}
+
+/*
+ * Add the specified edges, given by external ids, to a builder, using
+ * each of its producers on a separate thread.
+ */
+static void
+add_edges(GraphBuilder &builder, const IdMap &map, const std::vector<record_t> &edges)
+{
+  unsigned nthreads = builder.get_producer_count();
+  std::vector<std::thread> workers;
+  size_t n = edges.size();
+
+  for (unsigned t = 0; t < nthreads; t++)
+    workers.emplace_back([&, t]() {
+      GraphBuilder::Producer &producer = builder.get_producer(t);
+      for (size_t i = n * t / nthreads; i < n * (t + 1) / nthreads; i++) {
+        int64_t source = map.find(edges[i].first);
+        int64_t target = map.find(edges[i].second);
+        if (source < 0 || target < 0)
+          fatal("unknown vertex id %lld",
+              (long long)(source < 0 ? edges[i].first : edges[i].second));
+        producer.add_edge(source, target);
+      }
+    });
+  for (auto &w : workers)
+    w.join();
+}
+
+/*
+ * Report on stderr the statistics of the computations, identifying
+ * the most expensive vertices by the specified external ids.
+ */
+static void
+report_stats(const std::vector<int64_t> &ids)
+{
+  cdindex_stats_t s;
+
+  get_stats(s);
+  fprintf(stderr, "Focal vertices: %llu\n"
+      "Citers visited: %llu\n"
+      "Citers rejected by time window: %llu\n"
+      "Distinct \"it\" vertices: %llu\n"
+      "Citer reference probes: %llu\n"
+      "Reference intersections: %llu (%llu short-circuited)\n",
+      (unsigned long long)s.focal_vertices, (unsigned long long)s.citers_visited,
+      (unsigned long long)s.window_rejects, (unsigned long long)s.it_vertices,
+      (unsigned long long)s.out_edge_probes, (unsigned long long)s.intersections,
+      (unsigned long long)s.intersections_short_circuited);
+  fprintf(stderr, "Degree\tVertices\tSeconds\n");
+  for (int i = 0; i < STATS_DEGREE_BUCKETS; i++)
+    if (s.degree_vertices[i])
+      fprintf(stderr, "%llu-%llu\t%llu\t%.6f\n", (1ULL << i) - 1, (2ULL << i) - 2,
+          (unsigned long long)s.degree_vertices[i], s.degree_nanoseconds[i] / 1e9);
+  fprintf(stderr, "Most expensive vertices\nId\tSeconds\n");
+  for (int i = 0; i < s.top_count; i++)
+    fprintf(stderr, "%lld\t%.6f\n", (long long)ids[s.top[i].vertex],
+        s.top[i].nanoseconds / 1e9);
+}
+
+/*
+ * Output the specified values of a vertex identified by name, followed
+ * by the confidence interval of the CD index if it was estimated
+ */
+static void
+print_values(FILE *out, const char *name, int length, const index_values_t &v,
+    const cdindex_estimate_t *estimate = NULL)
+{
+  if (std::isnan(v.cdindex))
+    fprintf(out, "%.*s\tnan\tnan\t%zu", length, name, v.iindex);
+  else
+    fprintf(out, "%.*s\t%.17g\t%.17g\t%zu", length, name, v.cdindex, v.mcdindex,
+        v.iindex);
+  if (!estimate)
+    fputc('\n', out);
+  else if (std::isnan(estimate->cdindex))
+    fprintf(out, "\tnan\tnan\n");
+  else
+    fprintf(out, "\t%.17g\t%.17g\n", estimate->low, estimate->high);
+}
+
+/*
+ * Compute and output the indices of the vertices of the specified part
+ * of a graph file, one shard at a time, or, if compressed is set,
+ * from the whole graph loaded with compressed adjacency lists, with
+ * a citer cache of cache_size bytes, if not zero, whose use is
+ * reported on stderr.
+ * Vertices are identified by their names, or by their index if the
+ * graph has no names.
+ */
+static void
+compute_graph_file(const char *path, int part, int parts, size_t shard_size,
+    bool compressed, size_t cache_size, timestamp_t time_delta, unsigned nthreads,
+    FILE *out)
+{
+  GraphFile file;
+  if (!file.open(path))
+    fatal("%s: %s", path, strerror(errno));
+  CompressedGraph cg;
+  if (compressed && !cg.load(file, nthreads))
+    fatal("%s: %s", path, strerror(errno));
+  std::unique_ptr<CiterCache> cache(cache_size ? new CiterCache(cache_size) : NULL);
+
+  size_t vcount = file.get_vcount();
+  bool named = file.get_name_count() == vcount;
+  size_t first = vcount * part / parts;
+  size_t last = vcount * (part + 1) / parts;
+  std::vector<index_values_t> values(std::min(shard_size, last - first));
+  std::vector<uint64_t> name_offsets;
+  std::vector<char> names;
+  std::vector<vertex_index_t> focal;
 
-int main() {
-
-  /* initialize graph components */
-  int VERTICES = 11;
-  int EDGES = 13;
-
-  /* dummy data */
-  timestamp_t raw_vertices_time[] = {694245600,
-                                       694245600,
-                                       725868000,
-                                       725868000,
-                                       788940000,
-                                       852098400,
-                                       883634400,
-                                       915170400,
-                                       915170400,
-                                       883634400,
-                                       852098400};
-  int raw_edges[13][2] = {{4,2},
-                          {4,0},
-                          {4,1},
-                          {4,3},
-                          {5,2},
-                          {6,2},
-                          {6,4},
-                          {7,4},
-                          {8,4},
-                          {9,4},
-                          {9,1},
-                          {9,3},
-                          {10,4}};
-
-  /* create an empty graph */
+  if (part == 0)
+    fprintf(out, "id\tcdindex\tmcdindex\tiindex\n");
+  for (size_t begin = first; begin < last; begin += shard_size) {
+    size_t n = std::min(shard_size, last - begin);
+    if (compressed) {
+      focal.resize(n);
+      for (size_t i = 0; i < n; i++)
+        focal[i] = begin + i;
+      cdindex_batch(cg, focal.data(), n, time_delta, values.data(), nthreads, cache.get());
+    } else if (!cdindex_shard(file, begin, begin + n, time_delta, values.data(), nthreads))
+      fatal("%s: %s", path, strerror(errno));
+    if (named) {
+      name_offsets.resize(n + 1);
+      if (!file.read(GRAPH_FILE_NAME_OFFSETS, begin, n + 1, name_offsets.data()))
+        fatal("%s: %s", path, strerror(errno));
+      names.resize(name_offsets[n] - name_offsets[0]);
+      if (!file.read(GRAPH_FILE_NAME_CHARS, name_offsets[0], names.size(), names.data()))
+        fatal("%s: %s", path, strerror(errno));
+    }
+    for (size_t i = 0; i < n; i++)
+      if (named)
+        print_values(out, names.data() + (name_offsets[i] - name_offsets[0]),
+            int(name_offsets[i + 1] - name_offsets[i]), values[i]);
+      else {
+        char index[32];
+        print_values(out, index, snprintf(index, sizeof(index), "%zu", begin + i),
+            values[i]);
+      }
+  }
+  if (cache) {
+    citer_cache_stats_t s = cache->get_stats();
+    fprintf(stderr, "Citer cache: %llu hits (%.1f%%), %llu misses, %llu evictions, "
+        "%zu lists in %.1f of %.1f MB\n",
+        (unsigned long long)s.hits,
+        s.hits + s.misses ? 100.0 * s.hits / (s.hits + s.misses) : 0.0,
+        (unsigned long long)s.misses, (unsigned long long)s.evictions,
+        s.entries, s.bytes / 1e6, cache->get_capacity() / 1e6);
+  }
+}
+
+static void
+usage()
+{
+  fprintf(stderr, "Usage: %s [-bct] [-a budget] [-d time-delta] [-j threads]\n"
+      "\t[-l placement] [-o output-file] [-r order] [-s subset-file] [-v]\n"
+      "\t[-w graph-file]\n"
+      "\tvertex-file edge-file\n"
+      "       %s [-cz] [-d time-delta] [-j threads] [-m cache-MB] [-n shard-size]\n"
+      "\t[-o output-file] [-p part/parts] -g graph-file\n"
+      "-a\tEstimate CD indices by examining at most budget citers of each vertex\n"
+      "-b\tRead binary files of 64-bit integer pairs\n"
+      "-c\tProcess the vertices in chronological order, for locality\n"
+      "-d\tTime beyond each vertex's timestamp to consider (default 157680000)\n"
+      "-g\tCompute the vertices of a graph file, a shard at a time\n"
+      "-j\tNumber of threads to use (default all cores)\n"
+      "-l\tPlace the graph on the NUMA nodes: local (default), interleave, or replicate\n"
+      "-m\tWith -z, cache widely cited vertices' decoded in edges in this many MB\n"
+      "-n\tNumber of vertices of each shard (default 1048576)\n"
+      "-o\tWrite results to the specified file rather than stdout\n"
+      "-p\tCompute only the specified part (from 0) of the graph file's vertices\n"
+      "-r\tReorder vertices in memory by timestamp, rcm, or references\n"
+      "-s\tCompute only the vertices whose ids are listed in the file\n"
+      "-t\tCompute all vertices in a single sweep of their citers by timestamp\n"
+      "-v\tReport statistics of the computations on stderr (requires make STATS=1)\n"
+      "-w\tSave the graph into the specified graph file, rather than computing it\n"
+      "-z\tLoad the whole graph file with compressed adjacency lists, rather than shards\n",
+      program_name, program_name);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  timestamp_t time_delta = 157680000;
+  unsigned nthreads = 0;
+  const char *subset_file = NULL;
+  const char *graph_file = NULL;
+  const char *save_file = NULL;
+  size_t shard_size = DEFAULT_SHARD_SIZE;
+  size_t budget = 0;
+  size_t cache_size = 0;
+  int part = 0, parts = 1;
+  bool binary = false;
+  bool reorder = false;
+  bool verbose = false;
+  bool compressed = false;
+  bool sweep = false;
+  vertex_order_t order_kind = ORDER_TIMESTAMP;
+  numa_placement_t placement = NUMA_LOCAL;
+  FILE *out = stdout;
+  char *end;
+  int c;
+
+  program_name = argv[0];
+  while ((c = getopt(argc, argv, "a:bcd:g:j:l:m:n:o:p:r:s:tvw:z")) != -1)
+    switch (c) {
+    case 'a':
+      if ((budget = strtoull(optarg, NULL, 10)) == 0)
+        usage();
+      break;
+    case 'b': binary = true; break;
+    case 'c': set_batch_schedule(SCHEDULE_TIMESTAMP); break;
+    case 'd':
+      time_delta = strtoll(optarg, &end, 10);
+      if (end == optarg || *end || time_delta < 0)
+        usage();
+      break;
+    case 'g': graph_file = optarg; break;
+    case 'j': {
+      long n = strtol(optarg, &end, 10);
+      if (end == optarg || *end || n < 0 || n > INT_MAX)
+        usage();
+      nthreads = n;
+      break;
+    }
+    case 'l':
+      if (strcmp(optarg, "local") == 0)
+        placement = NUMA_LOCAL;
+      else if (strcmp(optarg, "interleave") == 0)
+        placement = NUMA_INTERLEAVE;
+      else if (strcmp(optarg, "replicate") == 0)
+        placement = NUMA_REPLICATE;
+      else
+        usage();
+      break;
+    case 'm': {
+      double megabytes = strtod(optarg, &end);
+      if (end == optarg || *end || !(megabytes > 0) || megabytes > SIZE_MAX / 1e6
+          || (cache_size = megabytes * 1e6) == 0)
+        usage();
+      break;
+    }
+    case 'n':
+      if ((shard_size = strtoull(optarg, NULL, 10)) == 0)
+        usage();
+      break;
+    case 'o':
+      if (!(out = fopen(optarg, "w")))
+        fatal("%s: %s", optarg, strerror(errno));
+      break;
+    case 'p':
+      if (sscanf(optarg, "%d/%d", &part, &parts) != 2 || part < 0 || part >= parts)
+        usage();
+      break;
+    case 'r':
+      reorder = true;
+      if (strcmp(optarg, "timestamp") == 0)
+        order_kind = ORDER_TIMESTAMP;
+      else if (strcmp(optarg, "rcm") == 0)
+        order_kind = ORDER_RCM;
+      else if (strcmp(optarg, "references") == 0)
+        order_kind = ORDER_REFERENCES;
+      else
+        usage();
+      break;
+    case 's': subset_file = optarg; break;
+    case 't': sweep = true; break;
+    case 'v': verbose = true; break;
+    case 'w': save_file = optarg; break;
+    case 'z': compressed = true; break;
+    default: usage();
+    }
+  if (nthreads == 0)
+    nthreads = std::max(1u, std::thread::hardware_concurrency());
+  if (graph_file) {
+    if (argc != optind || binary || reorder || subset_file || verbose || save_file
+        || budget || sweep || placement != NUMA_LOCAL || (cache_size && !compressed))
+      usage();
+    compute_graph_file(graph_file, part, parts, shard_size, compressed, cache_size,
+        time_delta, nthreads, out);
+    if (fclose(out) != 0)
+      fatal("error writing output: %s", strerror(errno));
+    return 0;
+  }
+  if (argc - optind != 2 || compressed || cache_size
+      || (sweep && (subset_file || budget || verbose)))
+    usage();
+  if (verbose) {
+    cdindex_stats_t s;
+    if (!get_stats(s))
+      fatal("statistics are not collected; build with make STATS=1");
+  }
+
+  /* read the vertices and add them, in order, to a concurrent builder */
+  GraphBuilder builder(nthreads);
+  std::vector<record_t> vertices(read_records(argv[optind], 2, binary, nthreads));
+  if (vertices.size() > MAX_VCOUNT)
+    fatal("%s: more than %zu vertices", argv[optind], MAX_VCOUNT);
+  {
+    std::vector<timestamp_t> timestamps(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+      timestamps[i] = vertices[i].second;
+    builder.get_producer(0).add_vertices(timestamps.data(), timestamps.size());
+  }
+  IdMap id_map(vertices);
+
+  /* read the edges and add them from many threads */
+  {
+    std::vector<record_t> edges(read_records(argv[optind + 1], 2, binary, nthreads));
+    add_edges(builder, id_map, edges);
+  }
   Graph g;
+  if (!g.build(builder, nthreads))
+    fatal("building the graph: %s", strerror(errno));
 
-  /* add vertices to the graph */
-  std::map <int, vertex_id_t> i2v;
+  // Name the vertices by their ids, to identify them in a saved graph
+  if (save_file)
+    for (auto &v : vertices) {
+      char id[32];
+      if (!g.name_vertex(id, snprintf(id, sizeof(id), "%lld", (long long)v.first)))
+        fatal("vertex %lld: %s", (long long)v.first, strerror(errno));
+    }
 
-  for (int i = 0; i < VERTICES; i++) {
-    vertex_id_t id = g.add_vertex(raw_vertices_time[i]);
-    i2v[i] = id;
+  /*
+   * Optionally relabel the vertices for locality, keeping the
+   * mapping from each vertex's original index to its new one
+   */
+  std::vector<vertex_index_t> label;
+  if (reorder) {
+    std::vector<vertex_index_t> order(locality_order(g, order_kind));
+    g.relabel(order, nthreads);
+    label.resize(order.size());
+    for (size_t i = 0; i < order.size(); i++)
+      label[order[i]] = i;
   }
 
-  /* add edges to the graph */
-  for (int p = 0; p < EDGES; p++) {
-    vertex_id_t from = i2v[raw_edges[p][0]];
-    vertex_id_t to = i2v[raw_edges[p][1]];
-    add_edge(from, to);
+  if (save_file) {
+    if (!g.save(save_file))
+      fatal("%s: %s", save_file, strerror(errno));
+    return 0;
   }
 
-  g.prepare_for_searching();
+  if (placement != NUMA_LOCAL && !g.place(placement))
+    fatal("placing the graph on the NUMA nodes: %s", strerror(errno));
 
-  /* test and report sanity */
-    printf("Testing graph sanity: %s\n", g.is_sane() ? "PASS" : "FAIL");
+  /* determine the focal vertices, by their original index */
+  std::vector<vertex_index_t> focal;
+  if (subset_file) {
+    std::vector<record_t> subset(read_records(subset_file, 1, binary, nthreads));
+    std::vector<int64_t> indices(map_ids(id_map, subset, false, nthreads));
+    focal.assign(indices.begin(), indices.end());
+  } else {
+    focal.resize(vertices.size());
+    for (size_t i = 0; i < focal.size(); i++)
+      focal[i] = i;
+  }
+  std::vector<vertex_index_t> labeled(std::min(OUTPUT_BLOCK_SIZE, focal.size()));
 
-  /* compute cdindex measure */
-  printf("CD index: %f\n", cdindex(i2v[4], 157680000));
+  /* or compute them all at once */
+  std::vector<index_values_t> swept;
+  if (sweep) {
+    swept.resize(focal.size());
+    cdindex_sweep(g, time_delta, swept.data(), nthreads);
+  }
+
+  /* compute and output the results a block at a time */
+  std::vector<index_values_t> values(std::min(OUTPUT_BLOCK_SIZE, focal.size()));
+  std::vector<cdindex_estimate_t> estimates(budget ? values.size() : 0);
+  fprintf(out, budget ? "id\tcdindex\tmcdindex\tiindex\tcdindex_low\tcdindex_high\n"
+      : "id\tcdindex\tmcdindex\tiindex\n");
+  for (size_t begin = 0; begin < focal.size(); begin += OUTPUT_BLOCK_SIZE) {
+    size_t n = std::min(OUTPUT_BLOCK_SIZE, focal.size() - begin);
+    for (size_t i = 0; i < n; i++)
+      labeled[i] = label.empty() ? focal[begin + i] : label[focal[begin + i]];
+    if (budget) {
+      cdindex_approximate_batch(g, labeled.data(), n, time_delta, budget,
+          estimates.data(), nthreads);
+      for (size_t i = 0; i < n; i++) {
+        values[i].cdindex = estimates[i].cdindex;
+        values[i].iindex = iindex(g, labeled[i], time_delta);
+        values[i].mcdindex = values[i].cdindex * values[i].iindex;
+      }
+    } else if (sweep)
+      for (size_t i = 0; i < n; i++)
+        values[i] = swept[labeled[i]];
+    else
+      cdindex_batch(g, labeled.data(), n, time_delta, values.data(), nthreads);
+    for (size_t i = 0; i < n; i++) {
+      char id[32];
+      print_values(out, id, snprintf(id, sizeof(id), "%lld",
+            (long long)vertices[focal[begin + i]].first), values[i],
+          budget ? &estimates[i] : NULL);
+    }
+  }
 
-  /* compute mcdindex measure */
-  printf("mCD index: %f\n", mcdindex(i2v[4], 157680000));
+  if (fclose(out) != 0)
+    fatal("error writing output: %s", strerror(errno));
 
+  if (verbose) {
+    std::vector<int64_t> ids(vertices.size());
+    for (size_t i = 0; i < ids.size(); i++)
+      ids[label.empty() ? i : label[i]] = vertices[i].first;
+    report_stats(ids);
+  }
   return 0;
 }
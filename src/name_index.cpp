@@ -0,0 +1,213 @@
+/*
+  fast-cdindex library.
+  Copyright (C) 2017 Russell J. Funk <russellfunk@gmail.com>
+  Copyright (C) 2023 Diomidis Spinellis <dds@aueb.gr>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cdindex.h"
+
+/*
+ * Smallest number of hash table slots, and the maximum load factor
+ * as a fraction of them, above which the table is doubled.
+ */
+const size_t MIN_SLOT_COUNT = 16;
+const size_t MAX_LOAD_NUMERATOR = 3;
+const size_t MAX_LOAD_DENOMINATOR = 4;
+
+/**
+ * \function NameIndex::hash
+ * \brief Return the hash value of the specified name.
+ *
+ * The name is processed eight bytes at a time. The value is stored
+ * in graph files, through the slot each name occupies, so it must
+ * not change between versions of the file format.
+ */
+uint64_t
+NameIndex::hash(const char *name, size_t length)
+{
+  const uint64_t MULTIPLIER = 0x9e3779b97f4a7c15ULL;
+  uint64_t h = length * MULTIPLIER;
+  uint64_t word;
+
+  for (; length >= sizeof(word); name += sizeof(word), length -= sizeof(word)) {
+    memcpy(&word, name, sizeof(word));
+    h = (h ^ word) * MULTIPLIER;
+    h ^= h >> 29;
+  }
+  if (length) {
+    word = 0;
+    memcpy(&word, name, length);
+    h = (h ^ word) * MULTIPLIER;
+  }
+  h ^= h >> 32;
+  h *= 0xd6e8feb86659fd93ULL;
+  return h ^ (h >> 32);
+}
+
+/**
+ * \function NameIndex::find
+ * \brief Return the index of the specified name, or NO_VERTEX if it is absent.
+ */
+vertex_index_t
+NameIndex::find(const char *name, size_t length) const
+{
+  if (!slot_count)
+    return NO_VERTEX;
+
+  size_t mask = slot_count - 1;
+  for (size_t i = hash(name, length) & mask; slots[i] != NO_VERTEX; i = (i + 1) & mask)
+    if (equals(slots[i], name, length))
+      return slots[i];
+  return NO_VERTEX;
+}
+
+/* Create a hash table of n slots, a power of two, holding all names */
+void
+NameIndex::rehash(size_t n)
+{
+  size_t mask = n - 1;
+
+  std::vector<vertex_index_t>(n, NO_VERTEX).swap(owned_slots);
+  for (size_t v = 0; v < count; v++) {
+    size_t i = hash(get_name(v), get_length(v)) & mask;
+    while (owned_slots[i] != NO_VERTEX)
+      i = (i + 1) & mask;
+    owned_slots[i] = v;
+  }
+  slot_count = n;
+  slots = owned_slots.data();
+}
+
+/* Double the hash table, or create it, reinserting all names */
+void
+NameIndex::grow()
+{
+  rehash(std::max(MIN_SLOT_COUNT, 2 * slot_count));
+}
+
+/**
+ * \function NameIndex::add
+ * \brief Add a name, which gets the next index.
+ *
+ * \param name The name, which need not be NUL-terminated.
+ * \param length The length of the name in bytes.
+ *
+ * \return True on success, false with errno set to EEXIST if the
+ * name is already present.
+ */
+bool
+NameIndex::add(const char *name, size_t length)
+{
+  if (find(name, length) != NO_VERTEX) {
+    errno = EEXIST;
+    return false;
+  }
+
+  own();
+  if ((count + 1) * MAX_LOAD_DENOMINATOR > slot_count * MAX_LOAD_NUMERATOR)
+    grow();
+
+  size_t mask = slot_count - 1;
+  size_t i = hash(name, length) & mask;
+  while (owned_slots[i] != NO_VERTEX)
+    i = (i + 1) & mask;
+  owned_slots[i] = count;
+
+  owned_chars.insert(owned_chars.end(), name, name + length);
+  owned_offsets.push_back(owned_chars.size());
+  count++;
+  use_owned();
+  return true;
+}
+
+/**
+ * \function NameIndex::own
+ * \brief Copy mapped arrays into owned ones, so that they can be
+ * modified and outlive the mapping.
+ */
+void
+NameIndex::own()
+{
+  if (!mapped)
+    return;
+  owned_chars.assign(chars, chars + offsets[count]);
+  owned_offsets.assign(offsets, offsets + count + 1);
+  owned_slots.assign(slots, slots + slot_count);
+  use_owned();
+}
+
+/* Remove all names */
+void
+NameIndex::clear()
+{
+  std::vector<char>().swap(owned_chars);
+  std::vector<uint64_t>(1, 0).swap(owned_offsets);
+  std::vector<vertex_index_t>().swap(owned_slots);
+  count = slot_count = 0;
+  use_owned();
+}
+
+/**
+ * \function NameIndex::view
+ * \brief Use the specified externally-owned arrays, such as ones
+ * mapped from a graph file.
+ *
+ * \param c The packed names.
+ * \param o The n + 1 offsets of the names in c.
+ * \param n The number of names.
+ * \param s The hash table slots.
+ * \param ns The number of slots, a power of two larger than n, or
+ * zero if there are no names.
+ */
+void
+NameIndex::view(const char *c, const uint64_t *o, size_t n,
+    const vertex_index_t *s, size_t ns)
+{
+  clear();
+  chars = c;
+  offsets = o;
+  count = n;
+  slots = s;
+  slot_count = ns;
+  mapped = true;
+}
+
+/**
+ * \function NameIndex::reorder
+ * \brief Renumber the names.
+ *
+ * \param order The permutation to apply: name i becomes the one
+ * whose current index is order[i].
+ */
+void
+NameIndex::reorder(const vertex_index_t *order)
+{
+  if (!count)
+    return;
+
+  std::vector<char> c;
+  c.reserve(offsets[count]);
+  std::vector<uint64_t> o(1, 0);
+  o.reserve(count + 1);
+  for (size_t i = 0; i < count; i++) {
+    c.insert(c.end(), get_name(order[i]), get_name(order[i]) + get_length(order[i]));
+    o.push_back(c.size());
+  }
+  owned_chars.swap(c);
+  owned_offsets.swap(o);
+  use_owned();
+  rehash(slot_count);
+}
@@ -0,0 +1,328 @@
+/*
+  fast-cdindex library.
+  Copyright (C) 2017 Russell J. Funk <russellfunk@gmail.com>
+  Copyright (C) 2023 Diomidis Spinellis <dds@aueb.gr>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Placement of the frozen graph's arrays on the memory of the NUMA
+ * nodes of multi-socket machines, and pinning of the threads reading
+ * them to the nodes' CPUs. The nodes and their CPUs are read from
+ * sysfs, and memory policies are set through the mbind system call,
+ * so that no NUMA library is needed. On machines with a single node,
+ * or kernels without NUMA support, placement has no effect.
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "cdindex.h"
+
+/* Memory policy modes and flags of mbind(2), from <linux/mempolicy.h> */
+const int NUMA_MPOL_BIND = 2;
+const int NUMA_MPOL_INTERLEAVE = 3;
+const unsigned NUMA_MPOL_MF_MOVE = 1 << 1;
+
+/* The NUMA nodes having CPUs, by their kernel id, and their CPUs */
+typedef struct {
+  std::vector<int> nodes;
+  std::vector<std::vector<int>> cpus;
+} numa_topology_t;
+
+/*
+ * Return the numbers of a sysfs list such as "0-3,8,10-11",
+ * read from the specified file, or an empty vector if it is missing.
+ */
+static std::vector<int>
+read_list(const char *path)
+{
+  std::vector<int> result;
+  FILE *f = fopen(path, "r");
+
+  if (!f)
+    return result;
+  int first, last;
+  while (fscanf(f, "%d", &first) == 1) {
+    last = first;
+    int c = fgetc(f);
+    if (c == '-') {
+      if (fscanf(f, "%d", &last) != 1)
+        break;
+      c = fgetc(f);
+    }
+    for (int i = first; i <= last; i++)
+      result.push_back(i);
+    if (c != ',')
+      break;
+  }
+  fclose(f);
+  return result;
+}
+
+/* Return the machine's NUMA topology, read once */
+static const numa_topology_t &
+topology()
+{
+  static const numa_topology_t t = []() {
+    numa_topology_t t;
+    for (int node : read_list("/sys/devices/system/node/online")) {
+      char path[64];
+      snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+      std::vector<int> cpus(read_list(path));
+      if (cpus.empty())
+        continue;
+      t.nodes.push_back(node);
+      t.cpus.push_back(cpus);
+    }
+    // Without NUMA support all CPUs are on a single node
+    if (t.nodes.empty()) {
+      t.nodes.push_back(0);
+      t.cpus.push_back(std::vector<int>());
+    }
+    return t;
+  }();
+  return t;
+}
+
+/*
+ * Set the memory policy of the whole pages within the specified
+ * memory to mode, over the nodes with the specified indices,
+ * moving the pages already allocated.
+ */
+static bool
+set_policy(const void *addr, size_t length, int mode, const std::vector<unsigned> &nodes)
+{
+  const numa_topology_t &t = topology();
+  uintptr_t page = sysconf(_SC_PAGESIZE);
+  uintptr_t begin = ((uintptr_t)addr + page - 1) & ~(page - 1);
+  uintptr_t end = ((uintptr_t)addr + length) & ~(page - 1);
+
+  if (end <= begin)
+    return true;
+  int max_node = 0;
+  for (int node : t.nodes)
+    max_node = std::max(max_node, node);
+  const int bits = 8 * sizeof(unsigned long);
+  std::vector<unsigned long> mask(max_node / bits + 1, 0);
+  for (unsigned i : nodes)
+    mask[t.nodes[i] / bits] |= 1UL << (t.nodes[i] % bits);
+  // The kernel reads one bit less than the specified maximum
+  return syscall(SYS_mbind, begin, end - begin, mode, mask.data(),
+      mask.size() * bits + 1, NUMA_MPOL_MF_MOVE) == 0;
+}
+
+/**
+ * \function numa_node_count
+ * \brief Return the number of NUMA nodes having CPUs, at least one.
+ */
+unsigned
+numa_node_count()
+{
+  return topology().nodes.size();
+}
+
+/**
+ * \function numa_current_node
+ * \brief Return the node, numbered from 0 up to numa_node_count(), of
+ * the CPU on which the calling thread runs.
+ */
+unsigned
+numa_current_node()
+{
+  const numa_topology_t &t = topology();
+  unsigned cpu, node;
+
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+    return 0;
+  for (size_t i = 0; i < t.nodes.size(); i++)
+    if (t.nodes[i] == int(node))
+      return i;
+  return 0;
+}
+
+/**
+ * \function numa_pin_thread
+ * \brief Restrict the calling thread to the CPUs of the specified node,
+ * numbered from 0 up to numa_node_count().
+ *
+ * \return True on success, false with errno set on failure.
+ */
+bool
+numa_pin_thread(unsigned node)
+{
+  const std::vector<int> &cpus = topology().cpus[node];
+  cpu_set_t set;
+
+  if (cpus.empty())
+    return true;
+  CPU_ZERO(&set);
+  for (int cpu : cpus)
+    if (cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+/**
+ * \function numa_interleave
+ * \brief Interleave the pages of the specified memory across all nodes,
+ * moving those already allocated.
+ *
+ * \return True on success, false with errno set on failure.
+ */
+bool
+numa_interleave(const void *addr, size_t length)
+{
+  std::vector<unsigned> all(numa_node_count());
+
+  for (size_t i = 0; i < all.size(); i++)
+    all[i] = i;
+  return set_policy(addr, length, NUMA_MPOL_INTERLEAVE, all);
+}
+
+/**
+ * \function numa_bind
+ * \brief Place the pages of the specified memory on the specified node,
+ * moving those already allocated.
+ *
+ * \return True on success, false with errno set on failure.
+ */
+bool
+numa_bind(const void *addr, size_t length, unsigned node)
+{
+  return set_policy(addr, length, NUMA_MPOL_BIND, std::vector<unsigned>(1, node));
+}
+
+/**
+ * \function numa_advise_huge_pages
+ * \brief Advise the kernel to back the specified memory with transparent
+ * huge pages, reducing the TLB misses of its random accesses.
+ * The advice is ignored where it is not supported.
+ */
+void
+numa_advise_huge_pages(const void *addr, size_t length)
+{
+#ifdef MADV_HUGEPAGE
+  uintptr_t page = sysconf(_SC_PAGESIZE);
+  uintptr_t begin = ((uintptr_t)addr + page - 1) & ~(page - 1);
+  uintptr_t end = ((uintptr_t)addr + length) & ~(page - 1);
+
+  if (end > begin)
+    madvise((void *)begin, end - begin, MADV_HUGEPAGE);
+#endif
+}
+
+/**
+ * \function FrozenGraph::copy
+ * \brief Make the graph an owned copy of another one.
+ *
+ * The arrays are allocated and advised to use huge pages before they
+ * are first written, so that their pages are allocated on the node
+ * of the calling thread, and as huge pages where possible.
+ */
+void
+FrozenGraph::copy(const FrozenGraph &from)
+{
+  unmap();
+  timestamps.copy(from.timestamps);
+  out_offsets.copy(from.out_offsets);
+  out_targets.copy(from.out_targets);
+  in_offsets.copy(from.in_offsets);
+  in_sources.copy(from.in_sources);
+  in_timestamps.copy(from.in_timestamps);
+}
+
+/**
+ * \function Graph::place
+ * \brief Place the arrays of the prepared graph on the machine's NUMA nodes.
+ *
+ * \param placement How to place them; see numa_placement_t.
+ *
+ * Owned arrays are advised to use huge pages. With NUMA_INTERLEAVE
+ * their pages are interleaved across the nodes; the arrays of graphs
+ * mapped from a file stay where the page cache holds them. With
+ * NUMA_REPLICATE the arrays are moved to the first node, or copied to
+ * it if they are mapped, and copied to each other node by a thread
+ * running on it; cdindex_batch then pins its threads to the nodes in
+ * turn, each reading its node's replica. NUMA_LOCAL releases the
+ * replicas. The placement lasts until the graph is prepared again or
+ * relabeled. On a single node, only the advice is given.
+ *
+ * \return True on success, false with errno set on failure, to EINVAL
+ * if the graph is not prepared.
+ */
+bool
+Graph::place(numa_placement_t placement)
+{
+  if (!prepared) {
+    errno = EINVAL;
+    return false;
+  }
+  std::vector<std::unique_ptr<FrozenGraph>>().swap(replicas);
+  if (!frozen.is_mapped())
+    frozen.for_each_array(numa_advise_huge_pages);
+
+  unsigned nodes = numa_node_count();
+  if (nodes == 1 || placement == NUMA_LOCAL)
+    return true;
+
+  bool ok = true;
+  if (placement == NUMA_INTERLEAVE) {
+    if (!frozen.is_mapped())
+      frozen.for_each_array([&ok](const void *addr, size_t length) {
+        ok = ok && numa_interleave(addr, length);
+      });
+    return ok;
+  }
+
+  std::atomic<int> error(0);
+  replicas.resize(nodes);
+  std::vector<std::thread> copiers;
+  for (unsigned node = frozen.is_mapped() ? 0 : 1; node < nodes; node++)
+    copiers.emplace_back([this, node, &error]() {
+      if (!numa_pin_thread(node)) {
+        error = errno;
+        return;
+      }
+      replicas[node].reset(new FrozenGraph);
+      replicas[node]->copy(frozen);
+      replicas[node]->for_each_array([node, &error](const void *addr, size_t length) {
+        if (!numa_bind(addr, length, node))
+          error = errno;
+      });
+    });
+  if (!frozen.is_mapped())
+    frozen.for_each_array([&error](const void *addr, size_t length) {
+      if (!numa_bind(addr, length, 0))
+        error = errno;
+    });
+  for (auto &c : copiers)
+    c.join();
+  if (error) {
+    std::vector<std::unique_ptr<FrozenGraph>>().swap(replicas);
+    errno = error;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,153 @@
+/*
+  fast-cdindex library.
+  Copyright (C) 2017 Russell J. Funk <russellfunk@gmail.com>
+  Copyright (C) 2023 Diomidis Spinellis <dds@aueb.gr>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Helpers running loops over vertices or edges on many threads,
+ * shared by the graph construction and computation code.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/*
+ * Number of focal vertices a batch worker claims at a time.
+ * Small enough to balance the heavy-tailed per-vertex cost,
+ * large enough to keep contention on the shared cursor low.
+ */
+const size_t BATCH_CHUNK_SIZE = 64;
+
+/*
+ * Return the number of threads to use for the specified number of
+ * work items, given a requested number (0 for all available cores).
+ */
+inline unsigned thread_count(unsigned nthreads, size_t items) {
+  if (nthreads == 0)
+    nthreads = std::max(1u, std::thread::hardware_concurrency());
+  return std::max<size_t>(1, std::min<size_t>(nthreads, items));
+}
+
+/*
+ * Call f(k, state) for each k in [0, n) on the specified number of
+ * threads (0 for all available cores). Threads dynamically claim small
+ * chunks of k values, so that costly ones do not leave other cores idle.
+ * Each thread works on its own element of states, which is resized to
+ * the number of threads used.
+ */
+template <typename State, typename F>
+inline void parallel_for(size_t n, unsigned nthreads, std::vector<State> &states, F f) {
+  std::atomic<size_t> cursor(0);
+
+  auto worker = [&cursor, n, &f](State &state) {
+    for (;;) {
+      size_t begin = cursor.fetch_add(BATCH_CHUNK_SIZE, std::memory_order_relaxed);
+      if (begin >= n)
+        return;
+      size_t end = std::min(begin + BATCH_CHUNK_SIZE, n);
+      for (size_t k = begin; k < end; k++)
+        f(k, state);
+    }
+  };
+
+  nthreads = thread_count(nthreads, (n + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE);
+  states.resize(nthreads);
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < nthreads; i++)
+    workers.emplace_back(worker, std::ref(states[i]));
+  worker(states[0]);
+  for (auto &w : workers)
+    w.join();
+}
+
+/* Call f(k) for each k in [0, n), as above, without per-thread state */
+template <typename F>
+inline void parallel_for(size_t n, unsigned nthreads, F f) {
+  std::vector<char> unused;
+  parallel_for(n, nthreads, unused, [&f](size_t k, char &) { f(k); });
+}
+
+/*
+ * Return the number of contiguous ranges into which n work items
+ * are split for processing by the specified number of threads
+ * (0 for all available cores).
+ */
+inline unsigned range_count(size_t n, unsigned nthreads) {
+  // Ranges should amortize the cost of starting a thread
+  const size_t MIN_RANGE = 1 << 14;
+
+  return thread_count(nthreads, (n + MIN_RANGE - 1) / MIN_RANGE);
+}
+
+/*
+ * Call f(r, begin, end) on a separate thread for each of the specified
+ * number of contiguous ranges r of similar size covering [0, n).
+ */
+template <typename F>
+inline void parallel_ranges(size_t n, unsigned ranges, F f) {
+  size_t size = (n + ranges - 1) / ranges;
+
+  std::vector<std::thread> workers;
+  for (unsigned r = 1; r < ranges; r++)
+    workers.emplace_back(f, r, std::min(r * size, n), std::min((r + 1) * size, n));
+  f(0u, size_t(0), std::min(size, n));
+  for (auto &w : workers)
+    w.join();
+}
+
+/*
+ * Replace the elements of a with their exclusive prefix sums, so that
+ * a[i] becomes the sum of the original a[0..i), using the specified
+ * number of threads. The last element of a must be zero on entry,
+ * and becomes the total sum.
+ */
+inline void parallel_prefix_sum(std::vector<size_t> &a, unsigned nthreads) {
+  unsigned ranges = range_count(a.size(), nthreads);
+  std::vector<size_t> offset(ranges, 0);
+
+  // Sum each range, turn the sums into offsets, and then add them
+  parallel_ranges(a.size(), ranges, [&](unsigned r, size_t begin, size_t end) {
+    size_t sum = 0;
+    for (size_t i = begin; i < end; i++)
+      sum += a[i];
+    offset[r] = sum;
+  });
+  size_t total = 0;
+  for (auto &o : offset) {
+    size_t sum = o;
+    o = total;
+    total += sum;
+  }
+  parallel_ranges(a.size(), ranges, [&](unsigned r, size_t begin, size_t end) {
+    size_t sum = offset[r];
+    for (size_t i = begin; i < end; i++) {
+      size_t v = a[i];
+      a[i] = sum;
+      sum += v;
+    }
+  });
+}
+
+#endif /* PARALLEL_H */
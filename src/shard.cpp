@@ -0,0 +1,293 @@
+/*
+  fast-cdindex library.
+  Copyright (C) 2017 Russell J. Funk <russellfunk@gmail.com>
+  Copyright (C) 2023 Diomidis Spinellis <dds@aueb.gr>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Computation of the indices of a range of vertices of a graph file
+ * from their two-hop neighborhood, without loading the whole graph.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "cdindex.h"
+
+/*
+ * Ranges of array elements separated by at most MAX_GAP bytes are
+ * read together, in reads of at most MAX_READ bytes, unless a single
+ * range is larger.
+ */
+const uint64_t MAX_GAP = 64 * 1024;
+const uint64_t MAX_READ = 16 * 1024 * 1024;
+
+/* A range of elements of a graph file array */
+typedef struct {
+  uint64_t first;
+  uint64_t n;
+} element_range_t;
+
+/*
+ * The time window of a vertex whose citers are needed: those with
+ * a timestamp in (after, until], or up to until if from_start is set.
+ */
+typedef struct {
+  vertex_index_t v;
+  bool from_start;
+  timestamp_t after;
+  timestamp_t until;
+} citer_window_t;
+
+/*
+ * Call f(i, elements) for each of the specified ranges i of elements
+ * of a graph file array, which must be ordered by their first element.
+ * Nearby ranges are coalesced into a single read, whose size is added
+ * to bytes_read.
+ *
+ * Return true on success, false with errno set on a read error.
+ */
+template <typename T, typename F>
+static bool
+read_ranges(const GraphFile &file, graph_file_array_t array,
+    const std::vector<element_range_t> &ranges, uint64_t &bytes_read, F f)
+{
+  std::vector<T> buffer;
+
+  for (size_t i = 0; i < ranges.size(); ) {
+    uint64_t first = ranges[i].first;
+    uint64_t last = first + ranges[i].n;
+    size_t j = i + 1;
+    for (; j < ranges.size(); j++) {
+      uint64_t end = std::max(last, ranges[j].first + ranges[j].n);
+      if ((ranges[j].first > last && (ranges[j].first - last) * sizeof(T) > MAX_GAP)
+          || (end - first) * sizeof(T) > MAX_READ)
+        break;
+      last = end;
+    }
+
+    buffer.resize(last - first);
+    if (!file.read(array, first, last - first, buffer.data()))
+      return false;
+    bytes_read += (last - first) * sizeof(T);
+    for (; i < j; i++)
+      f(i, buffer.data() + (ranges[i].first - first));
+  }
+  return true;
+}
+
+/**
+ * \function cdindex_shard
+ * \brief Computes the CD, mCD, and I indices of a range of vertices
+ * of a graph file, loading only their neighborhood.
+ *
+ * \param file The graph file.
+ * \param begin The index of the first focal vertex.
+ * \param end The index past the last focal vertex.
+ * \param time_delta Time beyond stamp of focal vertex to consider in computing the measures.
+ * \param out Array of end - begin elements where the computed values are stored.
+ * \param nthreads Number of threads to use; 0 for all available cores.
+ * \param info If not NULL, set to the size of the loaded neighborhood.
+ *
+ * The focal vertices' references are read, followed by the citers of
+ * the focal vertices and their references within the time windows
+ * (located through the citers' timestamps), and the references of
+ * these citers. These form a graph whose vertices are the focal
+ * vertices, their references, and the citers, with the edges among
+ * them. As all other references of the citers are irrelevant to the
+ * focal vertices' indices, these are the same as in the whole graph.
+ * The graph is then prepared and computed in memory.
+ *
+ * Graphs larger than the available memory can thus be processed in
+ * consecutive ranges (shards) of vertices, either sequentially or by
+ * independent processes, whose results together are those of the
+ * whole graph. The memory required is proportional to the size of
+ * the neighborhood, which is smaller for graphs relabeled by timestamp.
+ *
+ * \return True on success, false with errno set on failure, to EINVAL
+ * if the range exceeds the graph's vertices.
+ */
+bool cdindex_shard(const GraphFile &file, vertex_index_t begin, vertex_index_t end,
+    timestamp_t time_delta, index_values_t *out, unsigned nthreads,
+    shard_info_t *info) {
+
+  if (begin > end || end > file.get_vcount()) {
+    errno = EINVAL;
+    return false;
+  }
+  size_t n = end - begin;
+  uint64_t bytes_read = 0;
+
+  // The focal vertices' timestamps and references
+  std::vector<timestamp_t> focal_ts(n);
+  std::vector<size_t> focal_o(n + 1);
+  if (!file.read(GRAPH_FILE_TIMESTAMPS, begin, n, focal_ts.data())
+      || !file.read(GRAPH_FILE_OUT_OFFSETS, begin, n + 1, focal_o.data()))
+    return false;
+  std::vector<vertex_index_t> focal_refs(focal_o[n] - focal_o[0]);
+  if (!file.read(GRAPH_FILE_OUT_TARGETS, focal_o[0], focal_refs.size(), focal_refs.data()))
+    return false;
+  bytes_read += n * (sizeof(timestamp_t) + sizeof(size_t))
+    + focal_refs.size() * sizeof(vertex_index_t);
+
+  /*
+   * The windows of the focal vertices, including their earlier citers
+   * that count in the I index, and those of their references, merged
+   * into a single window for each vertex
+   */
+  std::vector<citer_window_t> windows;
+  windows.reserve(n + focal_refs.size());
+  for (size_t k = 0; k < n; k++) {
+    timestamp_t t0 = focal_ts[k];
+    windows.push_back(citer_window_t{vertex_index_t(begin + k), true, t0, t0 + time_delta});
+    for (size_t j = focal_o[k]; j < focal_o[k + 1]; j++)
+      windows.push_back(citer_window_t{focal_refs[j - focal_o[0]], false, t0, t0 + time_delta});
+  }
+  std::sort(windows.begin(), windows.end(), [](const citer_window_t &a, const citer_window_t &b) {
+    return a.v < b.v;
+  });
+  size_t merged = 0;
+  for (size_t i = 0; i < windows.size(); i++)
+    if (merged && windows[merged - 1].v == windows[i].v) {
+      citer_window_t &w = windows[merged - 1];
+      w.from_start = w.from_start || windows[i].from_start;
+      w.after = std::min(w.after, windows[i].after);
+      w.until = std::max(w.until, windows[i].until);
+    } else
+      windows[merged++] = windows[i];
+  windows.resize(merged);
+
+  // The ranges of the windows' vertices' in edges
+  std::vector<element_range_t> ranges(windows.size());
+  for (size_t i = 0; i < windows.size(); i++)
+    ranges[i] = element_range_t{windows[i].v, 2};
+  if (!read_ranges<size_t>(file, GRAPH_FILE_IN_OFFSETS, ranges, bytes_read,
+        [&](size_t i, const size_t *o) { ranges[i] = element_range_t{o[0], o[1] - o[0]}; }))
+    return false;
+
+  // The citers within each window, located through their timestamps
+  std::vector<element_range_t> citer_ranges(windows.size());
+  std::vector<timestamp_t> citer_ts;
+  if (!read_ranges<timestamp_t>(file, GRAPH_FILE_IN_TIMESTAMPS, ranges, bytes_read,
+        [&](size_t i, const timestamp_t *t) {
+          const citer_window_t &w = windows[i];
+          const timestamp_t *lo = w.from_start ? t : std::upper_bound(t, t + ranges[i].n, w.after);
+          const timestamp_t *hi = std::upper_bound(lo, t + ranges[i].n, w.until);
+          citer_ranges[i] = element_range_t{ranges[i].first + (lo - t), uint64_t(hi - lo)};
+          citer_ts.insert(citer_ts.end(), lo, hi);
+        }))
+    return false;
+  std::vector<std::pair<vertex_index_t, timestamp_t>> citers;
+  citers.reserve(citer_ts.size());
+  if (!read_ranges<vertex_index_t>(file, GRAPH_FILE_IN_SOURCES, citer_ranges, bytes_read,
+        [&](size_t i, const vertex_index_t *s) {
+          for (size_t k = 0; k < citer_ranges[i].n; k++)
+            citers.push_back(std::make_pair(s[k], citer_ts[citers.size()]));
+        }))
+    return false;
+  std::vector<timestamp_t>().swap(citer_ts);
+  std::sort(citers.begin(), citers.end());
+  citers.erase(std::unique(citers.begin(), citers.end()), citers.end());
+
+  /*
+   * The vertices of the neighborhood, in the order of their index in
+   * the file, with the timestamps of those that are not citers read.
+   * The references of the citers other than the focal vertices are
+   * read later.
+   */
+  std::vector<vertex_index_t> vertices;
+  std::vector<timestamp_t> timestamps;
+  std::vector<element_range_t> unknown;
+  std::vector<size_t> unknown_positions;
+  std::vector<vertex_index_t> others;
+  vertices.reserve(windows.size() + citers.size());
+  timestamps.reserve(windows.size() + citers.size());
+  for (size_t i = 0, j = 0; i < windows.size() || j < citers.size(); ) {
+    if (j == citers.size() || (i < windows.size() && windows[i].v < citers[j].first)) {
+      unknown.push_back(element_range_t{windows[i].v, 1});
+      unknown_positions.push_back(vertices.size());
+      vertices.push_back(windows[i++].v);
+      timestamps.push_back(0);
+    } else {
+      if (i < windows.size() && windows[i].v == citers[j].first)
+        i++;
+      if (citers[j].first < begin || citers[j].first >= end)
+        others.push_back(citers[j].first);
+      vertices.push_back(citers[j].first);
+      timestamps.push_back(citers[j++].second);
+    }
+  }
+  std::vector<std::pair<vertex_index_t, timestamp_t>>().swap(citers);
+  std::vector<citer_window_t>().swap(windows);
+  if (!read_ranges<timestamp_t>(file, GRAPH_FILE_TIMESTAMPS, unknown, bytes_read,
+        [&](size_t i, const timestamp_t *t) { timestamps[unknown_positions[i]] = *t; }))
+    return false;
+  std::vector<element_range_t>().swap(unknown);
+  std::vector<size_t>().swap(unknown_positions);
+
+  auto local = [&vertices](vertex_index_t v) {
+    return std::lower_bound(vertices.begin(), vertices.end(), v) - vertices.begin();
+  };
+  auto is_local = [&vertices](vertex_index_t v) {
+    return std::binary_search(vertices.begin(), vertices.end(), v);
+  };
+
+  /*
+   * The edges among the neighborhood's vertices: the focal vertices'
+   * references, and those of the other citers that are in it.
+   * Other vertices are never "it" vertices, so their references
+   * are not needed.
+   */
+  std::vector<int64_t> sources, targets;
+  for (size_t k = 0; k < n; k++) {
+    int64_t source = local(begin + k);
+    for (size_t j = focal_o[k]; j < focal_o[k + 1]; j++) {
+      sources.push_back(source);
+      targets.push_back(local(focal_refs[j - focal_o[0]]));
+    }
+  }
+  ranges.resize(others.size());
+  for (size_t i = 0; i < others.size(); i++)
+    ranges[i] = element_range_t{others[i], 2};
+  if (!read_ranges<size_t>(file, GRAPH_FILE_OUT_OFFSETS, ranges, bytes_read,
+        [&](size_t i, const size_t *o) { ranges[i] = element_range_t{o[0], o[1] - o[0]}; }))
+    return false;
+  if (!read_ranges<vertex_index_t>(file, GRAPH_FILE_OUT_TARGETS, ranges, bytes_read,
+        [&](size_t i, const vertex_index_t *t) {
+          int64_t source = local(others[i]);
+          for (size_t k = 0; k < ranges[i].n; k++)
+            if (is_local(t[k])) {
+              sources.push_back(source);
+              targets.push_back(local(t[k]));
+            }
+        }))
+    return false;
+
+  Graph g;
+  g.add_vertices(timestamps.data(), timestamps.size());
+  g.add_edges(sources.data(), targets.data(), sources.size());
+  g.prepare_for_searching(nthreads);
+  if (info) {
+    info->vertices = g.get_vcount();
+    info->edges = g.get_ecount();
+    info->bytes_read = bytes_read;
+  }
+  std::vector<vertex_index_t> focal(n);
+  for (size_t k = 0; k < n; k++)
+    focal[k] = local(begin + k);
+  cdindex_batch(g, focal.data(), n, time_delta, out, nthreads);
+  return true;
+}
@@ -0,0 +1,138 @@
+/*
+  fast-cdindex library.
+  Copyright (C) 2017 Russell J. Funk <russellfunk@gmail.com>
+  Copyright (C) 2023 Diomidis Spinellis <dds@aueb.gr>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Tests of the concurrent graph builder and of adding vertices to a
+ * graph, including their failure paths, which the command-line program
+ * cannot reach. Failed checks are reported on stderr, and make the exit
+ * status non-zero.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "cdindex.h"
+
+static int failures;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+    failures++; \
+  } \
+} while (0)
+
+/* The builder gives consecutive indices and builds the graph from many producers */
+static void
+test_build()
+{
+  GraphBuilder builder(2);
+  timestamp_t ts[] = {1, 2, 3, 4};
+
+  CHECK(builder.get_producer(0).add_vertices(ts, 2) == 0);
+  CHECK(builder.get_producer(1).add_vertices(ts + 2, 2) == 2);
+  CHECK(builder.get_vcount() == 4);
+
+  std::thread other([&builder]() {
+    int64_t s[] = {3, 3}, t[] = {0, 1};
+    CHECK(builder.get_producer(1).add_edges(s, t, 2));
+  });
+  builder.get_producer(0).add_edge(2, 0);
+  builder.get_producer(0).add_edge(1, 0);
+  other.join();
+
+  Graph g;
+  CHECK(g.build(builder, 2));
+  CHECK(g.get_vcount() == 4);
+  CHECK(g.get_in_degree(0) == 3);
+  CHECK(g.get_out_degree(3) == 2);
+  CHECK(builder.get_vcount() == 0 && builder.get_ecount() == 0);
+
+  // Only an empty graph can be built
+  builder.get_producer(0).add_vertices(ts, 1);
+  errno = 0;
+  CHECK(!g.build(builder) && errno == EINVAL);
+}
+
+/* Edges with invalid indices are rejected, as is the whole call */
+static void
+test_invalid_edges()
+{
+  GraphBuilder builder(1);
+  GraphBuilder::Producer &p = builder.get_producer(0);
+  timestamp_t ts[] = {1, 2};
+  int64_t s[] = {1, 1}, negative[] = {0, -1}, large[] = {0, int64_t(MAX_VCOUNT)};
+
+  p.add_vertices(ts, 2);
+  CHECK(!p.add_edges(s, negative, 2));
+  CHECK(!p.add_edges(large, s, 2));
+  CHECK(builder.get_ecount() == 0);
+
+  // Edges to vertices that were not added fail when the graph is built
+  int64_t unknown[] = {0, 2};
+  CHECK(p.add_edges(s, unknown, 2));
+  Graph g;
+  errno = 0;
+  CHECK(!g.build(builder) && errno == EINVAL);
+  CHECK(g.get_vcount() == 0);
+}
+
+/* Vertices beyond MAX_VCOUNT are rejected before any is added */
+static void
+test_capacity()
+{
+  GraphBuilder builder(1);
+  GraphBuilder::Producer &p = builder.get_producer(0);
+  timestamp_t t = 1;
+
+  CHECK(p.add_vertex(t) == 0);
+  errno = 0;
+  // The timestamps are not read, as the check precedes them
+  CHECK(p.add_vertices(&t, MAX_VCOUNT) == NO_VERTEX && errno == EINVAL);
+  CHECK(builder.get_vcount() == 1);
+  CHECK(p.add_vertex(t) == 1);
+}
+
+/* A graph also rejects vertices beyond MAX_VCOUNT, keeping those it has */
+static void
+test_graph_capacity()
+{
+  Graph g;
+  timestamp_t ts[] = {1, 2};
+
+  CHECK(g.add_vertex(ts[0]) == 0);
+  errno = 0;
+  CHECK(g.add_vertices(ts, MAX_VCOUNT) == NO_VERTEX && errno == EINVAL);
+  CHECK(g.get_vcount() == 1);
+  CHECK(g.add_vertices(ts, 2) == 1);
+  CHECK(g.get_vcount() == 3);
+}
+
+int
+main()
+{
+  test_build();
+  test_invalid_edges();
+  test_capacity();
+  test_graph_capacity();
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
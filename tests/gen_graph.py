@@ -0,0 +1,59 @@
+#!/usr/local/bin/python
+# -*- coding: utf-8 -*-
+
+"""gen_graph.py: This script generates a random citation graph for tests.
+
+Usage: gen_graph.py seed vertices vertex-file edge-file
+
+The graph has some widely cited vertices and some with many references,
+so that their adjacency lists span several compressed blocks, and its
+vertex ids are not in timestamp order.
+"""
+
+__author__ = "Russell J. Funk and Diomidis Spinellis"
+__copyright__ = "Copyright (C) 2019, 2023"
+
+# built in modules
+import random
+import sys
+
+SECONDS_PER_YEAR = 31536000
+
+def main():
+  seed, count = int(sys.argv[1]), int(sys.argv[2])
+  rng = random.Random(seed)
+
+  # vertices published over 30 years, with ids shuffled within each year
+  times = sorted(rng.randrange(30 * SECONDS_PER_YEAR) for _ in range(count))
+  ids = list(range(count))
+  for begin in range(0, count, count // 30 + 1):
+    chunk = ids[begin:begin + count // 30 + 1]
+    rng.shuffle(chunk)
+    ids[begin:begin + len(chunk)] = chunk
+  hubs = rng.sample(range(count // 10), min(40, count // 10))
+
+  with open(sys.argv[3], "w") as f:
+    f.write("id\ttimestamp\n")
+    for i in range(count):
+      f.write("%d\t%d\n" % (ids[i], times[i]))
+
+  # each vertex cites earlier ones, often the hubs, and a few cite hundreds
+  with open(sys.argv[4], "w") as f:
+    f.write("source,target\n")
+    for i in range(1, count):
+      if rng.random() < 0.01:
+        references = rng.randrange(65, 300)
+      else:
+        references = rng.randrange(12)
+      cited = set()
+      for _ in range(references):
+        earlier = [h for h in hubs if h < i]
+        if earlier and rng.random() < 0.3:
+          cited.add(rng.choice(earlier))
+        else:
+          cited.add(rng.randrange(max(0, i - count // 5), i))
+      for j in sorted(cited):
+        f.write("%d,%d\n" % (ids[i], ids[j]))
+
+if __name__ == "__main__":
+  main()
@@ -7,7 +7,11 @@ __author__ = "Russell J. Funk and Diomidis Spinellis"
 __copyright__ = "Copyright (C) 2019, 2023"
 
 # built in modules
+import array
 import datetime
+import math
+import os
+import tempfile
 
 # custom modules
 from fast_cdindex import cdindex, timestamp_from_datetime
@@ -90,7 +94,7 @@ def c_tests():
 
   # add edges
   for source, target in cedges:
-    _cdindex.add_edge(i2v[source], i2v[target])
+    _cdindex.add_edge(graph, i2v[source], i2v[target])
 
   _cdindex.prepare_for_searching(graph)
 
@@ -109,15 +113,139 @@ def c_tests():
   for vertex in vertices:
     print("%s: %-5s | %s: %-15s %s: %-10s %s: %-10s %s at %s: %-20s %s at %s: %-20s %s: %-20s %s: %-20s"
         % ("vertex", v2i[vertex],
-           "timestamp", _cdindex.get_vertex_timestamp(vertex),
-           "in degree", _cdindex.get_vertex_in_degree(vertex),
-           "out degree", _cdindex.get_vertex_out_degree(vertex),
-           "cd index", TEST_TIME, _cdindex.cdindex(vertex, TEST_TIME),
-           "mcd index", TEST_TIME, _cdindex.mcdindex(vertex, TEST_TIME),
-           "in edges", canonicalize(_cdindex.get_vertex_in_edges(vertex)),
-           "out edges", canonicalize(_cdindex.get_vertex_out_edges(vertex))),
+           "timestamp", _cdindex.get_vertex_timestamp(graph, vertex),
+           "in degree", _cdindex.get_vertex_in_degree(graph, vertex),
+           "out degree", _cdindex.get_vertex_out_degree(graph, vertex),
+           "cd index", TEST_TIME, _cdindex.cdindex(graph, vertex, TEST_TIME),
+           "mcd index", TEST_TIME, _cdindex.mcdindex(graph, vertex, TEST_TIME),
+           "in edges", canonicalize(_cdindex.get_vertex_in_edges(graph, vertex)),
+           "out edges", canonicalize(_cdindex.get_vertex_out_edges(graph, vertex))),
           flush=True)
 
+  # compare the parallel batch computation against the single vertex one
+  batch = _cdindex.cdindex_all(graph, TEST_TIME, 4)
+  single = [(_cdindex.cdindex(graph, v, TEST_TIME), _cdindex.mcdindex(graph, v, TEST_TIME),
+             int(_cdindex.iindex(graph, v, TEST_TIME))) for v in _cdindex.get_vertices(graph)]
+  print("Batch indices match: %s" % (repr(batch) == repr(single)))
+  subset = _cdindex.cdindex_all(graph, TEST_TIME, 2, [i2v[4], i2v[2]])
+  print("Batch subset indices match: %s" % (repr(subset) == repr([single[4], single[2]])))
+  print("Sweep indices match: %s" % (repr(_cdindex.cdindex_sweep(graph, TEST_TIME, 2)) == repr(batch)))
+
+  # estimates are exact within the budget, and bracket their value otherwise
+  approximate = _cdindex.cdindex_approximate_all(graph, TEST_TIME, 1000, 2)
+  print("Approximate indices within budget match: %s" % (repr([e[0] for e in approximate])
+        == repr([s[0] for s in single]) and all(e[3] for e in approximate)))
+  estimates = [_cdindex.cdindex_approximate(graph, v, TEST_TIME, 2, 7)
+               for v in _cdindex.get_vertices(graph)]
+  print("Approximate indices bracketed: %s" % all(math.isnan(cd) or low <= cd <= high
+        for cd, low, high, exact in estimates))
+
+  # query degrees, timestamps, edges, and indices as arrays
+  vertices = _cdindex.get_vertices(graph)
+  print("Array timestamps match: %s" % (_cdindex.get_timestamps(graph).tolist()
+        == [_cdindex.get_vertex_timestamp(graph, v) for v in vertices]))
+  print("Array degrees match: %s" % (
+        _cdindex.get_in_degrees(graph).tolist() == [_cdindex.get_vertex_in_degree(graph, v) for v in vertices]
+        and _cdindex.get_out_degrees(graph).tolist() == [_cdindex.get_vertex_out_degree(graph, v) for v in vertices]))
+  offsets, sources = _cdindex.get_in_csr(graph)
+  targets = _cdindex.get_out_csr(graph, array.array('q', [i2v[4], i2v[9]]))
+  print("Array edges match: %s" % (all(sources[offsets[v]:offsets[v + 1]].tolist()
+        == _cdindex.get_vertex_in_edges(graph, v) for v in vertices)
+        and [targets[1][targets[0][i]:targets[0][i + 1]].tolist() for i in range(2)]
+        == [_cdindex.get_vertex_out_edges(graph, i2v[v]) for v in (4, 9)]))
+  arrays = _cdindex.cdindex_arrays(graph, TEST_TIME)
+  print("Array indices match: %s" % (repr(list(zip(*[a.tolist() for a in arrays]))) == repr(batch)))
+  arrays = _cdindex.cdindex_arrays(graph, TEST_TIME, 2, array.array('q', [i2v[4], i2v[2]]))
+  print("Array subset indices match: %s" % (repr(list(zip(*[a.tolist() for a in arrays])))
+        == repr([single[4], single[2]])))
+  approximate = _cdindex.cdindex_approximate_all(graph, TEST_TIME, 1000, 2, array.array('q', [i2v[4]]))
+  print("Approximate subset indices match: %s" % (repr(approximate[0][0]) == repr(single[4][0])))
+  exported_graph = _cdindex.Graph()
+  _cdindex.add_vertex(exported_graph, ctimes[0])
+  _cdindex.prepare_for_searching(exported_graph)
+  timestamps = _cdindex.get_timestamps(exported_graph)
+  _cdindex.add_vertex(exported_graph, ctimes[1])
+  try:
+    _cdindex.prepare_for_searching(exported_graph)
+  except BufferError as e:
+    print("Exported graph error: %s" % e)
+  del timestamps
+  _cdindex.prepare_for_searching(exported_graph)
+  print("Released graph timestamps: %s" % _cdindex.get_timestamps(exported_graph).tolist())
+
+  # vertex indices are checked against the graph
+  for bad_vertex in (-1, len(ctimes)):
+    try:
+      _cdindex.cdindex(graph, bad_vertex, TEST_TIME)
+    except IndexError as e:
+      print("Vertex %d error: %s" % (bad_vertex, e))
+
+  # verify that all reference intersection kernels give the same results
+  for kernel in ("binary_search", "merge", "gallop", "bitmap", "simd", "adaptive"):
+    _cdindex.set_intersection_kernel(kernel)
+    print("Kernel %s indices match: %s" % (kernel, repr(_cdindex.cdindex_all(graph, TEST_TIME)) == repr(batch)))
+
+  # the order in which batch computations process vertices does not affect the results
+  for schedule in ("timestamp", "given"):
+    _cdindex.set_batch_schedule(schedule)
+    print("Schedule %s indices match: %s" % (schedule, repr(_cdindex.cdindex_all(graph, TEST_TIME)) == repr(batch)))
+
+  # compare the single pass multi-window computation against separate ones
+  deltas = [0, TEST_TIME // 4, TEST_TIME // 2, TEST_TIME, 2 * TEST_TIME]
+  windows_match = True
+  for v in _cdindex.get_vertices(graph):
+    separate = [(_cdindex.cdindex(graph, v, d), _cdindex.mcdindex(graph, v, d),
+                 int(_cdindex.iindex(graph, v, d))) for d in deltas]
+    windows_match &= repr(_cdindex.cdindex_windows(graph, v, deltas)) == repr(separate)
+  print("Multi-window indices match: %s" % windows_match)
+
+  # load the same graph in bulk from arrays of timestamps and vertex indices
+  bulk_graph = _cdindex.Graph()
+  print("First bulk vertex index: %s" % _cdindex.add_vertices(bulk_graph, array.array('q', ctimes)))
+  _cdindex.add_edges(bulk_graph, array.array('q', [s for s, t in cedges]),
+                     array.array('q', [t for s, t in cedges]))
+  try:
+    _cdindex.add_edges(bulk_graph, array.array('q', [0]), array.array('q', [len(ctimes)]))
+  except IndexError as e:
+    print("Bulk edge error: %s" % e)
+  _cdindex.prepare_for_searching(bulk_graph)
+  print("Bulk graph sanity: %s" % (_cdindex._is_graph_sane(bulk_graph)))
+  print("Bulk indices match: %s" % (repr(_cdindex.cdindex_all(bulk_graph, TEST_TIME)) == repr(batch)))
+
+  # relabeling the vertices for locality keeps their indices
+  previous = list(range(len(ctimes)))
+  for order in ("timestamp", "rcm", "references"):
+    previous = [previous[v] for v in _cdindex.relabel(bulk_graph, order).tolist()]
+    print("Relabeled %s order: %s sanity: %s indices match: %s" % (order, previous,
+          _cdindex._is_graph_sane(bulk_graph),
+          repr(_cdindex.cdindex_all(bulk_graph, TEST_TIME)) == repr([batch[v] for v in previous])))
+  try:
+    _cdindex.relabel(bulk_graph, "alphabetical")
+  except ValueError as e:
+    print("Relabel error: %s" % e)
+
+  # save the graph and load it back through a mapped file
+  fd, path = tempfile.mkstemp(suffix=".graph")
+  os.close(fd)
+  _cdindex.save_graph(graph, path)
+  loaded_graph = _cdindex.load_graph(path)
+  print("Loaded graph vertices: %s edges: %s names: %s sanity: %s" % (_cdindex.get_vcount(loaded_graph),
+        _cdindex.get_ecount(loaded_graph), _cdindex.get_name_count(loaded_graph),
+        _cdindex._is_graph_sane(loaded_graph)))
+  print("Loaded indices match: %s" % (repr(_cdindex.cdindex_all(loaded_graph, TEST_TIME)) == repr(batch)))
+  print("Loaded vertex indices match: %s" % all(
+        _cdindex.get_vertex_out_edges(loaded_graph, v) == _cdindex.get_vertex_out_edges(graph, v)
+        and _cdindex.get_vertex_timestamp(loaded_graph, v) == _cdindex.get_vertex_timestamp(graph, v)
+        for v in _cdindex.get_vertices(graph)))
+  with open(path, "r+b") as f:
+    f.seek(-1, os.SEEK_END)
+    f.write(b"\xff")
+  try:
+    _cdindex.load_graph(path)
+  except OSError as e:
+    print("Corrupted graph file error: %s" % e.strerror)
+  os.remove(path)
+
 # tests for the python module
 def py_tests():
   """Run tests for python module."""
@@ -152,6 +280,84 @@ def py_tests():
            "in edges", sorted(graph.in_edges(vertex)),
            "out edges", sorted(graph.out_edges(vertex))), flush=True)
 
+  # compute the indices of all vertices in parallel
+  print("Batch indices: %s" % (graph.cdindex_all(int(TEST_TIME_PY.total_seconds()), ["4Z", "7Z"])))
+  print("Sweep indices match: %s" % (graph.cdindex_sweep(int(TEST_TIME_PY.total_seconds()))
+        == graph.cdindex_all(int(TEST_TIME_PY.total_seconds()))))
+  print("Multi-window indices of 4Z: %s" % graph.cdindex_windows("4Z",
+        [int(datetime.timedelta(days=365 * y).total_seconds()) for y in (1, 3, 5)]))
+  print("Approximate index of 4Z: %s of 7Z: %s" % (
+        graph.cdindex_approximate("4Z", int(TEST_TIME_PY.total_seconds()), 2, 1),
+        graph.cdindex_approximate_all(int(TEST_TIME_PY.total_seconds()), 1000, ["7Z"])["7Z"]))
+
+  # statistics of the computations are only available in builds collecting them
+  cdindex.reset_stats()
+  try:
+    graph.cdindex_all(int(TEST_TIME_PY.total_seconds()))
+    stats = cdindex.get_stats(graph)
+    print("Statistics focal vertices: %s intersections: %s" % (stats["focal_vertices"],
+          stats["intersections"]))
+  except RuntimeError as e:
+    print("Statistics error: %s" % e)
+
+  # compute the indices of some vertices into arrays
+  cd, mcd, i = graph.cdindex_arrays(int(TEST_TIME_PY.total_seconds()), ["4Z", "7Z"])
+  print("Array indices: %s %s %s" % (cd.tolist(), mcd.tolist(), i.tolist()))
+  offsets, targets = graph.out_edges_csr(["9Z"])
+  names = list(graph.vertices())
+  print("Array out edges of 9Z: %s in degrees: %s" % (sorted(names[t] for t in targets),
+        dict(zip(names, graph.in_degrees().tolist()))))
+
+  # save the graph and load it back with its vertex names
+  fd, path = tempfile.mkstemp(suffix=".graph")
+  os.close(fd)
+  graph.save(path)
+  loaded = cdindex.Graph.load(path, list(graph.vertices()))
+  saved_names = cdindex.Graph.load(path)
+  os.remove(path)
+  print("Loaded out edges of 9Z: %s CD index of 4Z: %s" % (sorted(loaded.out_edges("9Z")),
+        loaded.cdindex("4Z", int(TEST_TIME_PY.total_seconds()))))
+  print("Saved names: %s in edges of 4Z: %s" % (list(saved_names.vertices()),
+        sorted(saved_names.in_edges("4Z"))))
+
+  # rearrange the vertices of a graph in memory
+  loaded.prepare_for_searching(order="timestamp")
+  print("Rearranged vertices: %s indices match: %s" % (list(loaded.vertices()),
+        loaded.cdindex_all(int(TEST_TIME_PY.total_seconds())) == graph.cdindex_all(int(TEST_TIME_PY.total_seconds()))))
+
+  # vertex names are unique strings
+  for name in ("4Z", 4):
+    try:
+      graph.add_vertex(name, 0)
+    except (ValueError, TypeError) as e:
+      print("Vertex name %r error: %s" % (name, e))
+  try:
+    graph.in_degree("12Z")
+  except KeyError as e:
+    print("Missing vertex name error: %s" % e)
+
+  # maintain the indices incrementally as citing works are added to a graph
+  t_delta = int(TEST_TIME_PY.total_seconds())
+  growing = cdindex.Graph()
+  first = ["0Z", "1Z", "2Z", "3Z", "4Z", "5Z"]
+  for added in (first, [vertex["name"] for vertex in pyvertices if vertex["name"] not in first]):
+    for vertex in pyvertices:
+      if vertex["name"] in added:
+        growing.add_vertex(vertex["name"], timestamp_from_datetime(vertex["time"]))
+    for edge in pyedges:
+      if edge["source"] in added:
+        growing.add_edge(edge["source"], edge["target"])
+    if added is first:
+      tracker = cdindex.CDIndexTracker(growing, t_delta)
+    else:
+      print("Tracker changed vertices: %s" % tracker.update())
+  print("Tracker indices match: %s" % ({name: tracker.values(name) for name in growing.vertices()}
+        == graph.cdindex_all(t_delta)))
+  try:
+    growing.add_edge("4Z", "0Z")
+  except ValueError as e:
+    print("Frozen source edge error: %s" % e)
+
 def main():
 
   # run c tests